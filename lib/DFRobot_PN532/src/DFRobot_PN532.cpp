@@ -12,26 +12,29 @@
 
 #include "DFRobot_PN532.h"
 
-uint8_t DFRobot_PN532::getUltraversion(uint8_t block){
-    if(!this->nfcEnable)
-        return -1;
-    if(!scan())
-        return -1;
-    unsigned char cmdRead[4];
-        cmdRead[0] = COMMAND_INDATAEXCHANGE;
-        cmdRead[1] = 1;                   /* Card number */
-        cmdRead[2] = CARD_CMD_READING;     /* NTAG Read command = 0x30 */
-        cmdRead[3] = block; 
-    
-    writeCommand(cmdRead,4);
-    if(!readAck(32))
-        return -1;
-    if(receiveACK[12] == 0x41 && receiveACK[13] == 0x00){
-    }
-    else
-        return -1;
-    return 1;
-}
+/*! Card types identified from SAK/ATQA and NXP GET_VERSION, index 0 is the fallback*/
+const DFRobot_PN532::sCardType_t DFRobot_PN532::cardTypes[] = {
+  /* name                   technology                 size  user  block blocks sectors */
+    {"Unknown",             "ISO/IEC14443-3,Type A",      0,    0,  0,    0,   0},
+    {"MIFARE Classic 1k",   "ISO/IEC14443-3,Type A",   1024,  752, 16,   64,  16},
+    {"MIFARE Classic 4k",   "ISO/IEC14443-3,Type A",   4096, 3440, 16,  256,  40},
+    {"MIFARE Mini",         "ISO/IEC14443-3,Type A",    320,  224, 16,   20,   5},
+    {"NTAG 213",            "ISO/IEC14443-3,Type A",    180,  144,  4,   45,   1},
+    {"NTAG 215",            "ISO/IEC14443-3,Type A",    540,  504,  4,  135,   1},
+    {"NTAG 216",            "ISO/IEC14443-3,Type A",    924,  888,  4,  231,   1},
+    {"Ultralight EV1 48",   "ISO/IEC14443-3,Type A",     80,   48,  4,   20,   1},
+    {"Ultralight EV1 128",  "ISO/IEC14443-3,Type A",    164,  128,  4,   41,   1},
+    {"Ultralight",          "ISO/IEC14443-3,Type A",     64,   48,  4,   16,   1},
+    {"Ultralight C",        "ISO/IEC14443-3,Type A",    192,  144,  4,   48,   1},
+    {"ISO14443-4 / DESFire","ISO/IEC14443-4,Type A",      0,    0,  0,    0,   0},
+};
+
+enum{
+    eTypeUnknown = 0, eTypeClassic1k, eTypeClassic4k, eTypeMini,
+    eTypeNtag213, eTypeNtag215, eTypeNtag216, eTypeUltralightEV1_48, eTypeUltralightEV1_128,
+    eTypeUltralight, eTypeUltralightC, eTypeIso14443_4
+};
+
 uint8_t DFRobot_PN532::readNTAG(uint8_t *buffer,uint8_t block){
     if(block > 231)
         return -1;
@@ -48,7 +51,6 @@ uint8_t DFRobot_PN532::readNTAG(uint8_t *buffer,uint8_t block){
     writeCommand(cmdRead,4);
     if(!readAck(32))
         return -1;
-    String dataSrt = "";
     if(receiveACK[12] == 0x41 && receiveACK[13] == 0x00){
         for(uint8_t i = 0;i<4;i++){
             buffer[i] = receiveACK[14 + i];
@@ -153,119 +155,94 @@ bool DFRobot_PN532::passWordCheck(int block,uint8_t id[],uint8_t st[])
 }
 DFRobot_PN532:: sCard_t DFRobot_PN532::getInformation(){
     sCard_t card;
+    getInformation(card);
+    return card;
+}
+bool DFRobot_PN532::getInformation(sCard_t &card){
     uint8_t cmdnfcUid[11];
     cmdnfcUid[0] = COMMAND_INLISTPASSIVETARGET;
     cmdnfcUid[1] = 1;                              // The quantity number of the maxium card that can be detected in every research
     cmdnfcUid[2] = MIFARE_ISO14443A;
     writeCommand(cmdnfcUid,3);
-    readAck(28);
-    for(int i = 0; i < receiveACK[18]; i++)
-        nfcUid[i] = receiveACK[i + 19];
-    
-    /*for(int i= 0 ; i<32 ;i++){
-        Serial.print(receiveACK[i],HEX);
-        Serial.print(" ");
-    }*/
-    //Serial.println(" ");
-    card.AQTA[0] = receiveACK[15];
-    card.AQTA[1] = receiveACK[16];
-    card.SAK = receiveACK[17];
-    memcpy(card.uid,receiveACK+19,receiveACK[18]);
-    if(card.AQTA[0] == 0x00 && card.AQTA[1] ==0x04){
-        memcpy(card.RFTechnology,"ISO/IEC1443-3,Type A",20);
-        memcpy(card.cardType,"MIFARE Classic 1k",17);
-        card.uidlenght = 4;
-        memcpy(card.Manufacturer,"NXP",3);
-        card.size = 1024;
-        card.usersize = 752;
-        card.blockSize = 16;
-        card.blockNumber = 64;
-        card.sectorSize = 16;
-    }
-    if(card.AQTA[0] == 0x00 && card.AQTA[1] ==0x44 && getUltraversion(230) == 1){
-        memcpy(card.RFTechnology,"ISO/IEC1443-3,Type A",25);
-        memcpy(card.cardType,"NTAG 216",8);
-        memcpy(card.Manufacturer,"NXP",4);
-        card.uidlenght = 7;
-        card.size = 924;
-        card.usersize = 888;
-        card.blockSize = 4;
-        card.blockNumber = 231;
-        card.sectorSize = 1;
-    }
-    if(card.AQTA[0] == 0x00 && card.AQTA[1] ==0x44 && getUltraversion(230) != 1 && getUltraversion(134) == 1){
-        memcpy(card.RFTechnology,"ISO/IEC1443-3,Type A",25);
-        memcpy(card.cardType,"NTAG 215",8);
-        memcpy(card.Manufacturer,"NXP",4);
-        card.uidlenght = 7;
-        card.size = 540;
-        card.usersize = 504;
-        card.blockSize = 4;
-        card.blockNumber = 135;
-        card.sectorSize = 1;
-    }
-    if(card.AQTA[0] == 0x00 && card.AQTA[1] ==0x44 && getUltraversion(134) != 1 && getUltraversion(44) == 1){
-        memcpy(card.RFTechnology,"ISO/IEC1443-3,Type A",25);
-        memcpy(card.cardType,"NTAG 213",8);
-        memcpy(card.Manufacturer,"NXP",4);
-        card.usersize = 144;
-        card.uidlenght = 7;
-        card.size = 180;
-        card.blockSize = 4;
-        card.blockNumber = 45;
-        card.sectorSize = 1;
-    }
-    if(card.AQTA[0] == 0x00 && card.AQTA[1] ==0x44 && getUltraversion(44) != 1 && getUltraversion(40) == 1){
-        memcpy(card.RFTechnology,"ISO/IEC1443-3,Type A",25);
-        memcpy(card.cardType,"Ultralight",10);
-        memcpy(card.Manufacturer,"NXP",4);
-        card.usersize = 128;
-        card.uidlenght = 7;
-        card.size = 164;
-        card.blockSize = 4;
-        card.blockNumber = 41;
-        card.sectorSize = 1;
-    }
-    if(card.AQTA[0] == 0x00 && card.AQTA[1] ==0x44 && getUltraversion(40) != 1 && getUltraversion(19) == 1){
-        memcpy(card.RFTechnology,"ISO/IEC1443-3,Type A",25);
-        memcpy(card.cardType,"Ultralight",10);
-        memcpy(card.Manufacturer,"NXP",4);
-        card.usersize = 48;
-        card.uidlenght = 7;
-        card.size = 80;
-        card.blockSize = 4;
-        card.blockNumber = 20;
-        card.sectorSize = 1;
+    sTarget_t target;
+    if(!readAck(32) || parseTargets(&target, 1) != 1)
+        return false;
+    nfcUid = target.uid;
+
+    card.AQTA[0] = target.ATQA[0];
+    card.AQTA[1] = target.ATQA[1];
+    card.SAK = target.SAK;
+    card.uidlenght = target.uid.length;
+    memcpy(card.uid,nfcUid.bytes,nfcUid.length < sizeof(card.uid) ? nfcUid.length : sizeof(card.uid));
+
+    /*! Repeat taps are served from the UID-keyed cache without touching the card*/
+    uint8_t type = eTypeUnknown;
+    bool cached = false;
+    for(uint8_t i = 0; i < PN532_CARD_CACHE_SIZE; i++){
+        if(_cardCache[i].uid.length != 0 && _cardCache[i].uid == nfcUid){
+            type = _cardCache[i].type;
+            cached = true;
+            break;
+        }
     }
-    
-    if(card.AQTA[0] == 0x00 && card.AQTA[1] ==0x44 && getUltraversion(19) != 1 && getUltraversion(14) == 1){
-        memcpy(card.RFTechnology,"ISO/IEC1443-3,Type A",25);
-        memcpy(card.cardType,"Ultralight",10);
-        memcpy(card.Manufacturer,"NXP",4);
-        card.uidlenght = 7;
-        card.size = 448;
-        card.usersize = 320;
-        card.blockSize = 4;
-        card.blockNumber = 41;
-        card.sectorSize = 1;
+    if(!cached){
+        type = identify(target);
+        _cardCache[_cardCacheNext].uid = nfcUid;
+        _cardCache[_cardCacheNext].type = type;
+        _cardCacheNext = (_cardCacheNext + 1) % PN532_CARD_CACHE_SIZE;
     }
-    
-    
-    
-    if(card.AQTA[0] == 0x00 && card.AQTA[1] ==0x02){
-        memcpy(card.RFTechnology,"ISO/IEC1443-3,Type A",20);
-        memcpy(card.cardType,"MIFARE Classic 4k",17);
-        memcpy(card.Manufacturer,"NXP",3);
-        card.uidlenght = 7;
-        card.size = 4096;
-        card.usersize = 3440;
-        card.blockSize = 16;
-        card.blockNumber = 256;
-        card.sectorSize = 39;
+
+    const sCardType_t &info = cardTypes[type];
+    strncpy(card.cardType, info.name, sizeof(card.cardType) - 1);
+    strncpy(card.RFTechnology, info.technology, sizeof(card.RFTechnology) - 1);
+    strncpy(card.Manufacturer, type == eTypeUnknown ? "" : "NXP", sizeof(card.Manufacturer) - 1);
+    card.size = info.size;
+    card.usersize = info.usersize;
+    card.blockSize = info.blockSize;
+    card.blockNumber = info.blockNumber;
+    card.sectorSize = info.sectorSize;
+    return true;
+}
+
+uint8_t DFRobot_PN532::identify(const sTarget_t &target){
+    /*! SAK alone separates the MIFARE Classic family and ISO14443-4 cards*/
+    switch(target.SAK){
+    case 0x08: return eTypeClassic1k;
+    case 0x18: return eTypeClassic4k;
+    case 0x09: return eTypeMini;
+    case 0x00: break;
+    default:   return (target.SAK & 0x20) ? eTypeIso14443_4 : eTypeUnknown;
     }
-    
-    
-    return card;    
+    if(target.ATQA[1] != 0x44)
+        return eTypeUnknown;
+
+    /*! Ultralight/NTAG: one GET_VERSION names EV1 and NTAG21x parts directly*/
+    uint8_t version[8];
+    uint8_t cardCmd[1] = {CARD_CMD_GET_VERSION};
+    if(exchange(cardCmd, 1, version, sizeof(version), true) == eStatusOK && version[1] == 0x04){
+        if(version[2] == 0x04){
+            switch(version[6]){
+            case 0x0F: return eTypeNtag213;
+            case 0x11: return eTypeNtag215;
+            case 0x13: return eTypeNtag216;
+            }
+        }
+        else if(version[2] == 0x03){
+            switch(version[6]){
+            case 0x0B: return eTypeUltralightEV1_48;
+            case 0x0E: return eTypeUltralightEV1_128;
+            }
+        }
+        return eTypeUnknown;
+    }
+
+    /*! No GET_VERSION: original Ultralight or Ultralight C. The NAK halted the tag, so
+        reselect and probe page 43, which only exists on the Ultralight C*/
+    if(!scan())
+        return eTypeUltralight;
+    uint8_t page[16];
+    uint8_t readCmd[2] = {CARD_CMD_READING, 43};
+    return exchange(readCmd, 2, page, sizeof(page)) == eStatusOK ? eTypeUltralightC : eTypeUltralight;
 }
 bool DFRobot_PN532::checkDCS(int x)  
 {
@@ -286,27 +263,13 @@ bool DFRobot_PN532::checkDCS(int x)
         return false;
 }
 bool DFRobot_PN532::writeData(int block, uint8_t data[])
-{   if(block < 128 && ( (block + 1)%4 == 0 || block ==0 ))
-        return false;
-    if((block >127 && block <256) && ((block + 1)%16 == 0))
-        return false;
-    if(block > 255)
-        return false;
-    if(!this->nfcEnable)
-        return false;
-    if(!this->scan())
-        return false;
-    if(!this->passWordCheck(block,nfcUid,nfcPassword))
-        return false;
-    unsigned char cmdWrite[20];
-        cmdWrite[0] = COMMAND_INDATAEXCHANGE;
-        cmdWrite[1] = 1;                                     /* Card number */
-        cmdWrite[2] = CARD_CMD_WRITEINGTOMIFARECLASSIC;       /* MifareClassic Write command = 0xA0 */
-        cmdWrite[3] = block;
-    for(int i = 4;i < 20;i++) cmdWrite[i]=data[i - 4];// Data to be written
-    this->writeCommand(cmdWrite,20);
-    this->readAck(16);
-    return true;
+{
+    return writeBlock(block, data) == eStatusOK;
+}
+
+DFRobot_PN532::eStatus_t DFRobot_PN532::writeBlock(int block, const uint8_t *data)
+{
+    return writeBlocks(block, 1, data);
 }
 
 void DFRobot_PN532::writeData(int block, uint8_t index, uint8_t data)
@@ -314,17 +277,18 @@ void DFRobot_PN532::writeData(int block, uint8_t index, uint8_t data)
     if(!this->nfcEnable)
         return;
     index = max(min(index,16),1);
-    this->readData(block);
-    this->blockData[index - 1] = data;
-    this->writeData(block, this->blockData);
+    /*! One selection and one authentication for the read-modify-write*/
+    if(this->beginSession() != eStatusOK)
+        return;
+    if(this->readBlocks(block, 1, this->blockData) == eStatusOK){
+        this->blockData[index - 1] = data;
+        this->writeBlocks(block, 1, this->blockData);
+    }
+    this->endSession();
 }
 uint8_t DFRobot_PN532::readData(int block, uint8_t offset)
 {
-    if(!this->nfcEnable)
-        return -1;
-    String error = this->readData(block);
-    if(error == "no card!" || error == "read error!" || error =="unknown error!"
-                        || error == "read timeout!" || error == "wake up error!")
+    if(this->readBlock(block, this->blockData) != eStatusOK)
         return -1;
     return this->blockData[offset - 1];
 }
@@ -335,16 +299,8 @@ bool DFRobot_PN532::scan(String nfcUid)
         return false;
     if(this->scan())
     {
-        String nfcUidSrt = "";
-        for(int i=0; i<4; i++)
-        {
-            if(this->nfcUid[i] <= 0x0f){
-                nfcUidSrt += "0";
-                nfcUidSrt += String(this->nfcUid[i],HEX);
-            }
-            else
-                nfcUidSrt += String(this->nfcUid[i],HEX);
-        }
+        char nfcUidSrt[2 * PN532_MAX_UID_LENGTH + 1];
+        this->nfcUid.toHex(nfcUidSrt, sizeof(nfcUidSrt), false);
         if(nfcUid == nfcUidSrt)
             return true;
     }
@@ -359,16 +315,117 @@ bool DFRobot_PN532::scan()
     cmdnfcUid[1] = 1;                              // The quantity number of the maxium card that can be detected in every research
     cmdnfcUid[2] = MIFARE_ISO14443A;
     writeCommand(cmdnfcUid,3);
-    if(!readAck(25))
+    if(!readAck(32))
+        return false;
+    return parseScan();
+}
+
+bool DFRobot_PN532::parseScan()
+{
+    sTarget_t target;
+    if(parseTargets(&target, 1) != 1)
+        return false;
+    nfcUid = target.uid;
+    return true;
+}
+
+uint8_t DFRobot_PN532::scanTargets(sTarget_t *targets, uint8_t maxTargets)
+{
+    if(!this->nfcEnable)
+        return 0;
+    maxTargets = max(min(maxTargets, PN532_MAX_TARGETS), 1);
+    uint8_t cmdnfcUid[3];
+    cmdnfcUid[0] = COMMAND_INLISTPASSIVETARGET;
+    cmdnfcUid[1] = maxTargets;
+    cmdnfcUid[2] = MIFARE_ISO14443A;
+    writeCommand(cmdnfcUid,3);
+    if(!readAck(PN532_TARGETFRAME_LEN))
+        return 0;
+    return parseTargets(targets, maxTargets);
+}
+
+uint8_t DFRobot_PN532::parseTargets(sTarget_t *targets, uint8_t maxTargets)
+{
+    /*! receiveACK[9] is LEN, covering TFI (receiveACK[11]) through the last data byte*/
+    uint8_t end = min(11 + receiveACK[9], (int)sizeof(receiveACK) - 2);
+    uint8_t count = 0;
+    uint8_t pos = 14;
+    if(receiveACK[12] == COMMAND_INLISTPASSIVETARGET + 1){
+        for(uint8_t i = 0; i < receiveACK[13] && count < maxTargets; i++){
+            uint8_t used = parseTarget(pos, end, &targets[count]);
+            if(used == 0)
+                break;
+            pos += used;
+            count++;
+        }
+    }
+    else if(receiveACK[12] == COMMAND_INAUTOPOLL + 1){
+        /*! Each InAutoPoll entry is Type, Len, then InListPassiveTarget-style target data*/
+        for(uint8_t i = 0; i < receiveACK[13] && count < maxTargets; i++){
+            if(pos + 2 > end)
+                break;
+            uint8_t type = receiveACK[pos];
+            uint8_t len = receiveACK[pos + 1];
+            pos += 2;
+            if((type == AUTOPOLL_TYPE_MIFARE || type == 0x00 || type == 0x20) &&
+                    parseTarget(pos, min(pos + len, (int)end), &targets[count]) != 0)
+                count++;
+            pos += len;
+        }
+    }
+    return count;
+}
+
+uint8_t DFRobot_PN532::parseTarget(uint8_t pos, uint8_t end, sTarget_t *target)
+{
+    /*! Tg, SENS_RES[2], SEL_RES, NFCIDLength, NFCID1[], then ATS if SEL_RES says ISO14443-4*/
+    if(pos + 5 > end)
+        return 0;
+    uint8_t uidLength = receiveACK[pos + 4];
+    if(uidLength > PN532_MAX_UID_LENGTH || pos + 5 + uidLength > end)
+        return 0;
+    target->tg = receiveACK[pos];
+    target->ATQA[0] = receiveACK[pos + 1];
+    target->ATQA[1] = receiveACK[pos + 2];
+    target->SAK = receiveACK[pos + 3];
+    target->uid.length = uidLength;
+    memcpy(target->uid.bytes, receiveACK + pos + 5, uidLength);
+    uint8_t used = 5 + uidLength;
+    if((target->SAK & 0x20) && pos + used < end)
+        used += receiveACK[pos + used];   // ATS length byte counts itself
+    return used;
+}
+
+bool DFRobot_PN532::setPassiveActivationRetries(uint8_t retries)
+{
+    if(!this->nfcEnable)
+        return false;
+    uint8_t cmdConfig[5];
+    cmdConfig[0] = COMMAND_RFCONFIGURATION;
+    cmdConfig[1] = 0x05;                           // CfgItem 5: MxRtyATR, MxRtyPSL, MxRtyPassiveActivation
+    cmdConfig[2] = 0xFF;
+    cmdConfig[3] = 0x01;
+    cmdConfig[4] = retries;
+    writeCommand(cmdConfig,5);
+    if(!readAck(15))
+        return false;
+    return receiveACK[12] == COMMAND_RFCONFIGURATION + 1;
+}
+
+bool DFRobot_PN532::powerDown(uint8_t wakeSources)
+{
+    if(!this->nfcEnable)
         return false;
-    for(int i = 0; i < 4; i++)
-        nfcUid[i] = receiveACK[i + 19];
-    /*for(int i= 0 ; i<32 ;i++){
-        Serial.print(receiveACK[i]);
-        Serial.print(" ");
-    }*/
-    if(receiveACK[13]!=1)
+    uint8_t cmdPowerDown[3];
+    cmdPowerDown[0] = COMMAND_POWERDOWN;
+    cmdPowerDown[1] = wakeSources;
+    cmdPowerDown[2] = 0x01;                        // GenerateIRQ on wake-up
+    writeCommand(cmdPowerDown,3);
+    if(!readAck(16))
         return false;
+    if(receiveACK[12] != COMMAND_POWERDOWN + 1 || receiveACK[13] != 0x00)
+        return false;
+    poweredDown = true;
     return true;
 }
 
@@ -377,64 +434,219 @@ String DFRobot_PN532::readUid()
         return "wake up error!";
     if(!scan())
         return "no card!";
-    String nfcUidSrt = "";
-    for(int i = 0; i < 4; i++)
-    {
-        if(nfcUid[i] <= 0x0f){
-            nfcUidSrt += "0";
-            nfcUidSrt += String(nfcUid[i],HEX);
-        }
-        else
-            nfcUidSrt += String(nfcUid[i],HEX);
-    }
+    char nfcUidSrt[2 * PN532_MAX_UID_LENGTH + 1];
+    nfcUid.toHex(nfcUidSrt, sizeof(nfcUidSrt), false);
     return nfcUidSrt;
 }
 
+bool DFRobot_PN532::readUid(sUid_t &uid)
+{
+    if(!this->nfcEnable || !scan())
+        return false;
+    uid = nfcUid;
+    return true;
+}
+
+bool DFRobot_PN532::sUid::operator==(const sUid &other) const
+{
+    return length == other.length && memcmp(bytes, other.bytes, length) == 0;
+}
+
+size_t DFRobot_PN532::sUid::toHex(char *buffer, size_t size, bool upper) const
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    if(size == 0)
+        return 0;
+    size_t n = 0;
+    for(uint8_t i = 0; i < length && n + 2 < size; i++){
+        buffer[n++] = digits[bytes[i] >> 4];
+        buffer[n++] = digits[bytes[i] & 0x0F];
+    }
+    buffer[n] = '\0';
+    return n;
+}
+
 
 uint8_t DFRobot_PN532::readData(uint8_t *buffer,uint8_t block){
-    if(!this->nfcEnable)
-        return -1;
-    String error = this->readData(block);
-    if(error == "no card!" || error == "read error!" || error =="unknown error!"
-                        || error == "read timeout!" || error == "wake up error!" ||error =="flase")
+    if(this->readBlock(block, this->blockData) != eStatusOK)
         return -1;
     memcpy(buffer,blockData,16);
     return  1;
     
 }
-String DFRobot_PN532::readData(int page) {
-    if (page > 255)
-        return "flase";
+DFRobot_PN532::eStatus_t DFRobot_PN532::readBlock(int block, uint8_t *buffer) {
+    return readBlocks(block, 1, buffer);
+}
+
+DFRobot_PN532::eStatus_t DFRobot_PN532::beginSession(void) {
     if(!this->nfcEnable)
-        return "wake up error!";
+        return eStatusNotEnabled;
+    _sessionActive = false;
+    _authSector = -1;
+    _fastRead = true;
     if(!scan())
-        return "no card!";
-    if(!passWordCheck(page,nfcUid,nfcPassword))
-        return "read error!";
-    unsigned char cmdRead[4];
-        cmdRead[0] = COMMAND_INDATAEXCHANGE;
-        cmdRead[1] = 1;                   /* Card number */
-        cmdRead[2] = CARD_CMD_READING;     /* Mifare Read command = 0x30 */
-        cmdRead[3] = page; 
-    
-    writeCommand(cmdRead,4);
-    if(!readAck(32))
-        return "read timeout!";
-    String dataSrt = "";
-    if(checkDCS(32) == 1 && receiveACK[12] == 0x41 && receiveACK[13] == 0x00){
-        for(int i = 0; i<16; i++)
-        {
-            blockData[i] = receiveACK[i + 14];
-            if(receiveACK[i+14]<=0x0f){
-                dataSrt += "0";
-                dataSrt += String(receiveACK[i + 14],HEX);
+        return eStatusNoCard;
+    _sessionActive = true;
+    return eStatusOK;
+}
+
+void DFRobot_PN532::endSession(void) {
+    _sessionActive = false;
+    _authSector = -1;
+}
+
+DFRobot_PN532::eStatus_t DFRobot_PN532::authenticate(int block) {
+    /*! 32 sectors of 4 blocks, then 8 sectors of 16 blocks (MIFARE Classic 4K)*/
+    int sector = block < 128 ? block / 4 : 32 + (block - 128) / 16;
+    if(sector == _authSector)
+        return eStatusOK;
+    if(!passWordCheck(block,nfcUid.bytes,nfcPassword)){
+        /*! A failed authentication halts the card; the next one needs a fresh selection*/
+        _authSector = -1;
+        if(!scan())
+            _sessionActive = false;
+        return eStatusAuthError;
+    }
+    _authSector = sector;
+    return eStatusOK;
+}
+
+DFRobot_PN532::eStatus_t DFRobot_PN532::exchange(const uint8_t *cardCmd, uint8_t cmdlen, uint8_t *data, uint8_t dataLen, bool thru) {
+    /*! InDataExchange to target 1, or InCommunicateThru for raw commands the PN532 would
+        otherwise interpret (GET_VERSION shares its code with MIFARE AUTH_A).
+        The response is D5 41/43 status data[dataLen] DCS*/
+    uint8_t cmd[20];
+    uint8_t header = 0;
+    uint8_t code = thru ? COMMAND_INCOMMUNICATETHRU : COMMAND_INDATAEXCHANGE;
+    cmd[header++] = code;
+    if(!thru)
+        cmd[header++] = 1;
+    memcpy(cmd + header, cardCmd, cmdlen);
+    writeCommand(cmd, cmdlen + header);
+    int frameLen = 16 + dataLen;
+    if(frameLen > (int)sizeof(receiveACK) || !readAck(frameLen))
+        return eStatusTimeout;
+    if(receiveACK[12] != code + 1 || receiveACK[13] != 0x00)
+        return eStatusCardError;
+    if(dataLen > 0 && checkDCS(frameLen) != 1)
+        return eStatusCardError;
+    if(data)
+        memcpy(data, receiveACK + 14, dataLen);
+    return eStatusOK;
+}
+
+DFRobot_PN532::eStatus_t DFRobot_PN532::readBlocks(int block, uint8_t count, uint8_t *buffer) {
+    if (block < 0 || block + count > 256)
+        return eStatusInvalidBlock;
+    bool ownSession = !_sessionActive;
+    if(ownSession){
+        eStatus_t status = beginSession();
+        if(status != eStatusOK)
+            return status;
+    }
+    eStatus_t status = eStatusOK;
+    for(uint8_t i = 0; i < count && status == eStatusOK; i++){
+        status = authenticate(block + i);
+        if(status != eStatusOK)
+            break;
+        uint8_t cardCmd[2] = {CARD_CMD_READING, (uint8_t)(block + i)};   /* Mifare Read command = 0x30 */
+        status = exchange(cardCmd, 2, buffer + 16 * i, 16);
+    }
+    if(ownSession)
+        endSession();
+    return status;
+}
+
+DFRobot_PN532::eStatus_t DFRobot_PN532::writeBlocks(int block, uint8_t count, const uint8_t *data) {
+    for(int b = block; b < block + count; b++){
+        if(b < 128 && ( (b + 1)%4 == 0 || b ==0 ))
+            return eStatusInvalidBlock;
+        if((b >127 && b <256) && ((b + 1)%16 == 0))
+            return eStatusInvalidBlock;
+        if(b > 255 || b < 0)
+            return eStatusInvalidBlock;
+    }
+    bool ownSession = !_sessionActive;
+    if(ownSession){
+        eStatus_t status = beginSession();
+        if(status != eStatusOK)
+            return status;
+    }
+    eStatus_t status = eStatusOK;
+    for(uint8_t i = 0; i < count && status == eStatusOK; i++){
+        status = authenticate(block + i);
+        if(status != eStatusOK)
+            break;
+        uint8_t cardCmd[18];
+        cardCmd[0] = CARD_CMD_WRITEINGTOMIFARECLASSIC;       /* MifareClassic Write command = 0xA0 */
+        cardCmd[1] = block + i;
+        memcpy(cardCmd + 2, data + 16 * i, 16);
+        status = exchange(cardCmd, 18, NULL, 0);
+    }
+    if(ownSession)
+        endSession();
+    return status;
+}
+
+DFRobot_PN532::eStatus_t DFRobot_PN532::readPages(uint8_t page, uint16_t count, uint8_t *buffer) {
+    if (page + count > 256)
+        return eStatusInvalidBlock;
+    bool ownSession = !_sessionActive;
+    if(ownSession){
+        eStatus_t status = beginSession();
+        if(status != eStatusOK)
+            return status;
+    }
+    /*! As many pages as fit one response frame*/
+    const uint8_t maxPages = (sizeof(receiveACK) - 16) / 4;
+    uint8_t chunk[16];
+    eStatus_t status = eStatusOK;
+    while(count > 0 && status == eStatusOK){
+        if(_fastRead){
+            uint8_t n = count < maxPages ? count : maxPages;
+            uint8_t cardCmd[3] = {CARD_CMD_FAST_READ, page, (uint8_t)(page + n - 1)};
+            status = exchange(cardCmd, 3, buffer, n * 4);
+            if(status == eStatusOK){
+                page += n;
+                count -= n;
+                buffer += n * 4;
+                continue;
             }
-            else
-                dataSrt += String(receiveACK[i + 14],HEX);
-            if(i<15) dataSrt += " ";
+            /*! Tag without FAST_READ (e.g. Ultralight): the NAK halted it, reselect and fall back to READ*/
+            _fastRead = false;
+            if(!scan()){
+                _sessionActive = false;
+                break;
+            }
+            status = eStatusOK;
+        }
+        /*! READ returns 4 pages (16 bytes), rolling over at the end of memory*/
+        uint8_t cardCmd[2] = {CARD_CMD_READING, page};
+        status = exchange(cardCmd, 2, chunk, 16);
+        if(status == eStatusOK){
+            uint8_t n = count < 4 ? count : 4;
+            memcpy(buffer, chunk, n * 4);
+            page += n;
+            count -= n;
+            buffer += n * 4;
         }
     }
-    return dataSrt;
+    if(ownSession)
+        endSession();
+    return status;
+}
+
+const char *DFRobot_PN532::statusString(eStatus_t status) {
+    switch(status){
+    case eStatusOK:           return "ok";
+    case eStatusNotEnabled:   return "wake up error!";
+    case eStatusInvalidBlock: return "invalid block!";
+    case eStatusNoCard:       return "no card!";
+    case eStatusAuthError:    return "read error!";
+    case eStatusTimeout:      return "read timeout!";
+    case eStatusCardError:    return "card error!";
+    }
+    return "unknown error!";
 }
 /*
     Send commands to the chip through the iic ports*/
@@ -442,101 +654,216 @@ String DFRobot_PN532::readData(int page) {
 void DFRobot_PN532_IIC::writeCommand(uint8_t* cmd, uint8_t cmdlen) {     
     uint8_t checksum;
     cmdlen++;
-    delay(2);     // Delay for random time to wake up NFC module
-    // I2C START
-    Wire.beginTransmission(I2C_ADDRESS);
+    if(poweredDown)
+        wakeUp();
+    /*! Arm the transaction before the frame goes out so the ACK edge is not missed*/
+    _irqPending = false;
+    _state = eTransactionWaitAck;
+    _startMillis = millis();
+    _startMicros = micros();
+    if(cmdlen + 7 > PN532_PACKBUFFSIZ){
+        _state = eTransactionError;
+        return;
+    }
+    uint8_t frame[PN532_PACKBUFFSIZ];
+    uint8_t n = 0;
     checksum = PN532_PREAMBLE + PN532_STARTCODE1 + PN532_STARTCODE2;
-    Wire.write(PN532_PREAMBLE);
-    Wire.write(PN532_STARTCODE1);
-    Wire.write(PN532_STARTCODE2);
-    Wire.write(cmdlen);
-    Wire.write(~cmdlen + 1);
-    Wire.write(HOSTTOPN532);
+    frame[n++] = PN532_PREAMBLE;
+    frame[n++] = PN532_STARTCODE1;
+    frame[n++] = PN532_STARTCODE2;
+    frame[n++] = cmdlen;
+    frame[n++] = ~cmdlen + 1;
+    frame[n++] = HOSTTOPN532;
     checksum += HOSTTOPN532;
     for (uint8_t i = 0; i < cmdlen - 1; i++) {
-      Wire.write(cmd[i]);
+      frame[n++] = cmd[i];
       checksum += cmd[i];
     }
-    Wire.write((byte)~checksum);
-    Wire.write((byte)PN532_POSTAMBLE);
-    Wire.endTransmission();
+    frame[n++] = (byte)~checksum;
+    frame[n++] = (byte)PN532_POSTAMBLE;
+    if(!_bus->write(I2C_ADDRESS, frame, n))
+        _state = eTransactionError;
 }
 
 bool DFRobot_PN532_IIC::readAck(int x,long timeout ) {
-    uint8_t pn532ack[6];
-    pn532ack[0] = 0x00;
-    pn532ack[1] = 0x00;
-    pn532ack[2] = 0xFF;
-    pn532ack[3] = 0x00;
-    pn532ack[4] = 0xFF;
-    pn532ack[5] = 0x00;
-	timeout = 0;
-    if(_mode == 1){
-    if(!waitRemind())
+    /*! Blocking wrapper over the transaction engine for the synchronous API*/
+    if(_state == eTransactionIdle)
         return false;
-    Wire.requestFrom(I2C_ADDRESS,8);
-    Wire.read();
-    for(int i = 0; i < 6; i++){
-        delay(1);
-        receiveACK[i]= Wire.read();
-    }
-    if(!waitRemind() ) return false;
-    
-    Wire.requestFrom(I2C_ADDRESS,x-4);
-    Wire.read();
-    for(int i = 0; i < x - 6; i++){
+    _responseLen = min(x, (int)sizeof(receiveACK));
+    _timeout = timeout;
+    eTransaction_t state;
+    while((state = poll()) == eTransactionWaitAck || state == eTransactionWaitResponse){
         delay(1);
-        receiveACK[6 + i] = Wire.read();
-    }
-    
     }
-    else if(_mode == 0){
-    delay(30);
-    Wire.requestFrom(I2C_ADDRESS,8);
-    Wire.read();
-    for(int i = 0; i < 6; i++){
-        delay(1);
-        receiveACK[i]= Wire.read();
-    }
-    
-    delay(30);
-    Wire.requestFrom(I2C_ADDRESS,x-4);
-    Wire.read();
-    for(int i = 0; i < x - 6; i++){
-        delay(1);
-        receiveACK[6 + i] = Wire.read();
+    return state == eTransactionDone;
+}
+
+bool DFRobot_PN532_IIC::startCommand(uint8_t *cmd, uint8_t cmdlen, uint8_t responseLen, uint32_t timeout) {
+    if(!this->nfcEnable || isBusy())
+        return false;
+    if(responseLen > sizeof(receiveACK))
+        responseLen = sizeof(receiveACK);
+    _responseLen = responseLen;
+    _timeout = timeout;
+    writeCommand(cmd, cmdlen);
+    return _state != eTransactionError;
+}
+
+bool DFRobot_PN532_IIC::startScan(uint8_t maxTargets) {
+    maxTargets = max(min(maxTargets, PN532_MAX_TARGETS), 1);
+    uint8_t cmdnfcUid[3];
+    cmdnfcUid[0] = COMMAND_INLISTPASSIVETARGET;
+    cmdnfcUid[1] = maxTargets;
+    cmdnfcUid[2] = MIFARE_ISO14443A;
+    return startCommand(cmdnfcUid, 3, maxTargets == 1 ? 32 : PN532_TARGETFRAME_LEN);
+}
+
+bool DFRobot_PN532_IIC::startAutoPoll(uint8_t pollCount, uint8_t period) {
+    uint8_t cmdAutoPoll[4];
+    cmdAutoPoll[0] = COMMAND_INAUTOPOLL;
+    cmdAutoPoll[1] = pollCount;
+    cmdAutoPoll[2] = period;
+    cmdAutoPoll[3] = AUTOPOLL_TYPE_MIFARE;
+    /*! Worst case the PN532 answers after pollCount rounds of period * 150 ms*/
+    uint32_t timeout = pollCount == 0xFF ? 0xFFFFFFFF : 1000 + (uint32_t)pollCount * period * 150;
+    return startCommand(cmdAutoPoll, 4, PN532_TARGETFRAME_LEN, timeout);
+}
+
+void DFRobot_PN532_IIC::abortCommand(void) {
+    if(!isBusy())
+        return;
+    static const uint8_t pn532ack[6] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+    _bus->write(I2C_ADDRESS, pn532ack, sizeof(pn532ack));
+    _state = eTransactionIdle;
+}
+
+DFRobot_PN532::eTransaction_t DFRobot_PN532_IIC::poll(void) {
+    static const uint8_t pn532ack[6] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+
+    switch(_state){
+    case eTransactionWaitAck:
+        if(frameReady()){
+            if(!readFrame(receiveACK, 6) || memcmp(pn532ack, receiveACK, 6) != 0){
+                _state = eTransactionError;
+                break;
+            }
+            _state = eTransactionWaitResponse;
+        }
+        break;
+    case eTransactionWaitResponse:
+        if(frameReady()){
+            if(!readFrame(receiveACK + 6, _responseLen - 6)){
+                _state = eTransactionError;
+                break;
+            }
+            _lastLatency = micros() - _startMicros;
+            _state = eTransactionDone;
+        }
+        break;
+    default:
+        break;
     }
+    if(isBusy() && millis() - _startMillis > _timeout){
+        /*! Abort it on the PN532 too, or it keeps running and ignores the next command*/
+        _bus->write(I2C_ADDRESS, pn532ack, sizeof(pn532ack));
+        _state = eTransactionTimeout;
     }
-    if(strncmp((char *)pn532ack,(char *)receiveACK, 6)!=0){
-        return false ;
+    /*! Terminal states are reported once, then the engine is idle again*/
+    eTransaction_t state = _state;
+    if(!isBusy())
+        _state = eTransactionIdle;
+    return state;
+}
+
+bool DFRobot_PN532_IIC::isBusy(void) {
+    return _state == eTransactionWaitAck || _state == eTransactionWaitResponse;
+}
+
+DFRobot_PN532::eTransaction_t DFRobot_PN532_IIC::getState(void) {
+    return _state;
+}
+
+uint32_t DFRobot_PN532_IIC::getLastLatency(void) {
+    return _lastLatency;
+}
+
+void DFRobot_PN532_IIC::wakeUp(void) {
+    /*! The address match wakes the PN532; the frame itself may be lost, so send none*/
+    _bus->write(I2C_ADDRESS, nullptr, 0);
+    delay(PN532_WAKEUP_DELAY);
+    /*! Reading the status byte releases the wake-up IRQ*/
+    uint8_t status;
+    _bus->read(I2C_ADDRESS, &status, 1);
+    _irqPending = false;
+    poweredDown = false;
+}
+
+bool DFRobot_PN532_IIC::frameReady(void) {
+    if(_mode == 1){
+        /*! IRQ is active low; the level check covers an edge that fired before the engine was armed*/
+        if(!_irqPending && digitalRead(_irq) != 0)
+            return false;
+        _irqPending = false;
+        return true;
     }
+    /*! Polling mode: the first byte of every I2C read is the PN532 status byte, bit 0 = ready*/
+    uint8_t status;
+    if(_bus->read(I2C_ADDRESS, &status, 1) != 1)
+        return false;
+    return (status & 0x01) != 0;
+}
+
+bool DFRobot_PN532_IIC::readFrame(uint8_t *buffer, uint8_t len) {
+    /*! One bulk read: status byte followed by the frame*/
+    uint8_t raw[PN532_PACKBUFFSIZ + 1];
+    if(len > PN532_PACKBUFFSIZ || _bus->read(I2C_ADDRESS, raw, len + 1) != len + 1)
+        return false;
+    if((raw[0] & 0x01) == 0)
+        return false;
+    memcpy(buffer, raw + 1, len);
     return true;
 }
+
+void DFRobot_PN532_IIC::onIrq(void) {
+    _irqPending = true;
+}
+
+/*! Default transport: the global Wire object*/
+class DFRobot_PN532_WireBus : public DFRobot_PN532_Bus
+{
+public:
+  bool write(uint8_t address, const uint8_t *data, uint8_t len) override {
+    Wire.beginTransmission(address);
+    if(len)
+        Wire.write(data, len);
+    return Wire.endTransmission() == 0;
+  }
+  uint8_t read(uint8_t address, uint8_t *data, uint8_t len) override {
+    uint8_t n = Wire.requestFrom(address, len);
+    for(uint8_t i = 0; i < n; i++)
+        data[i] = Wire.read();
+    return n;
+  }
+};
+static DFRobot_PN532_WireBus wireBus;
+
+void DFRobot_PN532_IIC::setBus(DFRobot_PN532_Bus *bus) {
+    _bus = bus ? bus : &wireBus;
+}
+
 DFRobot_PN532_IIC::DFRobot_PN532_IIC(uint8_t irq,uint8_t mode){
+    _bus = &wireBus;
     
     _irq = irq;
     pinMode(_irq, INPUT);
     _mode = mode;
-}
-bool DFRobot_PN532_IIC::waitRemind(){
-    uint16_t timeout = 1000;
-    uint16_t timer = 0;
-     //digitalRead(_irq)
-    //return ret == 0;
-    //bool b = digitalRead(_irq);
-    //Serial.println(b);
-    while(digitalRead(_irq)!=0){
-        //Serial.print(digitalRead(_irq));
-    if (timeout != 0) {
-      timer += 10;
-      if (timer > timeout) {
-        return false;
-      }
-    }
-    delay(10);
-    }
-    //Serial.print(digitalRead(_irq));
-    return true;
+    _irqPending = false;
+    _state = eTransactionIdle;
+    _responseLen = 0;
+    _timeout = 1000;
+    _startMillis = 0;
+    _startMicros = 0;
+    _lastLatency = 0;
 }
 bool DFRobot_PN532_IIC::begin(void) {   //nfc Module initialization  
     this->nfcPassword[0] = 0xff;
@@ -550,10 +877,11 @@ bool DFRobot_PN532_IIC::begin(void) {   //nfc Module initialization
     cmdWrite[1] = 0x01; // normal mode;
     cmdWrite[2] = 0x14; // timeout 50ms * 20 = 1 second
     cmdWrite[3] = 0x01; // use IRQ pin!
-    Wire.begin();
+    /*! Wire itself is started by the application, which owns the shared bus*/
+    if(_mode == 1)
+        attachInterrupt(_irq, &DFRobot_PN532_IIC::onIrq, this, FALLING);
     nfcEnable = true;
     writeCommand(cmdWrite,4);
-    delay(10);
     
     if(readAck(14)!= 1){
         
@@ -579,9 +907,9 @@ bool DFRobot_PN532_UART::begin(HardwareSerial *serial)
     this->nfcPassword[3] = 0xff;
     this->nfcPassword[4] = 0xff;
     this->nfcPassword[5] = 0xff;
-    memset(this->receiveACK,0,35);
+    memset(this->receiveACK,0,sizeof(this->receiveACK));
     memset(this->blockData,0,16);
-    memset(this->nfcUid,0,4);
+    memset(&this->nfcUid,0,sizeof(this->nfcUid));
     unsigned char wake[24] = {0x55, 0x55, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x03, 0xfd, 0xd4, 0x14, 0x01, 0x17, 0x00};//Wake up NFC module
     for(int i = 0; i < 24; i++)
@@ -16,7 +16,8 @@
 #include <Wire.h>
 #include "Particle.h"
 
-#define PN532_PACKBUFFSIZ                   (64  )//The size of the packet buffer
+#define PN532_PACKBUFFSIZ                   (128 )//The size of the packet buffer
+#define PN532_TARGETFRAME_LEN               (64  )//Bytes read for a multi-target InListPassiveTarget/InAutoPoll response
 #define PN532_PREAMBLE                      (0x00)
 #define PN532_STARTCODE1                    (0x00)
 #define PN532_STARTCODE2                    (0xFF)
@@ -27,10 +28,23 @@
 #define COMMAND_SAMCONFIGURATION            (0x14)//SAM Configuration Commands
 #define COMMAND_INLISTPASSIVETARGET         (0x4A)
 #define COMMAND_INDATAEXCHANGE              (0x40)
+#define COMMAND_RFCONFIGURATION             (0x32)
+#define COMMAND_INAUTOPOLL                  (0x60)
+#define COMMAND_INCOMMUNICATETHRU           (0x42)
+#define COMMAND_POWERDOWN                   (0x16)
+#define PN532_WAKEUP_I2C                    (0x80)//PowerDown WakeUpEnable: I2C address match
+#define PN532_WAKEUP_RF                     (0x08)//PowerDown WakeUpEnable: external RF field detected
+#define PN532_WAKEUP_DELAY                  (2   )//ms for the oscillator to restart after a wake-up
+#define AUTOPOLL_TYPE_MIFARE                (0x10)//InAutoPoll target type: Mifare / ISO14443A 106 kbps
+#define PN532_MAX_TARGETS                   (2   )//InListPassiveTarget MaxTg limit for ISO14443A
+#define PN532_MAX_UID_LENGTH                (10  )//Triple size NFCID1
 #define I2C_ADDRESS                    (0x48 >> 1)//Device address
 #define MIFARE_ISO14443A                    (0x00)
 // CARD Commands
 #define CARD_CMD_READING                     (0x30)//Command to read data
+#define CARD_CMD_FAST_READ                   (0x3A)//NTAG21x command to read a page range
+#define CARD_CMD_GET_VERSION                 (0x60)//NTAG21x/Ultralight EV1 product version
+#define PN532_CARD_CACHE_SIZE                (8   )//Card types remembered by UID
 #define CARD_CMD_WRITEINGTOMIFARECLASSIC     (0xA0)//Command to write a card of type MifareClassic
 #define CARD_CMD_WRITEINGTONTGE              (0xA2)//Command for writing NTGE cards
 #define CARD_CMD_WRITEINGTOULTRALIGHT        (0xA2)// Command for writing ultralight cards
@@ -40,9 +54,61 @@
 
 
 
+/**
+ * @class DFRobot_PN532_Bus
+ * @brief I2C transport of DFRobot_PN532_IIC. The default goes straight to Wire; an
+ * @n application that shares the bus between drivers can supply its own.
+ */
+class DFRobot_PN532_Bus
+{
+public:
+  virtual ~DFRobot_PN532_Bus() {}
+
+  /*!
+   * @fn write
+   * @brief Write len bytes (0 for an address-only probe) followed by STOP
+   * @return Boolean type, true if the PN532 acknowledged
+   */
+  virtual bool write(uint8_t address, const uint8_t *data, uint8_t len) = 0;
+
+  /*!
+   * @fn read
+   * @brief Read len bytes followed by STOP
+   * @return Number of bytes read
+   */
+  virtual uint8_t read(uint8_t address, uint8_t *data, uint8_t len) = 0;
+};
+
 class DFRobot_PN532
 {  
 public: 
+  /**
+   * @enum eTransaction_t
+   * @brief State of an asynchronous command/response transaction
+   */
+  typedef enum{
+      eTransactionIdle = 0,     /**<No command in flight*/
+      eTransactionWaitAck,      /**<Command written, waiting for the ACK frame*/
+      eTransactionWaitResponse, /**<ACK received, waiting for the response frame*/
+      eTransactionDone,         /**<Response frame is in receiveACK*/
+      eTransactionError,        /**<Bad ACK or I2C failure*/
+      eTransactionTimeout,      /**<No response within the transaction timeout*/
+  }eTransaction_t;
+
+  /**
+   * @enum eStatus_t
+   * @brief Result of a card read/write, replaces the String status messages
+   */
+  typedef enum{
+      eStatusOK = 0,        /**<Success*/
+      eStatusNotEnabled,    /**<"wake up error!": PN532 not initialized*/
+      eStatusInvalidBlock,  /**<Block/page number out of range*/
+      eStatusNoCard,        /**<"no card!"*/
+      eStatusAuthError,     /**<"read error!": MIFARE authentication failed*/
+      eStatusTimeout,       /**<"read timeout!": no response from the PN532*/
+      eStatusCardError,     /**<Card NAK or bad checksum*/
+  }eStatus_t;
+
   typedef struct{
       uint8_t uidlenght;/**<The length of the uid*/
       int size;            
@@ -57,6 +123,39 @@ public:
       uint8_t uid[7];    /**<Uid content*/
       char cardType[30]={0};/**<The chip type*/
   }sCard_t;
+
+  /**
+   * @struct sUid_t
+   * @brief Fixed-capacity NFCID1 (4, 7 or 10 bytes) carrying its length
+   */
+  typedef struct sUid{
+      uint8_t length;                       /**<Number of valid bytes, 0 for none*/
+      uint8_t bytes[PN532_MAX_UID_LENGTH];  /**<NFCID1*/
+
+      bool operator==(const sUid &other) const;
+      bool operator!=(const sUid &other) const { return !(*this == other); }
+
+      /*!
+       * @fn toHex
+       * @brief Format as hex without heap allocation, e.g. "04A1B2C3D4E5F6"
+       * @param buffer Output, NUL terminated. 2 * PN532_MAX_UID_LENGTH + 1 bytes always suffice.
+       * @param size Size of buffer.
+       * @param upper Upper-case digits.
+       * @return Number of characters written, excluding the NUL.
+       */
+      size_t toHex(char *buffer, size_t size, bool upper = true) const;
+  }sUid_t;
+
+  /**
+   * @struct sTarget_t
+   * @brief One target enumerated by InListPassiveTarget or InAutoPoll
+   */
+  typedef struct{
+      uint8_t tg;       /**<Logical target number assigned by the PN532*/
+      uint8_t ATQA[2];  /**<SENS_RES*/
+      uint8_t SAK;      /**<SEL_RES*/
+      sUid_t uid;       /**<NFCID1*/
+  }sTarget_t;
 public: 
    /*!
     * @fn readData
@@ -113,6 +212,16 @@ public:
     */  
    String  readUid();
 
+   /*!
+    * @fn readUid
+    * @brief Obtain the full-length UID of the card without heap allocation.
+    * @param uid Receives the UID.
+    * @return Boolean type, the result of operation
+    * @retval true a card was found
+    * @retval false no card
+    */
+   bool  readUid(sUid_t &uid);
+
    /*!
     * @fn writeData
     * @brief Write a block to a MIFARE Classic NFC smart card/tag..
@@ -169,25 +278,177 @@ public:
     * @return Info. of the sCard_t.
     */
    sCard_t getInformation();
+
+   /*!
+    * @fn getInformation
+    * @brief Read the basic information of a NFC smart card/tag into card.
+    * @param card Receives the card information.
+    * @return Boolean type, false if no card was found
+    */
+   bool  getInformation(sCard_t &card);
+
+   /*!
+    * @fn readBlock
+    * @brief Read a 16-byte block from a MIFARE Classic card into buffer, without heap use.
+    * @param block The number of the block to read from.
+    * @param buffer Receives 16 bytes.
+    * @return Status code, eStatusOK on success
+    */
+   eStatus_t readBlock(int block, uint8_t *buffer);
+
+   /*!
+    * @fn writeBlock
+    * @brief Write a 16-byte block to a MIFARE Classic card.
+    * @param block The number of the block to write to. Sector trailers and block 0 are refused.
+    * @param data 16 bytes to write.
+    * @return Status code, eStatusOK when the card acknowledged the write
+    */
+   eStatus_t writeBlock(int block, const uint8_t *data);
+
+   /*!
+    * @fn beginSession
+    * @brief Select a target once for a series of block/page operations. Until endSession(),
+    * @n reads and writes reuse the selection and authenticate each sector only once.
+    * @return Status code, eStatusNoCard if no target answered
+    */
+   eStatus_t beginSession(void);
+
+   /*!
+    * @fn endSession
+    * @brief Forget the session selection and authentication
+    */
+   void endSession(void);
+
+   /*!
+    * @fn readBlocks
+    * @brief Read consecutive 16-byte MIFARE Classic blocks, authenticating each sector once.
+    * @param block The first block to read.
+    * @param count Number of blocks.
+    * @param buffer Receives count * 16 bytes.
+    * @return Status code, eStatusOK on success
+    */
+   eStatus_t readBlocks(int block, uint8_t count, uint8_t *buffer);
+
+   /*!
+    * @fn writeBlocks
+    * @brief Write consecutive 16-byte MIFARE Classic blocks, authenticating each sector once.
+    * @param block The first block to write. Sector trailers and block 0 are refused.
+    * @param count Number of blocks.
+    * @param data count * 16 bytes to write.
+    * @return Status code, eStatusOK when every write was acknowledged
+    */
+   eStatus_t writeBlocks(int block, uint8_t count, const uint8_t *data);
+
+   /*!
+    * @fn readPages
+    * @brief Read consecutive 4-byte NTAG/Ultralight pages. Uses FAST_READ ranges where
+    * @n the tag supports it, else READ (4 pages per command).
+    * @param page The first page to read.
+    * @param count Number of pages.
+    * @param buffer Receives count * 4 bytes.
+    * @return Status code, eStatusOK on success
+    */
+   eStatus_t readPages(uint8_t page, uint16_t count, uint8_t *buffer);
+
+   /*!
+    * @fn statusString
+    * @brief Human readable text for a status code (static storage)
+    */
+   static const char *statusString(eStatus_t status);
+
+   /*!
+    * @fn parseScan
+    * @brief Decode the InListPassiveTarget response held in receiveACK into nfcUid.
+    * @return Boolean type, the result of operation
+    * @retval true exactly one target was listed
+    * @retval false no card
+    */
+   bool  parseScan(void);
+
+   /*!
+    * @fn scanTargets
+    * @brief Enumerate up to PN532_MAX_TARGETS ISO14443A targets in one RF cycle.
+    * @param targets Result array.
+    * @param maxTargets Capacity of the result array (MaxTg, 1 or 2).
+    * @return Number of targets found.
+    */
+   uint8_t scanTargets(sTarget_t *targets, uint8_t maxTargets = PN532_MAX_TARGETS);
+
+   /*!
+    * @fn parseTargets
+    * @brief Decode an InListPassiveTarget or InAutoPoll response held in receiveACK.
+    * @param targets Result array.
+    * @param maxTargets Capacity of the result array.
+    * @return Number of targets decoded.
+    */
+   uint8_t parseTargets(sTarget_t *targets, uint8_t maxTargets);
+
+   /*!
+    * @fn setPassiveActivationRetries
+    * @brief Bound the number of InListPassiveTarget retries (RFConfiguration item 5).
+    * @n The power-on default of 0xFF retries forever, so a scan with no card never answers.
+    * @param retries Number of retries, 0xFF for infinite.
+    * @return Boolean type, the result of operation
+    */
+   bool  setPassiveActivationRetries(uint8_t retries);
+
+   /*!
+    * @fn powerDown
+    * @brief Put the PN532 in Power Down mode (PowerDown command), RF field off.
+    * @n The IRQ pin is pulled low when a wake-up source other than the host fires.
+    * @param wakeSources WakeUpEnable bits, e.g. PN532_WAKEUP_I2C | PN532_WAKEUP_RF.
+    * @return Boolean type, the result of operation
+    */
+   bool  powerDown(uint8_t wakeSources);
+
+   /*!
+    * @fn isPoweredDown
+    * @brief Whether the PN532 was put in Power Down and has not been woken since
+    */
+   bool  isPoweredDown(void) { return poweredDown; }
      
 
-   uint8_t receiveACK[35];    
+   uint8_t receiveACK[PN532_PACKBUFFSIZ];    
    uint8_t nfcPassword[6]; 
-   uint8_t nfcUid[4]; 
+   sUid_t nfcUid; 
    uint8_t blockData[16];
    bool nfcEnable;
+   bool poweredDown = false;
    long uartTimeout; 
    uint8_t _irq;
    uint8_t _mode;
      
 private:
        
-   String readData(int page);
    virtual void writeCommand(uint8_t *command_data, uint8_t bytes)=0;
    bool virtual readAck(int x,long timeout = 1000)=0;
    bool  passWordCheck (int blockNumber,uint8_t nfcuid[],  uint8_t keyData[]);
    bool  checkDCS(int x);
-   uint8_t getUltraversion(uint8_t block);
+   uint8_t parseTarget(uint8_t pos, uint8_t end, sTarget_t *target);
+   eStatus_t authenticate(int block);
+   eStatus_t exchange(const uint8_t *cardCmd, uint8_t cmdlen, uint8_t *data, uint8_t dataLen, bool thru = false);
+
+   bool _sessionActive = false;
+   bool _fastRead = true;       /**<Tag accepted FAST_READ in this session*/
+   int _authSector = -1;        /**<Sector authenticated in this session, -1 for none*/
+
+   typedef struct{
+       const char *name;
+       const char *technology;
+       int size;
+       int usersize;
+       int blockSize;
+       int blockNumber;
+       uint8_t sectorSize;
+   }sCardType_t;
+   static const sCardType_t cardTypes[];
+   uint8_t identify(const sTarget_t &target);
+
+   struct{
+       sUid_t uid;
+       uint8_t type;
+   }_cardCache[PN532_CARD_CACHE_SIZE] = {};
+   uint8_t _cardCacheNext = 0;
       
 };
 class DFRobot_PN532_IIC : public DFRobot_PN532
@@ -210,12 +471,98 @@ public:
    * @retval false Initialization failed
    */
    bool begin(void);
-    
+
+  /*!
+   * @fn startCommand
+   * @brief Write a command frame and return at once; completion is driven by poll()
+   * @param cmd Command bytes (without frame header)
+   * @param cmdlen Number of command bytes
+   * @param responseLen Number of bytes expected in receiveACK, ACK frame included
+   * @param timeout Transaction timeout in ms
+   * @return Boolean type, false if a transaction is already in flight
+   */
+   bool startCommand(uint8_t *cmd, uint8_t cmdlen, uint8_t responseLen, uint32_t timeout = 1000);
+
+  /*!
+   * @fn startScan
+   * @brief Submit an InListPassiveTarget for one ISO14443A target without waiting
+   * @return Boolean type, false if a transaction is already in flight
+   */
+   bool startScan(uint8_t maxTargets = 1);
+
+  /*!
+   * @fn startAutoPoll
+   * @brief Submit an InAutoPoll for ISO14443A targets. The PN532 polls on its own and
+   * @n only answers (raising IRQ) once a target is found or pollCount polls expire.
+   * @param pollCount Number of polling rounds, 0xFF for endless.
+   * @param period Pause between rounds in units of 150 ms.
+   * @return Boolean type, false if a transaction is already in flight
+   */
+   bool startAutoPoll(uint8_t pollCount, uint8_t period);
+
+  /*!
+   * @fn abortCommand
+   * @brief Abort the in-flight command (e.g. an endless InAutoPoll) by sending an ACK frame
+   */
+   void abortCommand(void);
+
+  /*!
+   * @fn poll
+   * @brief Advance the in-flight transaction. Never blocks: each frame is read with
+   * @n a single bus read once the PN532 signals it is ready.
+   * @return Current transaction state. Done/Error/Timeout are reported once, then Idle.
+   */
+   eTransaction_t poll(void);
+
+  /*!
+   * @fn isBusy
+   * @brief Whether a command is in flight
+   */
+   bool isBusy(void);
+
+  /*!
+   * @fn getState
+   * @brief Current transaction state, without advancing it
+   */
+   eTransaction_t getState(void);
+
+  /*!
+   * @fn getLastLatency
+   * @brief Duration of the last completed transaction, from command write to response read
+   * @return Latency in microseconds
+   */
+   uint32_t getLastLatency(void);
+
+  /*!
+   * @fn setBus
+   * @brief Route all I2C traffic through another transport. Call before begin().
+   * @param bus Transport, nullptr restores the default Wire transport.
+   */
+   void setBus(DFRobot_PN532_Bus *bus);
+
+  /*!
+   * @fn wakeUp
+   * @brief Wake the PN532 from Power Down with an I2C address match and clear the
+   * @n wake-up IRQ. Commands do this on their own when needed.
+   */
+   void wakeUp(void);
         
 private:
     void writeCommand(uint8_t* cmd, uint8_t cmdlen);
     bool readAck(int x,long timeout = 1000); 
-    bool waitRemind();
+    bool frameReady(void);
+    bool readFrame(uint8_t *buffer, uint8_t len);
+    void onIrq(void);
+
+    DFRobot_PN532_Bus *_bus;
+
+    volatile bool _irqPending;
+    eTransaction_t _state;
+    uint8_t _responseLen;
+    uint32_t _timeout;
+    uint32_t _startMillis;
+    uint32_t _startMicros;
+    uint32_t _lastLatency;
 };
 
 class DFRobot_PN532_UART:public DFRobot_PN532
@@ -206,6 +206,18 @@
 #include "it8951/GxEPD2_it103_1872x1404.h"
 #endif
 
+// shadow frame rows are compared as 32 bit words
+#define GxEPD2_SHADOW_WORD sizeof(uint32_t)
+
+// dirty tracking: changed pixels are collected in up to GxEPD2_DIRTY_RECTS byte aligned rectangles,
+// a pixel within GxEPD2_DIRTY_MERGE_GAP of a rectangle extends it
+#ifndef GxEPD2_DIRTY_RECTS
+#define GxEPD2_DIRTY_RECTS 4
+#endif
+#ifndef GxEPD2_DIRTY_MERGE_GAP
+#define GxEPD2_DIRTY_MERGE_GAP 16
+#endif
+
 template<typename GxEPD2_Type, const uint16_t page_height>
 class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
 {
@@ -223,6 +235,12 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
       _mirror = false;
       _using_partial_mode = false;
       _current_page = 0;
+      _track_dirty = false;
+      _dirty_count = 0;
+      _dirty_last = 0;
+      _shadow = 0;
+      _shadow_valid = false;
+      _diff_us = 0;
       setFullWindow();
     }
 
@@ -272,15 +290,18 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
       y -= _current_page * _page_height;
       // check if in current page
       if ((y < 0) || (y >= int16_t(_page_height))) return;
-      uint16_t i = x / 8 + y * (_pw_w / 8);
+      uint32_t i = x / 8 + uint32_t(y) * (_pw_w / 8); // full frame buffers can exceed 64k
+      uint8_t previous = _buffer[i];
       if (color)
         _buffer[i] = (_buffer[i] | (1 << (7 - x % 8)));
       else
         _buffer[i] = (_buffer[i] & (0xFF ^ (1 << (7 - x % 8))));
+      if (_track_dirty && (_buffer[i] != previous)) _markDirty(x, y, 1, 1);
     }
 
     void init(uint32_t serial_diag_bitrate = 0) // = 0 : disabled
     {
+      _shadow_valid = false;
       epd2.init(serial_diag_bitrate);
       _using_partial_mode = false;
       _current_page = 0;
@@ -295,6 +316,7 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
     // pulldown_rst_mode true for alternate RST handling to avoid feeding 5V through RST pin
     void init(uint32_t serial_diag_bitrate, bool initial, uint16_t reset_duration = 10, bool pulldown_rst_mode = false)
     {
+      _shadow_valid = false;
       epd2.init(serial_diag_bitrate, initial, reset_duration, pulldown_rst_mode);
       _using_partial_mode = false;
       _current_page = 0;
@@ -306,6 +328,7 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
     // SPISettings spi_settings: e.g. for higher SPI speed selection
     void init(uint32_t serial_diag_bitrate, bool initial, uint16_t reset_duration, bool pulldown_rst_mode, SPIClass& spi, SPISettings spi_settings)
     {
+      _shadow_valid = false;
       epd2.selectSPI(spi, spi_settings);
       epd2.init(serial_diag_bitrate, initial, reset_duration, pulldown_rst_mode);
       _using_partial_mode = false;
@@ -322,15 +345,134 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
     void fillScreen(uint16_t color) // 0x0 black, >0x0 white, to buffer
     {
       uint8_t data = (color == GxEPD_BLACK) ? 0x00 : 0xFF;
-      for (uint16_t x = 0; x < sizeof(_buffer); x++)
+      if (_track_dirty)
+      {
+        // only the rows between the first and last changed byte are dirty
+        uint32_t first = sizeof(_buffer), last = 0;
+        for (uint32_t x = 0; x < sizeof(_buffer); x++)
+        {
+          if (_buffer[x] == data) continue;
+          if (first == sizeof(_buffer)) first = x;
+          last = x;
+          _buffer[x] = data;
+        }
+        uint16_t wb = GxEPD2_Type::WIDTH / 8;
+        if (first < sizeof(_buffer)) _markDirty(0, first / wb, GxEPD2_Type::WIDTH, last / wb - first / wb + 1);
+        return;
+      }
+      for (uint32_t x = 0; x < sizeof(_buffer); x++)
       {
         _buffer[x] = data;
       }
     }
 
+    // dirty tracking, for a full frame buffer (pages() == 1) in full window mode:
+    // drawing records the changed pixels, displayDirty() uploads only those and refreshes their bounding box
+    void setDirtyTracking(bool enable)
+    {
+      _track_dirty = enable && (1 == _pages);
+      // controller content is unknown when tracking starts: first displayDirty() sends everything
+      _dirty_count = 0;
+      if (_track_dirty) _markDirty(0, 0, GxEPD2_Type::WIDTH, HEIGHT);
+    }
+
+    uint8_t dirtyRects()
+    {
+      return _dirty_count;
+    }
+
+    // shadow frame, for a full frame buffer (pages() == 1): shadow (sizeof frame buffer bytes, owned by the caller)
+    // keeps what the controller holds; displayDirty() then diffs against it instead of trusting the drawing record,
+    // so redrawing identical pixels costs nothing; 0 disables
+    bool setShadowFrame(uint8_t* shadow)
+    {
+      _shadow = (1 == _pages) ? shadow : 0;
+      _shadow_valid = false;
+      return _shadow != 0;
+    }
+
+    // call after writing controller memory directly (writeImage(), drawImage(), ...) with a shadow frame set
+    void invalidateShadow()
+    {
+      _shadow_valid = false;
+    }
+
+    // call after the buffer content reached the controller by other means (paged drawing, display(), ...):
+    // the shadow frame takes it over and the drawing record is cleared, so displayDirty() sends only later changes
+    void markClean()
+    {
+      if (_shadow)
+      {
+        memcpy(_shadow, _buffer, uint32_t(GxEPD2_Type::WIDTH / 8) * HEIGHT);
+        _shadow_valid = true;
+      }
+      _dirty_count = 0;
+    }
+
+    // duration of the last shadow frame compare
+    uint32_t diffTime()
+    {
+      return _diff_us;
+    }
+
+    // returns false if nothing had changed (or neither dirty tracking nor a shadow frame is set)
+    bool displayDirty()
+    {
+      if (_shadow)
+      {
+        _dirty_count = 0;
+        if (_shadow_valid) _diffShadow();
+        else _markDirty(0, 0, GxEPD2_Type::WIDTH, HEIGHT);
+      }
+      else if (!_track_dirty) return false;
+      if (0 == _dirty_count)
+      {
+        return false;
+      }
+      _coalesceDirty();
+      // the fast partial (differential) update leaves unchanged pixels alone, so one refresh of the bounding box
+      // costs the same panel time as one small rectangle, while only the rectangles are uploaded
+      uint16_t bx0 = _dirty[0].x0, by0 = _dirty[0].y0, bx1 = _dirty[0].x1, by1 = _dirty[0].y1;
+      for (uint8_t i = 0; i < _dirty_count; i++)
+      {
+        const DirtyRect& r = _dirty[i];
+        epd2.writeImagePart(_buffer, r.x0, r.y0, GxEPD2_Type::WIDTH, HEIGHT, r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0);
+        bx0 = gx_uint16_min(bx0, r.x0);
+        by0 = gx_uint16_min(by0, r.y0);
+        bx1 = gx_uint16_max(bx1, r.x1);
+        by1 = gx_uint16_max(by1, r.y1);
+      }
+      epd2.refresh(bx0, by0, bx1 - bx0, by1 - by0);
+      if (epd2.hasFastPartialUpdate)
+      {
+        for (uint8_t i = 0; i < _dirty_count; i++)
+        {
+          const DirtyRect& r = _dirty[i];
+          epd2.writeImagePartAgain(_buffer, r.x0, r.y0, GxEPD2_Type::WIDTH, HEIGHT, r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0);
+        }
+      }
+      if (_shadow)
+      {
+        const uint16_t wb = GxEPD2_Type::WIDTH / 8;
+        for (uint8_t i = 0; i < _dirty_count; i++)
+        {
+          const DirtyRect& r = _dirty[i];
+          for (uint16_t y = r.y0; y < r.y1; y++)
+          {
+            uint32_t offset = uint32_t(y) * wb + r.x0 / 8;
+            memcpy(_shadow + offset, _buffer + offset, (r.x1 - r.x0) / 8);
+          }
+        }
+        _shadow_valid = true;
+      }
+      _dirty_count = 0;
+      return true;
+    }
+
     // display buffer content to screen, useful for full screen buffer
     void display(bool partial_update_mode = false)
     {
+      _shadow_valid = false;
       if (partial_update_mode) epd2.writeImage(_buffer, 0, 0, GxEPD2_Type::WIDTH, _page_height);
       else epd2.writeImageForFullRefresh(_buffer, 0, 0, GxEPD2_Type::WIDTH, _page_height);
       epd2.refresh(partial_update_mode);
@@ -349,6 +491,7 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
     // this is an addressing limitation of the e-paper controllers
     void displayWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
     {
+      _shadow_valid = false;
       x = gx_uint16_min(x, width());
       y = gx_uint16_min(y, height());
       w = gx_uint16_min(w, width() - x);
@@ -379,6 +522,7 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
     // this is an addressing limitation of the e-paper controllers
     void setPartialWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
     {
+      _track_dirty = false; // buffer is window relative now
       _pw_x = gx_uint16_min(x, width());
       _pw_y = gx_uint16_min(y, height());
       _pw_w = gx_uint16_min(w, width() - _pw_x);
@@ -401,6 +545,7 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
 
     bool nextPage()
     {
+      _shadow_valid = false;
       if (1 == _pages)
       {
         if (_using_partial_mode)
@@ -496,6 +641,7 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
     // GxEPD style paged drawing; drawCallback() is called as many times as needed
     void drawPaged(void (*drawCallback)(const void*), const void* pv)
     {
+      _shadow_valid = false;
       if (1 == _pages)
       {
         fillScreen(GxEPD_WHITE);
@@ -602,10 +748,12 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
     //  Support for Bitmaps (Sprites) to Controller Buffer and to Screen
     void clearScreen(uint8_t value = 0xFF) // init controller memory and screen (default white)
     {
+      _shadow_valid = false;
       epd2.clearScreen(value);
     }
     void writeScreenBuffer(uint8_t value = 0xFF) // init controller memory (default white)
     {
+      _shadow_valid = false;
       epd2.writeScreenBuffer(value);
     }
     // write to controller memory, without screen refresh; x and w should be multiple of 8
@@ -691,6 +839,7 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
     // turns powerOff() and sets controller to deep sleep for minimum power use, ONLY if wakeable by RST (rst >= 0)
     void hibernate()
     {
+      _shadow_valid = false;
       epd2.hibernate();
     }
   private:
@@ -729,8 +878,140 @@ class GxEPD2_BW : public GxEPD2_GFX_BASE_CLASS
           break;
       }
     }
+    struct DirtyRect
+    {
+      uint16_t x0, y0, x1, y1; // x1, y1 exclusive
+    };
+    // x, w in pixels, widened to byte boundaries; all coordinates native (unrotated)
+    void _markDirty(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+    {
+      uint16_t x0 = x - x % 8;
+      uint16_t x1 = x + w + (8 - (x + w) % 8) % 8;
+      uint16_t y1 = y + h;
+      // fast path: consecutive pixels mostly fall into the rectangle hit last
+      if (_dirty_last < _dirty_count)
+      {
+        const DirtyRect& r = _dirty[_dirty_last];
+        if ((x0 >= r.x0) && (x1 <= r.x1) && (y >= r.y0) && (y1 <= r.y1)) return;
+      }
+      // extend a rectangle close by, else start a new one, else extend the one growing least
+      uint8_t best = 0;
+      uint32_t best_growth = UINT32_MAX;
+      for (uint8_t i = 0; i < _dirty_count; i++)
+      {
+        const DirtyRect& r = _dirty[i];
+        if (_isNear(r, x0, y, x1, y1))
+        {
+          best = i;
+          best_growth = 0;
+          break;
+        }
+        uint32_t growth = uint32_t(gx_uint16_max(r.x1, x1) - gx_uint16_min(r.x0, x0)) * (gx_uint16_max(r.y1, y1) - gx_uint16_min(r.y0, y))
+                          - uint32_t(r.x1 - r.x0) * (r.y1 - r.y0);
+        if (growth < best_growth)
+        {
+          best = i;
+          best_growth = growth;
+        }
+      }
+      if ((best_growth > 0) && (_dirty_count < GxEPD2_DIRTY_RECTS))
+      {
+        _dirty[_dirty_count] = {x0, y, x1, y1};
+        _dirty_last = _dirty_count++;
+        return;
+      }
+      DirtyRect& r = _dirty[best];
+      r.x0 = gx_uint16_min(r.x0, x0);
+      r.y0 = gx_uint16_min(r.y0, y);
+      r.x1 = gx_uint16_max(r.x1, x1);
+      r.y1 = gx_uint16_max(r.y1, y1);
+      _dirty_last = best;
+    }
+    bool _isNear(const DirtyRect& r, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+    {
+      return (x0 <= r.x1 + GxEPD2_DIRTY_MERGE_GAP) && (x1 + GxEPD2_DIRTY_MERGE_GAP >= r.x0) &&
+             (y0 <= r.y1 + GxEPD2_DIRTY_MERGE_GAP) && (y1 + GxEPD2_DIRTY_MERGE_GAP >= r.y0);
+    }
+    // changed rows closer than GxEPD2_DIRTY_MERGE_GAP form one span, its columns the union of the changed words
+    void _diffShadow()
+    {
+      unsigned long start = micros();
+      const uint16_t wb = GxEPD2_Type::WIDTH / 8;
+      const uint16_t words = wb / GxEPD2_SHADOW_WORD;
+      int16_t span_y0 = -1, span_y1 = 0;
+      uint16_t span_c0 = wb, span_c1 = 0; // byte columns, c1 exclusive
+      for (uint16_t y = 0; y < HEIGHT; y++)
+      {
+        const uint8_t* a = _buffer + uint32_t(y) * wb;
+        const uint8_t* b = _shadow + uint32_t(y) * wb;
+        int16_t c0 = -1, c1 = 0;
+        for (uint16_t k = 0; k < words; k++)
+        {
+          uint32_t wa, wbuf;
+          memcpy(&wa, a + k * GxEPD2_SHADOW_WORD, GxEPD2_SHADOW_WORD);
+          memcpy(&wbuf, b + k * GxEPD2_SHADOW_WORD, GxEPD2_SHADOW_WORD);
+          if (wa == wbuf) continue;
+          if (c0 < 0) c0 = k * GxEPD2_SHADOW_WORD;
+          c1 = (k + 1) * GxEPD2_SHADOW_WORD;
+        }
+        for (uint16_t c = words * GxEPD2_SHADOW_WORD; c < wb; c++) // tail bytes
+        {
+          if (a[c] == b[c]) continue;
+          if (c0 < 0) c0 = c;
+          c1 = c + 1;
+        }
+        if (c0 < 0) continue;
+        if ((span_y0 >= 0) && (y > span_y1 + GxEPD2_DIRTY_MERGE_GAP))
+        {
+          _markDirty(span_c0 * 8, span_y0, (span_c1 - span_c0) * 8, span_y1 - span_y0);
+          span_y0 = -1;
+        }
+        if (span_y0 < 0)
+        {
+          span_y0 = y;
+          span_c0 = wb;
+          span_c1 = 0;
+        }
+        span_y1 = y + 1;
+        span_c0 = gx_uint16_min(span_c0, c0);
+        span_c1 = gx_uint16_max(span_c1, c1);
+      }
+      if (span_y0 >= 0) _markDirty(span_c0 * 8, span_y0, (span_c1 - span_c0) * 8, span_y1 - span_y0);
+      _diff_us = micros() - start;
+    }
+    // rectangles grown into each other's neighbourhood are merged
+    void _coalesceDirty()
+    {
+      bool merged = true;
+      while (merged)
+      {
+        merged = false;
+        for (uint8_t i = 0; i < _dirty_count; i++)
+        {
+          for (uint8_t j = i + 1; j < _dirty_count; j++)
+          {
+            DirtyRect& a = _dirty[i];
+            const DirtyRect& b = _dirty[j];
+            if (!_isNear(a, b.x0, b.y0, b.x1, b.y1)) continue;
+            a.x0 = gx_uint16_min(a.x0, b.x0);
+            a.y0 = gx_uint16_min(a.y0, b.y0);
+            a.x1 = gx_uint16_max(a.x1, b.x1);
+            a.y1 = gx_uint16_max(a.y1, b.y1);
+            _dirty[j] = _dirty[--_dirty_count];
+            merged = true;
+          }
+        }
+      }
+      _dirty_last = 0;
+    }
   private:
     uint8_t _buffer[(GxEPD2_Type::WIDTH / 8) * page_height];
+    DirtyRect _dirty[GxEPD2_DIRTY_RECTS];
+    uint8_t _dirty_count, _dirty_last;
+    bool _track_dirty;
+    uint8_t* _shadow;
+    bool _shadow_valid;
+    uint32_t _diff_us;
     bool _using_partial_mode, _second_phase, _mirror, _reverse;
     uint16_t _width_bytes, _pixel_bytes;
     int16_t _current_page;
@@ -20,8 +20,8 @@
 GxEPD2_EPD::GxEPD2_EPD(int16_t cs, int16_t dc, int16_t rst, int16_t busy, int16_t busy_level, uint32_t busy_timeout,
                        uint16_t w, uint16_t h, GxEPD2::Panel p, bool c, bool pu, bool fpu) :
   WIDTH(w), HEIGHT(h), panel(p), hasColor(c), hasPartialUpdate(pu), hasFastPartialUpdate(fpu),
-  _cs(cs), _dc(dc), _rst(rst), _busy(busy), _busy_level(busy_level), _busy_timeout(busy_timeout), _diag_enabled(false),
-  _pSPIx(&SPI), _spi_settings(4000000, MSBFIRST, SPI_MODE0)
+  _cs(cs), _dc(dc), _rst(rst), _busy(busy), _busy_level(busy_level), _sck(-1), _sda(-1), _busy_timeout(busy_timeout), _diag_enabled(false),
+  _pSPIx(&SPI), _spi_settings(4000000, MSBFIRST, SPI_MODE0), _spi_clock(4000000)
 {
   _initial_write = true;
   _initial_refresh = true;
@@ -32,6 +32,19 @@ GxEPD2_EPD::GxEPD2_EPD(int16_t cs, int16_t dc, int16_t rst, int16_t busy, int16_
   _reset_duration = 10;
   _busy_callback = 0;
   _busy_callback_parameter = 0;
+  _transfer_start = 0;
+  _transfer_bytes = 0;
+  _last_transfer_bytes = 0;
+  _last_transfer_us = 0;
+  _sent_bytes = 0;
+  _transfer_time = 0;
+  _refreshing = false;
+  _async_refresh = false;
+  _refresh_pending = false;
+  _refresh_comment = 0;
+  _refresh_start = 0;
+  _refresh_callback = 0;
+  _refresh_callback_parameter = 0;
 }
 
 void GxEPD2_EPD::init(uint32_t serial_diag_bitrate)
@@ -100,14 +113,101 @@ void GxEPD2_EPD::setBusyCallback(void (*busyCallback)(const void*), const void*
   _busy_callback_parameter = busy_callback_parameter;
 }
 
+void GxEPD2_EPD::setAsyncRefresh(bool async)
+{
+  _waitRefreshDone();
+  _async_refresh = async && (_busy >= 0);
+}
+
+void GxEPD2_EPD::setRefreshCallback(void (*refreshCallback)(const void*), const void* refresh_callback_parameter)
+{
+  _refresh_callback = refreshCallback;
+  _refresh_callback_parameter = refresh_callback_parameter;
+}
+
+GxEPD2_EPD* GxEPD2_EPD::_refreshing_instance = 0;
+
+void GxEPD2_EPD::_busyISR()
+{
+  if (_refreshing_instance) _refreshing_instance->_refreshing = false;
+}
+
+bool GxEPD2_EPD::isBusy()
+{
+  if (!_refresh_pending) return false;
+  if (_refreshing && (digitalRead(_busy) == _busy_level)) // pin check covers an edge lost before attach
+  {
+    if (micros() - _refresh_start <= _busy_timeout) return true;
+#if !defined(DISABLE_DIAGNOSTIC_OUTPUT)
+    Serial.println("Busy Timeout!");
+#endif
+  }
+  unsigned long elapsed = micros() - _refresh_start;
+#if defined(PARTICLE)
+  detachInterrupt(_busy);
+#else
+  detachInterrupt(digitalPinToInterrupt(_busy));
+#endif
+  _refreshing_instance = 0;
+  _refreshing = false;
+  _refresh_pending = false;
+#if !defined(DISABLE_DIAGNOSTIC_OUTPUT)
+  if (_refresh_comment && _diag_enabled)
+  {
+    Serial.print(_refresh_comment);
+    Serial.print(" : ");
+    Serial.println(elapsed);
+  }
+#endif
+  (void) elapsed;
+  if (_refresh_callback) _refresh_callback(_refresh_callback_parameter);
+  return false;
+}
+
 void GxEPD2_EPD::selectSPI(SPIClass& spi, SPISettings spi_settings)
 {
   _pSPIx = &spi;
   _spi_settings = spi_settings;
 }
 
+void GxEPD2_EPD::setSPIClock(uint32_t clock)
+{
+  _spi_clock = clock;
+  _spi_settings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+}
+
+void GxEPD2_EPD::setReadPins(int16_t sck, int16_t sda)
+{
+  _sck = sck;
+  _sda = sda;
+}
+
+uint32_t GxEPD2_EPD::tuneSPIClock(const uint32_t clocks[], uint8_t count, uint8_t attempts)
+{
+  uint32_t previous = _spi_clock;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    setSPIClock(clocks[i]);
+    bool ok = true;
+    for (uint8_t a = 0; ok && (a < attempts); a++)
+    {
+      ok = _probeSPI();
+    }
+    if (ok) return clocks[i];
+  }
+  setSPIClock(previous);
+  return 0;
+}
+
+uint32_t GxEPD2_EPD::getTransferRate()
+{
+  if (_last_transfer_us == 0) return 0;
+  return uint32_t(uint64_t(_last_transfer_bytes) * 1000000 / _last_transfer_us);
+}
+
 void GxEPD2_EPD::_reset()
 {
+  _waitRefreshDone();
   if (_rst >= 0)
   {
     if (_pulldown_rst_mode)
@@ -174,8 +274,38 @@ void GxEPD2_EPD::_waitWhileBusy(const char* comment, uint16_t busy_time)
   else delay(busy_time);
 }
 
+void GxEPD2_EPD::_waitWhileRefreshing(const char* comment, uint16_t busy_time)
+{
+  if (!_async_refresh) return _waitWhileBusy(comment, busy_time);
+  _waitRefreshDone(); // one at a time
+  delay(1); // add some margin to become active
+  _refresh_comment = comment;
+  _refresh_start = micros();
+  _refreshing = true;
+  _refresh_pending = true;
+  _refreshing_instance = this;
+#if defined(PARTICLE)
+  attachInterrupt(_busy, _busyISR, _busy_level == HIGH ? FALLING : RISING);
+#else
+  attachInterrupt(digitalPinToInterrupt(_busy), _busyISR, _busy_level == HIGH ? FALLING : RISING);
+#endif
+}
+
+void GxEPD2_EPD::_waitRefreshDone()
+{
+  while (isBusy())
+  {
+    if (_busy_callback) _busy_callback(_busy_callback_parameter);
+    else delay(1);
+#if defined(ESP8266) || defined(ESP32)
+    yield(); // avoid wdt
+#endif
+  }
+}
+
 void GxEPD2_EPD::_writeCommand(uint8_t c)
 {
+  _waitRefreshDone();
   _pSPIx->beginTransaction(_spi_settings);
   if (_dc >= 0) digitalWrite(_dc, LOW);
   if (_cs >= 0) digitalWrite(_cs, LOW);
@@ -183,19 +313,23 @@ void GxEPD2_EPD::_writeCommand(uint8_t c)
   if (_cs >= 0) digitalWrite(_cs, HIGH);
   if (_dc >= 0) digitalWrite(_dc, HIGH);
   _pSPIx->endTransaction();
+  _sent_bytes++;
 }
 
 void GxEPD2_EPD::_writeData(uint8_t d)
 {
+  _waitRefreshDone();
   _pSPIx->beginTransaction(_spi_settings);
   if (_cs >= 0) digitalWrite(_cs, LOW);
   _pSPIx->transfer(d);
   if (_cs >= 0) digitalWrite(_cs, HIGH);
   _pSPIx->endTransaction();
+  _sent_bytes++;
 }
 
 void GxEPD2_EPD::_writeData(const uint8_t* data, uint16_t n)
 {
+  _waitRefreshDone();
   _pSPIx->beginTransaction(_spi_settings);
   if (_cs >= 0) digitalWrite(_cs, LOW);
   for (uint16_t i = 0; i < n; i++)
@@ -204,12 +338,47 @@ void GxEPD2_EPD::_writeData(const uint8_t* data, uint16_t n)
   }
   if (_cs >= 0) digitalWrite(_cs, HIGH);
   _pSPIx->endTransaction();
+  _sent_bytes += n;
+}
+
+bool GxEPD2_EPD::_readCommandData(uint8_t c, uint8_t* data, uint16_t n)
+{
+  if ((_sck < 0) || (_sda < 0)) return false;
+  _waitRefreshDone();
+  _pSPIx->beginTransaction(_spi_settings);
+  if (_dc >= 0) digitalWrite(_dc, LOW);
+  if (_cs >= 0) digitalWrite(_cs, LOW);
+  _pSPIx->transfer(c);
+  if (_dc >= 0) digitalWrite(_dc, HIGH);
+  _pSPIx->endTransaction();
+  _sent_bytes++;
+  // the SPI peripheral owns SCK and MOSI: release them and read SDA slowly, MSB first, sampled with SCK high
+  _pSPIx->end();
+  pinMode(_sda, INPUT);
+  digitalWrite(_sck, LOW);
+  pinMode(_sck, OUTPUT);
+  for (uint16_t i = 0; i < n; i++)
+  {
+    uint8_t value = 0;
+    for (uint8_t b = 0; b < 8; b++)
+    {
+      digitalWrite(_sck, HIGH);
+      value = (value << 1) | (digitalRead(_sda) ? 1 : 0);
+      digitalWrite(_sck, LOW);
+    }
+    data[i] = value;
+  }
+  if (_cs >= 0) digitalWrite(_cs, HIGH);
+  _pSPIx->begin();
+  return true;
 }
 
 void GxEPD2_EPD::_writeDataPGM(const uint8_t* data, uint16_t n, int16_t fill_with_zeroes)
 {
+  _waitRefreshDone();
   _pSPIx->beginTransaction(_spi_settings);
   if (_cs >= 0) digitalWrite(_cs, LOW);
+  _sent_bytes += n + (fill_with_zeroes > 0 ? fill_with_zeroes : 0);
   for (uint16_t i = 0; i < n; i++)
   {
     _pSPIx->transfer(pgm_read_byte(&*data++));
@@ -225,7 +394,9 @@ void GxEPD2_EPD::_writeDataPGM(const uint8_t* data, uint16_t n, int16_t fill_wit
 
 void GxEPD2_EPD::_writeDataPGM_sCS(const uint8_t* data, uint16_t n, int16_t fill_with_zeroes)
 {
+  _waitRefreshDone();
   _pSPIx->beginTransaction(_spi_settings);
+  _sent_bytes += n + (fill_with_zeroes > 0 ? fill_with_zeroes : 0);
   for (uint8_t i = 0; i < n; i++)
   {
     if (_cs >= 0) digitalWrite(_cs, LOW);
@@ -244,6 +415,7 @@ void GxEPD2_EPD::_writeDataPGM_sCS(const uint8_t* data, uint16_t n, int16_t fill
 
 void GxEPD2_EPD::_writeCommandData(const uint8_t* pCommandData, uint8_t datalen)
 {
+  _waitRefreshDone();
   _pSPIx->beginTransaction(_spi_settings);
   if (_dc >= 0) digitalWrite(_dc, LOW);
   if (_cs >= 0) digitalWrite(_cs, LOW);
@@ -255,10 +427,12 @@ void GxEPD2_EPD::_writeCommandData(const uint8_t* pCommandData, uint8_t datalen)
   }
   if (_cs >= 0) digitalWrite(_cs, HIGH);
   _pSPIx->endTransaction();
+  _sent_bytes += datalen;
 }
 
 void GxEPD2_EPD::_writeCommandDataPGM(const uint8_t* pCommandData, uint8_t datalen)
 {
+  _waitRefreshDone();
   _pSPIx->beginTransaction(_spi_settings);
   if (_dc >= 0) digitalWrite(_dc, LOW);
   if (_cs >= 0) digitalWrite(_cs, LOW);
@@ -270,21 +444,121 @@ void GxEPD2_EPD::_writeCommandDataPGM(const uint8_t* pCommandData, uint8_t datal
   }
   if (_cs >= 0) digitalWrite(_cs, HIGH);
   _pSPIx->endTransaction();
+  _sent_bytes += datalen;
 }
 
 void GxEPD2_EPD::_startTransfer()
 {
+  _waitRefreshDone();
   _pSPIx->beginTransaction(_spi_settings);
   if (_cs >= 0) digitalWrite(_cs, LOW);
+  _transfer_start = micros();
+  _transfer_bytes = 0;
 }
 
 void GxEPD2_EPD::_transfer(uint8_t value)
 {
+  _waitBulk(); // keep byte order after a bulk transfer
   _pSPIx->transfer(value);
+  _transfer_bytes++;
 }
 
 void GxEPD2_EPD::_endTransfer()
 {
+  _waitBulk();
   if (_cs >= 0) digitalWrite(_cs, HIGH);
   _pSPIx->endTransaction();
+  _sent_bytes += _transfer_bytes;
+  if (_transfer_bytes >= GxEPD2_BULK_BUFFER_SIZE) // short transfers are dominated by call overhead
+  {
+    _last_transfer_bytes = _transfer_bytes;
+    _last_transfer_us = micros() - _transfer_start;
+    _transfer_time += _last_transfer_us;
+  }
+}
+
+uint8_t GxEPD2_EPD::_bulk_buffer[2][GxEPD2_BULK_BUFFER_SIZE];
+uint8_t GxEPD2_EPD::_bulk_index = 0;
+
+#if defined(GxEPD2_SPI_DMA)
+volatile bool GxEPD2_EPD::_bulk_busy = false;
+
+void GxEPD2_EPD::_bulkDone()
+{
+  _bulk_busy = false;
+}
+#endif
+
+void GxEPD2_EPD::_transferRows(const uint8_t* data, int32_t stride, uint16_t row_bytes, uint16_t rows, bool invert, bool pgm)
+{
+  uint8_t* buf = _bulk_buffer[_bulk_index];
+  uint16_t k = 0;
+  for (uint16_t i = 0; i < rows; i++)
+  {
+    const uint8_t* src = data;
+    uint16_t remaining = row_bytes;
+    while (remaining > 0)
+    {
+      // copy as much of the row as fits, the previous buffer is on the wire meanwhile
+      uint16_t n = GxEPD2_BULK_BUFFER_SIZE - k < remaining ? GxEPD2_BULK_BUFFER_SIZE - k : remaining;
+#if defined(__AVR) || defined(ESP8266) || defined(ESP32)
+      if (pgm) memcpy_P(buf + k, src, n);
+      else memcpy(buf + k, src, n);
+#else
+      memcpy(buf + k, src, n);
+#endif
+      if (invert)
+      {
+        for (uint16_t j = k; j < k + n; j++) buf[j] = ~buf[j];
+      }
+      src += n;
+      k += n;
+      remaining -= n;
+      if (k == GxEPD2_BULK_BUFFER_SIZE)
+      {
+        _transferBulk(k);
+        buf = _bulk_buffer[_bulk_index];
+        k = 0;
+      }
+    }
+    data += stride;
+  }
+  if (k > 0) _transferBulk(k);
+}
+
+void GxEPD2_EPD::_transferFill(uint8_t value, uint32_t n)
+{
+  // both buffers hold the fill value, so neither needs refilling while on the wire
+  _waitBulk();
+  memset(_bulk_buffer, value, sizeof(_bulk_buffer));
+  while (n > 0)
+  {
+    uint16_t chunk = n < GxEPD2_BULK_BUFFER_SIZE ? n : GxEPD2_BULK_BUFFER_SIZE;
+    _transferBulk(chunk);
+    n -= chunk;
+  }
+}
+
+void GxEPD2_EPD::_transferBulk(uint16_t n)
+{
+#if defined(GxEPD2_SPI_DMA)
+  _waitBulk();
+  _bulk_busy = true;
+  _pSPIx->transfer(_bulk_buffer[_bulk_index], NULL, n, _bulkDone);
+#else
+  const uint8_t* p = _bulk_buffer[_bulk_index];
+  for (uint16_t i = 0; i < n; i++)
+  {
+    _pSPIx->transfer(p[i]);
+  }
+#endif
+  _bulk_index ^= 1;
+  _transfer_bytes += n;
+}
+
+void GxEPD2_EPD::_waitBulk()
+{
+#if defined(GxEPD2_SPI_DMA)
+  while (_bulk_busy);
+#endif
 }
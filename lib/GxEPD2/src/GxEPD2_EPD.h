@@ -18,6 +18,15 @@
 #include <GxEPD2.h>
 
 #pragma GCC diagnostic ignored "-Wunused-parameter"
+
+// bulk transfers (_transferRows, _transferFill) are staged through two buffers of this size each,
+// one is prepared while the other is clocked out; on Particle the SPI DMA does the clocking out
+#ifndef GxEPD2_BULK_BUFFER_SIZE
+#define GxEPD2_BULK_BUFFER_SIZE 256
+#endif
+#if defined(PARTICLE) && !defined(GxEPD2_DISABLE_SPI_DMA)
+#define GxEPD2_SPI_DMA
+#endif
 //#pragma GCC diagnostic ignored "-Wsign-compare"
 
 class GxEPD2_EPD
@@ -89,6 +98,12 @@ class GxEPD2_EPD
     virtual void setPaged() {}; // for GxEPD2_154c paged workaround
     // register a callback function to be called during _waitWhileBusy continuously.
     void setBusyCallback(void (*busyCallback)(const void*), const void* busy_callback_parameter = 0);
+    // asynchronous refresh: refresh() returns as soon as the controller is busy, the BUSY edge interrupt marks completion;
+    // any further controller access waits for completion, calling the busy callback meanwhile
+    void setAsyncRefresh(bool async);
+    // true while an asynchronous refresh is in progress; the refresh callback is called once it has completed
+    bool isBusy();
+    void setRefreshCallback(void (*refreshCallback)(const void*), const void* refresh_callback_parameter = 0);
     static inline uint16_t gx_uint16_min(uint16_t a, uint16_t b)
     {
       return (a < b ? a : b);
@@ -98,9 +113,31 @@ class GxEPD2_EPD
       return (a > b ? a : b);
     };
     void selectSPI(SPIClass& spi, SPISettings spi_settings);
+    // SCK frequency for MSBFIRST, SPI_MODE0 transfers
+    void setSPIClock(uint32_t clock);
+    uint32_t getSPIClock() {return _spi_clock;};
+    // SCK and the controller's bidirectional SDA (wired to MOSI) as GPIO, for reading back from the controller
+    void setReadPins(int16_t sck, int16_t sda);
+    // tries clocks[] in the given (descending) order and keeps the first the controller acknowledges on
+    // every attempt; returns that clock, or 0 and restores the previous clock if none passes
+    uint32_t tuneSPIClock(const uint32_t clocks[], uint8_t count, uint8_t attempts = 3);
+    // bytes per second achieved by the last bulk data transfer
+    uint32_t getTransferRate();
+    // microseconds spent in bulk data transfers since resetTransferTime()
+    uint32_t getTransferTime() {return _transfer_time;};
+    void resetTransferTime() {_transfer_time = 0;};
+    // bytes sent to the controller (commands and data, short transfers included) since resetTransferBytes()
+    uint32_t getTransferBytes() {return _sent_bytes;};
+    void resetTransferBytes() {_sent_bytes = 0;};
   protected:
+    // checks one command round trip at the current clock, default: cannot check, assume ok
+    virtual bool _probeSPI() {return true;};
+    // sends command c at the SPI clock, then clocks n bytes in from SDA by bit-banging; false without read pins
+    bool _readCommandData(uint8_t c, uint8_t* data, uint16_t n);
     void _reset();
     void _waitWhileBusy(const char* comment = 0, uint16_t busy_time = 5000);
+    void _waitWhileRefreshing(const char* comment = 0, uint16_t busy_time = 5000); // _waitWhileBusy, or return if async
+    void _waitRefreshDone();
     void _writeCommand(uint8_t c);
     void _writeData(uint8_t d);
     void _writeData(const uint8_t* data, uint16_t n);
@@ -111,12 +148,35 @@ class GxEPD2_EPD
     void _startTransfer();
     void _transfer(uint8_t value);
     void _endTransfer();
+    // bulk data inside _startTransfer() / _endTransfer(); stride is the bitmap row pitch, negative for mirror_y
+    void _transferRows(const uint8_t* data, int32_t stride, uint16_t row_bytes, uint16_t rows, bool invert = false, bool pgm = false);
+    void _transferFill(uint8_t value, uint32_t n);
+  private:
+    void _transferBulk(uint16_t n);
+    void _waitBulk();
+#if defined(GxEPD2_SPI_DMA)
+    static void _bulkDone();
+    static volatile bool _bulk_busy;
+#endif
+    static uint8_t _bulk_buffer[2][GxEPD2_BULK_BUFFER_SIZE];
+    static uint8_t _bulk_index;
+    static void _busyISR();
+    static GxEPD2_EPD* _refreshing_instance;
+    volatile bool _refreshing;
+    bool _async_refresh, _refresh_pending;
+    const char* _refresh_comment;
+    unsigned long _refresh_start;
+    void (*_refresh_callback)(const void*);
+    const void* _refresh_callback_parameter;
   protected:
     int16_t _cs, _dc, _rst, _busy, _busy_level;
+    int16_t _sck, _sda;
     uint32_t _busy_timeout;
     bool _diag_enabled, _pulldown_rst_mode;
     SPIClass* _pSPIx;
     SPISettings _spi_settings;
+    uint32_t _spi_clock;
+    uint32_t _transfer_start, _transfer_bytes, _last_transfer_bytes, _last_transfer_us, _transfer_time, _sent_bytes;
     bool _initial_write, _initial_refresh;
     bool _power_is_on, _using_partial_mode, _hibernating;
     bool _init_display_done;
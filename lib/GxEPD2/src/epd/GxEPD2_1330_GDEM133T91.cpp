@@ -45,10 +45,7 @@ void GxEPD2_1330_GDEM133T91::_writeScreenBuffer(uint8_t command, uint8_t value)
   _setPartialRamArea(0, 0, WIDTH, HEIGHT);
   _writeCommand(command);
   _startTransfer();
-  for (uint32_t i = 0; i < uint32_t(WIDTH) * uint32_t(HEIGHT) / 8; i++)
-  {
-    _transfer(value);
-  }
+  _transferFill(value, uint32_t(WIDTH) * uint32_t(HEIGHT) / 8);
   _endTransfer();
 }
 
@@ -90,29 +87,9 @@ void GxEPD2_1330_GDEM133T91::_writeImage(uint8_t command, const uint8_t bitmap[]
   _setPartialRamArea(x1, y1, w1, h1);
   _writeCommand(command);
   _startTransfer();
-  for (int16_t i = 0; i < h1; i++)
-  {
-    for (int16_t j = 0; j < w1 / 8; j++)
-    {
-      uint8_t data;
-      // use wb, h of bitmap for index!
-      uint32_t idx = mirror_y ? j + dx / 8 + uint32_t((h - 1 - (i + dy))) * wb : j + dx / 8 + uint32_t(i + dy) * wb;
-      if (pgm)
-      {
-#if defined(__AVR) || defined(ESP8266) || defined(ESP32)
-        data = pgm_read_byte(&bitmap[idx]);
-#else
-        data = bitmap[idx];
-#endif
-      }
-      else
-      {
-        data = bitmap[idx];
-      }
-      if (invert) data = ~data;
-      _transfer(data);
-    }
-  }
+  // use wb, h of bitmap for index!
+  uint32_t first_row = mirror_y ? uint32_t(h - 1 - dy) : uint32_t(dy);
+  _transferRows(bitmap + dx / 8 + first_row * wb, mirror_y ? -wb : wb, w1 / 8, h1, invert, pgm);
   _endTransfer();
   delay(1); // yield() to avoid WDT on ESP8266 and ESP32
 }
@@ -157,29 +134,9 @@ void GxEPD2_1330_GDEM133T91::_writeImagePart(uint8_t command, const uint8_t bitm
   _setPartialRamArea(x1, y1, w1, h1);
   _writeCommand(command);
   _startTransfer();
-  for (int16_t i = 0; i < h1; i++)
-  {
-    for (int16_t j = 0; j < w1 / 8; j++)
-    {
-      uint8_t data;
-      // use wb_bitmap, h_bitmap of bitmap for index!
-      uint32_t idx = mirror_y ? x_part / 8 + j + dx / 8 + uint32_t((h_bitmap - 1 - (y_part + i + dy))) * wb_bitmap : x_part / 8 + j + dx / 8 + uint32_t(y_part + i + dy) * wb_bitmap;
-      if (pgm)
-      {
-#if defined(__AVR) || defined(ESP8266) || defined(ESP32)
-        data = pgm_read_byte(&bitmap[idx]);
-#else
-        data = bitmap[idx];
-#endif
-      }
-      else
-      {
-        data = bitmap[idx];
-      }
-      if (invert) data = ~data;
-      _transfer(data);
-    }
-  }
+  // use wb_bitmap, h_bitmap of bitmap for index!
+  uint32_t first_row = mirror_y ? uint32_t(h_bitmap - 1 - (y_part + dy)) : uint32_t(y_part + dy);
+  _transferRows(bitmap + x_part / 8 + dx / 8 + first_row * wb_bitmap, mirror_y ? -wb_bitmap : wb_bitmap, w1 / 8, h1, invert, pgm);
   _endTransfer();
   delay(1); // yield() to avoid WDT on ESP8266 and ESP32
 }
@@ -295,6 +252,31 @@ void GxEPD2_1330_GDEM133T91::hibernate()
   }
 }
 
+bool GxEPD2_1330_GDEM133T91::_probeSPI()
+{
+  // writes a pattern into the start of the b/w RAM at the current clock and reads it back bit-banged;
+  // runs after init(), before the initial write clears both RAMs
+  static const uint8_t pattern[] = {0xA5, 0x5A, 0x3C, 0xC3, 0x0F, 0xF0, 0x96, 0x69};
+  uint8_t readback[sizeof(pattern) + 1]; // first byte read is dummy
+  if (_hibernating) _reset();
+  _writeCommand(0x12);  //SWRESET
+  _waitWhileBusy(0, 15);
+  // SWRESET reverted the controller configuration
+  _init_display_done = false;
+  _power_is_on = false;
+  _setPartialRamArea(0, 0, 8 * sizeof(pattern), 1);
+  _writeCommand(0x24);
+  _writeData(pattern, sizeof(pattern));
+  _setPartialRamArea(0, 0, 8 * sizeof(pattern), 1);
+  _writeCommand(0x41); // read RAM option
+  _writeData(0x00);    // b/w RAM
+  if (!_readCommandData(0x27, readback, sizeof(readback))) return false; // no read pins, nothing is proven
+  if (memcmp(readback + 1, pattern, sizeof(pattern)) == 0) return true;
+  // a garbled byte may have been taken for any command, deep sleep included
+  _reset();
+  return false;
+}
+
 void GxEPD2_1330_GDEM133T91::_setPartialRamArea(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
   _writeCommand(0x11); // set ram entry mode
@@ -372,7 +354,7 @@ void GxEPD2_1330_GDEM133T91::_Update_Full()
   _writeCommand(0x22);
   _writeData(0xf7);
   _writeCommand(0x20);
-  _waitWhileBusy("_Update_Full", full_refresh_time);
+  _waitWhileRefreshing("_Update_Full", full_refresh_time);
   _power_is_on = false;
 }
 
@@ -381,6 +363,6 @@ void GxEPD2_1330_GDEM133T91::_Update_Part()
   _writeCommand(0x22);
   _writeData(hasFastPartialUpdate ? 0xfc : 0xf4);
   _writeCommand(0x20);
-  _waitWhileBusy("_Update_Part", hasFastPartialUpdate ? partial_refresh_time : full_refresh_time);
+  _waitWhileRefreshing("_Update_Part", hasFastPartialUpdate ? partial_refresh_time : full_refresh_time);
   _power_is_on = true;
 }
@@ -1,4 +1,5 @@
 #include "Battery.h"
+#include "I2CBus.h"
 
 // MAX17049 Register addresses
 #define REG_VCELL    0x02  // Battery voltage (12-bit, upper)
@@ -15,6 +16,15 @@
 
 // CONFIG register bits
 #define CONFIG_SLEEP_BIT  0x0080  // Sleep mode enable
+#define CONFIG_ALSC_BIT   0x0040  // Alert on 1% SOC change
+#define CONFIG_ALRT_BIT   0x0020  // Alert asserted, write 0 to release ALRT
+
+// STATUS register alert flags (RI, VH, VL, VR, HD, SC)
+#define STATUS_ALERT_MASK 0x3F00
+
+// Registers covered by a snapshot burst read
+#define SNAPSHOT_FIRST_REG  REG_VCELL
+#define SNAPSHOT_REG_COUNT  ((REG_CRATE - REG_VCELL) / 2 + 1)
 
 // Default RCOMP value (0x97 from datasheet)
 #define DEFAULT_RCOMP  0x97
@@ -28,22 +38,29 @@ bool Battery::begin() {
     pinMode(BATT_ALERT_PIN, INPUT);
 
     // Check if device responds
-    Wire.beginTransmission(MAX17049_ADDR);
-    if (Wire.endTransmission() != 0) {
+    if (!I2CBus::instance().probe(MAX17049_ADDR)) {
         Serial.println("MAX17049 not found!");
         _initialized = false;
         return false;
     }
 
+    // Fuel gauge reads can wait for the PN532
+    _dev = I2CBus::instance().addDevice(MAX17049_ADDR, "MAX17049", I2CBus::Priority::Low);
     _initialized = true;
 
     // Read version to confirm communication
-    uint16_t version = readReg(REG_VERSION);
+    uint16_t version = 0;
+    readReg(REG_VERSION, version);
     Serial.printlnf("MAX17049 detected, version: 0x%04X", version);
 
     // Set default RCOMP value
     // The upper byte of CONFIG is RCOMP, lower byte has other settings
-    uint16_t config = readReg(REG_CONFIG);
+    uint16_t config = 0;
+    if (!readReg(REG_CONFIG, config)) {
+        Serial.println("MAX17049 CONFIG read failed");
+        _initialized = false;
+        return false;
+    }
     uint8_t currentRcomp = config >> 8;
     Serial.printlnf("Current RCOMP: 0x%02X", currentRcomp);
 
@@ -52,51 +69,109 @@ bool Battery::begin() {
         Serial.println("RCOMP at default value");
     }
 
+    // Resample on alerts only: enable the 1% SOC change alert and clear
+    // anything left asserted from before the reset
+    uint16_t status;
+    if (readReg(REG_STATUS, status)) {
+        writeReg(REG_STATUS, status & ~STATUS_ALERT_MASK);
+    }
+    writeReg(REG_CONFIG, (config | CONFIG_ALSC_BIT) & ~CONFIG_ALRT_BIT);
+    attachInterrupt(BATT_ALERT_PIN, &Battery::onAlert, this, FALLING);
+
     // Print initial readings
     printRegisters();
 
     return true;
 }
 
-float Battery::getSoC() {
-    if (!_initialized) return -1;
-
-    // SOC register: upper byte = integer %, lower byte = 1/256th %
-    uint16_t soc = readReg(REG_SOC);
-    float percent = (float)(soc >> 8) + ((float)(soc & 0xFF) / 256.0f);
-
-    // Clamp to valid range
-    if (percent < 0.0f) percent = 0.0f;
-    if (percent > 100.0f) percent = 100.0f;
+const Battery::Snapshot& Battery::snapshot(uint32_t maxAgeMs) {
+    if (!_initialized) return _snapshot;
 
-    return percent;
+    if (_alertPending || digitalRead(BATT_ALERT_PIN) == LOW) {
+        handleAlert();
+    } else if (_snapshot.timestamp == 0 || millis() - _snapshot.timestamp >= maxAgeMs) {
+        refresh();
+    }
+    return _snapshot;
 }
 
-float Battery::getVoltage() {
-    if (!_initialized) return -1;
+bool Battery::refresh() {
+    if (!_initialized) return false;
+
+    uint16_t regs[SNAPSHOT_REG_COUNT];
+    if (!readRegs(SNAPSHOT_FIRST_REG, regs, SNAPSHOT_REG_COUNT)) return false;
 
-    uint16_t raw = readReg(REG_VCELL);
+    Snapshot& s = _snapshot;
+    s.vcell = regs[(REG_VCELL - SNAPSHOT_FIRST_REG) / 2];
+    s.soc = regs[(REG_SOC - SNAPSHOT_FIRST_REG) / 2];
+    s.mode = regs[(REG_MODE - SNAPSHOT_FIRST_REG) / 2];
+    s.version = regs[(REG_VERSION - SNAPSHOT_FIRST_REG) / 2];
+    s.hibrt = regs[(REG_HIBRT - SNAPSHOT_FIRST_REG) / 2];
+    s.config = regs[(REG_CONFIG - SNAPSHOT_FIRST_REG) / 2];
+    s.valrt = regs[(REG_VALRT - SNAPSHOT_FIRST_REG) / 2];
+    s.crate = regs[(REG_CRATE - SNAPSHOT_FIRST_REG) / 2];
 
     // MAX17049 (2-cell): Full scale is 10.24V
     // Formula: voltage = raw * 10.24 / 65536
     // This equals: raw * 0.00015625 (which is 156.25uV per LSB)
-    float voltage = (float)raw * 10.24f / 65536.0f;
+    s.voltage = (float)s.vcell * 10.24f / 65536.0f;
 
-    return voltage;
+    // SOC register: upper byte = integer %, lower byte = 1/256th %
+    float percent = (float)(s.soc >> 8) + ((float)(s.soc & 0xFF) / 256.0f);
+    if (percent > 100.0f) percent = 100.0f;
+    s.percent = percent;
+
+    // CRATE register: signed 16-bit, 0.208%/hr per LSB
+    s.changeRate = (float)(int16_t)s.crate * 0.208f;
+
+    s.timestamp = millis();
+    if (s.timestamp == 0) s.timestamp = 1;
+    return true;
+}
+
+void Battery::handleAlert() {
+    // Release ALRT first so a change during the read raises a new edge.
+    // If the bus is busy the alert stays pending for the next access.
+    uint16_t status, config;
+    if (!readReg(REG_STATUS, status) || !readReg(REG_CONFIG, config)) return;
+    _alertPending = false;
+    if (status & STATUS_ALERT_MASK) {
+        writeReg(REG_STATUS, status & ~STATUS_ALERT_MASK);
+    }
+    if (config & CONFIG_ALRT_BIT) {
+        writeReg(REG_CONFIG, config & ~CONFIG_ALRT_BIT);
+    }
+    refresh();
+}
+
+void Battery::onAlert() {
+    _alertPending = true;
+}
+
+uint16_t Battery::getStatus() {
+    uint16_t status = 0;
+    if (_initialized) readReg(REG_STATUS, status);
+    return status;
+}
+
+float Battery::getSoC() {
+    if (!_initialized) return -1;
+    return snapshot().percent;
+}
+
+float Battery::getVoltage() {
+    if (!_initialized) return -1;
+    return snapshot().voltage;
 }
 
 uint16_t Battery::getRawVoltage() {
     if (!_initialized) return 0;
-    return readReg(REG_VCELL);
+    return snapshot().vcell;
 }
 
 float Battery::getChangeRate() {
     if (!_initialized) return 0;
-
-    // CRATE register: charge/discharge rate in %/hr
-    // Signed 16-bit, 0.208%/hr per LSB
-    int16_t crate = (int16_t)readReg(REG_CRATE);
-    return (float)crate * 0.208f;
+    return snapshot().changeRate;
 }
 
 void Battery::quickStart() {
@@ -108,38 +183,41 @@ void Battery::quickStart() {
     writeReg(REG_MODE, 0x4000);
     Serial.println("MAX17049 Quick Start issued");
     delay(200);  // Wait for recalculation
+    refresh();
 }
 
 void Battery::setRCOMP(uint8_t rcomp) {
     if (!_initialized) return;
 
     // RCOMP is the upper byte of CONFIG register
-    uint16_t config = readReg(REG_CONFIG);
+    uint16_t config;
+    if (!readReg(REG_CONFIG, config)) return;
     config = (config & 0x00FF) | ((uint16_t)rcomp << 8);
-    writeReg(REG_CONFIG, config);
+    if (writeReg(REG_CONFIG, config)) _snapshot.config = config;
 }
 
 uint8_t Battery::getRCOMP() {
     if (!_initialized) return 0;
 
-    uint16_t config = readReg(REG_CONFIG);
-    return (uint8_t)(config >> 8);
+    return (uint8_t)(snapshot().config >> 8);
 }
 
 void Battery::sleep() {
     if (!_initialized) return;
 
-    uint16_t config = readReg(REG_CONFIG);
+    uint16_t config;
+    if (!readReg(REG_CONFIG, config)) return;
     config |= CONFIG_SLEEP_BIT;
-    writeReg(REG_CONFIG, config);
+    if (writeReg(REG_CONFIG, config)) _snapshot.config = config;
 }
 
 void Battery::wake() {
     if (!_initialized) return;
 
-    uint16_t config = readReg(REG_CONFIG);
+    uint16_t config;
+    if (!readReg(REG_CONFIG, config)) return;
     config &= ~CONFIG_SLEEP_BIT;
-    writeReg(REG_CONFIG, config);
+    if (writeReg(REG_CONFIG, config)) _snapshot.config = config;
 }
 
 void Battery::printRegisters() {
@@ -148,36 +226,43 @@ void Battery::printRegisters() {
         return;
     }
 
+    refresh();
+    const Snapshot& s = _snapshot;
     Serial.println("--- MAX17049 Registers ---");
-    Serial.printlnf("VCELL:   0x%04X (%.3fV)", readReg(REG_VCELL), getVoltage());
-    Serial.printlnf("SOC:     0x%04X (%.2f%%)", readReg(REG_SOC), getSoC());
-    Serial.printlnf("MODE:    0x%04X", readReg(REG_MODE));
-    Serial.printlnf("VERSION: 0x%04X", readReg(REG_VERSION));
-    Serial.printlnf("HIBRT:   0x%04X", readReg(REG_HIBRT));
-    Serial.printlnf("CONFIG:  0x%04X (RCOMP=0x%02X)", readReg(REG_CONFIG), getRCOMP());
-    Serial.printlnf("CRATE:   0x%04X (%.1f%%/hr)", readReg(REG_CRATE), getChangeRate());
-    Serial.printlnf("STATUS:  0x%04X", readReg(REG_STATUS));
+    Serial.printlnf("VCELL:   0x%04X (%.3fV)", s.vcell, s.voltage);
+    Serial.printlnf("SOC:     0x%04X (%.2f%%)", s.soc, s.percent);
+    Serial.printlnf("MODE:    0x%04X", s.mode);
+    Serial.printlnf("VERSION: 0x%04X", s.version);
+    Serial.printlnf("HIBRT:   0x%04X", s.hibrt);
+    Serial.printlnf("CONFIG:  0x%04X (RCOMP=0x%02X)", s.config, s.config >> 8);
+    Serial.printlnf("VALRT:   0x%04X", s.valrt);
+    Serial.printlnf("CRATE:   0x%04X (%.1f%%/hr)", s.crate, s.changeRate);
+    Serial.printlnf("STATUS:  0x%04X", getStatus());
     Serial.println("--------------------------");
 }
 
-uint16_t Battery::readReg(uint8_t reg) {
-    Wire.beginTransmission(MAX17049_ADDR);
-    Wire.write(reg);
-    Wire.endTransmission(false);
+bool Battery::readReg(uint8_t reg, uint16_t& value) {
+    return readRegs(reg, &value, 1);
+}
 
-    Wire.requestFrom(MAX17049_ADDR, 2);
-    if (Wire.available() >= 2) {
-        uint8_t msb = Wire.read();
-        uint8_t lsb = Wire.read();
-        return (msb << 8) | lsb;
+bool Battery::readRegs(uint8_t reg, uint16_t* values, uint8_t count) {
+    // The register pointer auto-increments, so consecutive registers
+    // come back in one repeated-start read
+    uint8_t buf[2 * SNAPSHOT_REG_COUNT];
+    if (count > SNAPSHOT_REG_COUNT) return false;
+    if (I2CBus::instance().readRegs(_dev, reg, buf, 2 * count) != I2CBus::Result::OK) {
+        return false;
     }
-    return 0;
+    for (uint8_t i = 0; i < count; i++) {
+        values[i] = (buf[2 * i] << 8) | buf[2 * i + 1];
+    }
+    return true;
 }
 
-void Battery::writeReg(uint8_t reg, uint16_t value) {
-    Wire.beginTransmission(MAX17049_ADDR);
-    Wire.write(reg);
-    Wire.write((value >> 8) & 0xFF);  // MSB
-    Wire.write(value & 0xFF);          // LSB
-    Wire.endTransmission();
+bool Battery::writeReg(uint8_t reg, uint16_t value) {
+    uint8_t buf[2] = {
+        (uint8_t)(value >> 8),     // MSB
+        (uint8_t)(value & 0xFF)    // LSB
+    };
+    return I2CBus::instance().writeRegs(_dev, reg, buf, 2) == I2CBus::Result::OK;
 }
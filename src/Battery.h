@@ -6,11 +6,37 @@
 #define MAX17049_ADDR   0x36
 #define BATT_ALERT_PIN  A1
 
+// Getters are served from the last snapshot until it is this old. With the
+// 1% SOC-change alert enabled, the ALRT pin forces an earlier resample.
+#define BATTERY_MAX_AGE_MS  60000
+
 class Battery {
 public:
+    // VCELL through CRATE, read in one I2C transaction
+    struct Snapshot {
+        uint32_t timestamp;   // millis() of the read, 0 if never read
+        uint16_t vcell;
+        uint16_t soc;
+        uint16_t mode;
+        uint16_t version;
+        uint16_t hibrt;
+        uint16_t config;
+        uint16_t valrt;
+        uint16_t crate;
+        float voltage;        // V
+        float percent;        // 0-100%
+        float changeRate;     // %/hr
+    };
+
     static Battery& instance();
 
     bool begin();
+
+    // Cached register snapshot, re-read if older than maxAgeMs or an alert fired
+    const Snapshot& snapshot(uint32_t maxAgeMs = BATTERY_MAX_AGE_MS);
+    bool refresh();           // Force a burst read
+    void setMaxAge(uint32_t ms) { _maxAgeMs = ms; }
+    uint16_t getStatus();     // STATUS alert flags (not cached)
     float getSoC();           // State of Charge from ModelGauge (0-100%)
     float getVoltage();       // Battery voltage (V)
     uint16_t getRawVoltage(); // Raw VCELL register
@@ -28,8 +54,16 @@ public:
 private:
     Battery() = default;
     bool _initialized = false;
-    uint16_t readReg(uint8_t reg);
-    void writeReg(uint8_t reg, uint16_t value);
+    bool readReg(uint8_t reg, uint16_t& value);
+    bool writeReg(uint8_t reg, uint16_t value);
+    bool readRegs(uint8_t reg, uint16_t* values, uint8_t count);
+    void handleAlert();
+    void onAlert();
+
+    int _dev = -1;            // I2CBus device id
+    Snapshot _snapshot = {};
+    uint32_t _maxAgeMs = BATTERY_MAX_AGE_MS;
+    volatile bool _alertPending = false;
 };
 
 #endif
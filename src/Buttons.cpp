@@ -2,6 +2,10 @@
 
 Buttons *Buttons::_instance = nullptr;
 
+const pin_t Buttons::PINS[BUTTON_COUNT] = {
+    BUTTON_1_PIN, BUTTON_2_PIN, BUTTON_3_PIN, BUTTON_4_PIN
+};
+
 Buttons &Buttons::instance() {
     if (!_instance) {
         _instance = new Buttons();
@@ -10,40 +14,198 @@ Buttons &Buttons::instance() {
 }
 
 Buttons::Buttons() {
-    for (int i = 0; i < 4; i++) {
-        lastState[i] = HIGH;  // Pull-up means default HIGH
-        lastDebounce[i] = 0;
+    for (int i = 0; i < BUTTON_COUNT; i++) {
+        _state[i] = ButtonState();  // Pull-up means default released
     }
 }
 
 void Buttons::begin() {
-    pinMode(BUTTON_1_PIN, INPUT);
-    pinMode(BUTTON_2_PIN, INPUT);
-    pinMode(BUTTON_3_PIN, INPUT);
-    pinMode(BUTTON_4_PIN, INPUT);
+    for (int i = 0; i < BUTTON_COUNT; i++) {
+        pinMode(PINS[i], INPUT);
+        _state[i].pressed = digitalRead(PINS[i]) == LOW;
+    }
+
+    attachInterrupt(BUTTON_1_PIN, &Buttons::onEdge<0>, this, CHANGE);
+    attachInterrupt(BUTTON_2_PIN, &Buttons::onEdge<1>, this, CHANGE);
+    attachInterrupt(BUTTON_3_PIN, &Buttons::onEdge<2>, this, CHANGE);
+    attachInterrupt(BUTTON_4_PIN, &Buttons::onEdge<3>, this, CHANGE);
 
     Serial.println("Buttons initialized");
 }
 
+template <uint8_t N>
+void Buttons::onEdge() {
+    pushEdge(N);
+}
+
+void Buttons::pushEdge(uint8_t index) {
+    // ISR context: timestamp the edge and hand it to update()
+    uint8_t head = _head.load(std::memory_order_relaxed);
+    uint8_t next = (head + 1) & (BUTTON_RING_SIZE - 1);
+    if (next == _tail.load(std::memory_order_acquire)) {
+        _overflow.store(true, std::memory_order_relaxed);
+        return;
+    }
+    _ring[head].ms = millis();
+    _ring[head].button = index;
+    _ring[head].level = pinReadFast(PINS[index]);
+    _head.store(next, std::memory_order_release);
+}
+
 void Buttons::update() {
-    checkButton(1, BUTTON_1_PIN);
-    checkButton(2, BUTTON_2_PIN);
-    checkButton(3, BUTTON_3_PIN);
-    checkButton(4, BUTTON_4_PIN);
+    // Drain the edges captured since the last call
+    uint8_t tail = _tail.load(std::memory_order_relaxed);
+    while (tail != _head.load(std::memory_order_acquire)) {
+        Edge edge = _ring[tail];
+        tail = (tail + 1) & (BUTTON_RING_SIZE - 1);
+        _tail.store(tail, std::memory_order_release);
+
+        ButtonState& st = _state[edge.button];
+        if (edge.ms - st.lastEdge < BUTTON_DEBOUNCE_MS) {
+            // Bounce: settle on whatever level the pin ends up at
+            st.resync = true;
+            continue;
+        }
+        applyLevel(edge.button, edge.level == LOW, edge.ms);
+    }
+
+    uint32_t now = millis();
+    bool overflow = _overflow.exchange(false);
+    if (overflow) _dropped++;
+    bool resyncAll = overflow || _resyncAll;
+    _resyncAll = false;
+
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        ButtonState& st = _state[i];
+
+        if ((st.resync && now - st.lastEdge >= BUTTON_DEBOUNCE_MS) || resyncAll) {
+            st.resync = false;
+            applyLevel(i, digitalRead(PINS[i]) == LOW, now);
+        }
+
+        if (st.pressed && !st.longFired && !st.inChord &&
+            now - st.pressedAt >= BUTTON_LONG_PRESS_MS) {
+            st.longFired = true;
+            st.tapPending = false;
+            emit(Gesture::Long, 1 << i, st.pressedAt);
+        }
+
+        if (st.tapPending && now - st.releasedAt >= BUTTON_DOUBLE_TAP_MS) {
+            st.tapPending = false;
+            emit(Gesture::Short, 1 << i, st.pressedAt);
+        }
+    }
+}
+
+void Buttons::applyLevel(uint8_t index, bool pressed, uint32_t ms) {
+    ButtonState& st = _state[index];
+    if (pressed == st.pressed) return;
+    st.pressed = pressed;
+    st.lastEdge = ms;
+    if (pressed) {
+        onPress(index, ms);
+    } else {
+        onRelease(index, ms);
+    }
+}
+
+void Buttons::onPress(uint8_t index, uint32_t ms) {
+    ButtonState& st = _state[index];
+    bool secondTap = st.tapPending && ms - st.releasedAt < BUTTON_DOUBLE_TAP_MS;
+    uint32_t firstPress = st.pressedAt;
+    st.tapPending = false;
+    st.longFired = false;
+    st.inChord = false;
+    st.pressedAt = ms;
+
+    if (secondTap) {
+        // Consume this press so its release is not another tap
+        st.inChord = true;
+        emit(Gesture::Double, 1 << index, firstPress);
+        return;
+    }
+
+    // Other buttons pressed just before this one and still held form a chord
+    uint8_t mask = 1 << index;
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        const ButtonState& other = _state[i];
+        if (i != index && other.pressed && !other.longFired &&
+            ms - other.pressedAt < BUTTON_CHORD_WINDOW_MS) {
+            mask |= 1 << i;
+        }
+    }
+    if (mask != (1 << index)) {
+        uint32_t first = ms;
+        for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+            if (!(mask & (1 << i))) continue;
+            _state[i].inChord = true;
+            _state[i].tapPending = false;
+            if ((int32_t)(_state[i].pressedAt - first) < 0) first = _state[i].pressedAt;
+        }
+        emit(Gesture::Chord, mask, first);
+    }
 }
 
-void Buttons::checkButton(int buttonNum, pin_t pin) {
-    int index = buttonNum - 1;
-    bool currentState = digitalRead(pin);
+void Buttons::onRelease(uint8_t index, uint32_t ms) {
+    ButtonState& st = _state[index];
+    st.releasedAt = ms;
+    // Long presses and chords already fired on press
+    if (!st.longFired && !st.inChord) {
+        st.tapPending = true;
+    }
+}
+
+void Buttons::emit(Gesture gesture, uint8_t mask, uint32_t pressedAt) {
+    Event event;
+    event.gesture = gesture;
+    event.mask = mask;
+    event.pressedAt = pressedAt;
+    event.button = 1;
+    while (!(mask & 1) && event.button < BUTTON_COUNT) {
+        mask >>= 1;
+        event.button++;
+    }
 
-    if (currentState != lastState[index]) {
-        if (millis() - lastDebounce[index] > DEBOUNCE_MS) {
-            lastDebounce[index] = millis();
-            lastState[index] = currentState;
+    for (int i = 0; i < BUTTON_MAX_SUBSCRIBERS; i++) {
+        if (_handlers[i]) _handlers[i](event);
+    }
+}
 
-            if (currentState == LOW) {
-                Serial.printlnf("Button %d pressed", buttonNum);
-            }
+bool Buttons::subscribe(Handler handler) {
+    for (int i = 0; i < BUTTON_MAX_SUBSCRIBERS; i++) {
+        if (_handlers[i] == handler) return true;
+    }
+    for (int i = 0; i < BUTTON_MAX_SUBSCRIBERS; i++) {
+        if (!_handlers[i]) {
+            _handlers[i] = handler;
+            return true;
         }
     }
+    return false;
+}
+
+void Buttons::unsubscribe(Handler handler) {
+    for (int i = 0; i < BUTTON_MAX_SUBSCRIBERS; i++) {
+        if (_handlers[i] == handler) _handlers[i] = nullptr;
+    }
+}
+
+bool Buttons::isPressed(uint8_t button) const {
+    if (button < 1 || button > BUTTON_COUNT) return false;
+    return _state[button - 1].pressed;
+}
+
+bool Buttons::isIdle() const {
+    if (_resyncAll || _head.load(std::memory_order_acquire) != _tail.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    for (int i = 0; i < BUTTON_COUNT; i++) {
+        const ButtonState& st = _state[i];
+        if (st.pressed || st.resync || st.tapPending) return false;
+    }
+    return true;
+}
+
+void Buttons::resync() {
+    _resyncAll = true;
 }
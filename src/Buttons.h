@@ -2,6 +2,7 @@
 #define __BUTTONS_H
 
 #include "Particle.h"
+#include <atomic>
 
 // Button pin definitions (active LOW with pull-up resistors)
 #define BUTTON_1_PIN  A5
@@ -9,23 +10,88 @@
 #define BUTTON_3_PIN  A7
 #define BUTTON_4_PIN  A6
 
+#define BUTTON_COUNT            4
+#define BUTTON_RING_SIZE        32    // Edges buffered between update() calls, power of 2
+#define BUTTON_MAX_SUBSCRIBERS  4
+
+// Gesture timing
+#define BUTTON_DEBOUNCE_MS      50
+#define BUTTON_LONG_PRESS_MS    800
+#define BUTTON_DOUBLE_TAP_MS    300   // Max gap between the two taps
+#define BUTTON_CHORD_WINDOW_MS  150   // Max gap between presses of a chord
+
 class Buttons {
 public:
+    enum class Gesture : uint8_t {
+        Short,
+        Long,      // Fires while still held
+        Double,
+        Chord      // Several buttons pressed together, see Event::mask
+    };
+
+    struct Event {
+        Gesture gesture;
+        uint8_t button;     // 1-4, lowest button of a chord
+        uint8_t mask;       // bit n-1 set for button n
+        uint32_t pressedAt; // millis() of the press edge
+    };
+
+    typedef void (*Handler)(const Event& event);
+
     static Buttons &instance();
 
     void begin();
-    void update();  // Call this in loop()
+    void update();  // Call from a task, runs the gesture state machines
+
+    bool subscribe(Handler handler);
+    void unsubscribe(Handler handler);
+
+    bool isPressed(uint8_t button) const;  // Debounced state, 1-4
+    bool isIdle() const;   // Nothing held, buffered or waiting on a timeout
+    void resync();         // Re-read every pin, e.g. after the MCU slept
+    uint32_t getDroppedEdges() const { return _dropped; }
 
 private:
+    struct Edge {
+        uint32_t ms;
+        uint8_t button;
+        uint8_t level;
+    };
+
+    struct ButtonState {
+        bool pressed;          // Debounced, true = LOW
+        bool resync;           // Edges ignored in lockout, re-read the pin
+        bool longFired;
+        bool inChord;
+        bool tapPending;       // Released short, waiting for a second tap
+        uint32_t lastEdge;     // Last accepted edge, ms
+        uint32_t pressedAt;
+        uint32_t releasedAt;
+    };
+
     Buttons();
 
     static Buttons *_instance;
+    static const pin_t PINS[BUTTON_COUNT];
+
+    template <uint8_t N>
+    void onEdge();
+    void pushEdge(uint8_t index);
+    void applyLevel(uint8_t index, bool pressed, uint32_t ms);
+    void onPress(uint8_t index, uint32_t ms);
+    void onRelease(uint8_t index, uint32_t ms);
+    void emit(Gesture gesture, uint8_t mask, uint32_t pressedAt);
 
-    bool lastState[4];  // Previous button states
-    unsigned long lastDebounce[4];  // Debounce timers
-    static const unsigned long DEBOUNCE_MS = 50;
+    ButtonState _state[BUTTON_COUNT];
+    Handler _handlers[BUTTON_MAX_SUBSCRIBERS] = {};
 
-    void checkButton(int buttonNum, pin_t pin);
+    // Single producer (ISR), single consumer (update)
+    Edge _ring[BUTTON_RING_SIZE];
+    std::atomic<uint8_t> _head{0};
+    std::atomic<uint8_t> _tail{0};
+    std::atomic<bool> _overflow{false};
+    uint32_t _dropped = 0;
+    bool _resyncAll = false;
 };
 
 #endif /* __BUTTONS_H */
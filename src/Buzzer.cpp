@@ -1,5 +1,18 @@
 #include "Buzzer.h"
 
+static constexpr Buzzer::Note SUCCESS_TONE[] = {
+    {2200, 70}, {2700, 70}, {3000, 70}
+};
+
+static constexpr Buzzer::Note FAILURE_TONE[] = {
+    {2900, 120}, {1900, 200}
+};
+
+// Descending tone pattern to indicate going to sleep
+static constexpr Buzzer::Note SLEEP_TONE[] = {
+    {2500, 100}, {2000, 100}, {1500, 100}, {1000, 200}
+};
+
 void Buzzer::init() {
     pinMode(BUZZER_PIN, OUTPUT);
     digitalWrite(BUZZER_PIN, LOW);
@@ -24,32 +37,93 @@ void Buzzer::stopBuzzer() {
     digitalWrite(BUZZER_PIN, LOW);
 }
 
-void Buzzer::playNote(int frequency, int duration) {
+bool Buzzer::play(const Note* notes, uint8_t count, Priority priority) {
+    if (!initialized || count == 0) return false;
+
+    uint16_t wait = 0;
+    bool queued = true;
+    SINGLE_THREADED_BLOCK() {
+        if (!_playing || priority > _current.priority) {
+            // Idle, or preempting: the interrupted melody is dropped
+            _current = {notes, count, priority};
+            _noteIndex = 0;
+            _inGap = false;
+            _playing = true;
+            wait = step();
+        } else if (_queueCount < BUZZER_QUEUE_SIZE) {
+            // Keep the queue ordered by priority, FIFO within a priority
+            uint8_t pos = _queueCount;
+            while (pos > 0 && _queue[pos - 1].priority < priority) {
+                _queue[pos] = _queue[pos - 1];
+                pos--;
+            }
+            _queue[pos] = {notes, count, priority};
+            _queueCount++;
+        } else {
+            queued = false;
+        }
+    }
+    if (wait) _timer.changePeriod(wait);
+    return queued;
+}
+
+void Buzzer::stop() {
     if (!initialized) return;
-    startBuzzer(frequency);
-    delay(duration);
+    _timer.stop();
+    SINGLE_THREADED_BLOCK() {
+        _queueCount = 0;
+        _playing = false;
+        stopBuzzer();
+    }
+}
+
+bool Buzzer::isPlaying() const {
+    return _playing;
+}
+
+uint16_t Buzzer::step() {
+    // Each note is followed by a short gap so repeated notes stay distinct
+    if (!_inGap && _noteIndex < _current.count) {
+        const Note& note = _current.notes[_noteIndex++];
+        startBuzzer(note.frequency);
+        _inGap = true;
+        return note.durationMs ? note.durationMs : 1;
+    }
     stopBuzzer();
-    delay(20);
+    if (_inGap) {
+        _inGap = false;
+        return BUZZER_NOTE_GAP_MS;
+    }
+
+    // Melody finished, start the next queued one
+    if (_queueCount == 0) {
+        _playing = false;
+        return 0;
+    }
+    _current = _queue[0];
+    _queueCount--;
+    memmove(_queue, _queue + 1, _queueCount * sizeof(Melody));
+    _noteIndex = 0;
+    return step();
+}
+
+void Buzzer::onTimer() {
+    uint16_t wait = 0;
+    SINGLE_THREADED_BLOCK() {
+        if (_playing) wait = step();
+    }
+    // Never block the timer thread
+    if (wait) _timer.changePeriod(wait, 0);
 }
 
 void Buzzer::playSuccessTone() {
-    if (!initialized) return;
-    playNote(2200, 70);
-    playNote(2700, 70);
-    playNote(3000, 70);
+    play(SUCCESS_TONE, Priority::Normal);
 }
 
 void Buzzer::playFailureTone() {
-    if (!initialized) return;
-    playNote(2900, 120);
-    playNote(1900, 200);
+    play(FAILURE_TONE, Priority::Normal);
 }
 
 void Buzzer::playSleepTone() {
-    if (!initialized) return;
-    // Descending tone pattern to indicate going to sleep
-    playNote(2500, 100);
-    playNote(2000, 100);
-    playNote(1500, 100);
-    playNote(1000, 200);
+    play(SLEEP_TONE, Priority::High);
 }
@@ -5,8 +5,25 @@
 
 #define BUZZER_PIN  A0
 
+#define BUZZER_QUEUE_SIZE   4
+#define BUZZER_NOTE_GAP_MS  20   // Silence after each note
+
 class Buzzer {
 public:
+    // One step of a melody; frequency 0 is a rest
+    struct Note {
+        uint16_t frequency;
+        uint16_t durationMs;
+    };
+
+    // A higher priority melody cuts off the one playing, equal or lower
+    // priority ones wait in the queue
+    enum class Priority : uint8_t {
+        Low,
+        Normal,
+        High
+    };
+
     static Buzzer& instance() {
         static Buzzer _instance;
         return _instance;
@@ -15,18 +32,46 @@ public:
     void init();
     void startBuzzer(int frequency);
     void stopBuzzer();
-    void playNote(int frequency, int duration);
+
+    // Non-blocking: the melody is sequenced from a software timer.
+    // 'notes' must stay valid until played (use static constexpr tables).
+    // Returns false if the queue is full.
+    bool play(const Note* notes, uint8_t count, Priority priority = Priority::Normal);
+    template <size_t N>
+    bool play(const Note (&notes)[N], Priority priority = Priority::Normal) {
+        return play(notes, N, priority);
+    }
+    void stop();            // Silence and drop everything queued
+    bool isPlaying() const;
+
     void playSuccessTone();
     void playFailureTone();
     void playSleepTone();
 
 private:
+    struct Melody {
+        const Note* notes;
+        uint8_t count;
+        Priority priority;
+    };
+
     Buzzer() = default;
     ~Buzzer() = default;
     Buzzer(const Buzzer&) = delete;
     Buzzer& operator=(const Buzzer&) = delete;
 
+    uint16_t step();        // Next note or gap, returns ms to wait (0 = idle)
+    void onTimer();
+
     bool initialized = false;
+
+    Timer _timer{BUZZER_NOTE_GAP_MS, &Buzzer::onTimer, *this, true};
+    Melody _current = {};
+    uint8_t _noteIndex = 0;
+    bool _inGap = false;
+    volatile bool _playing = false;
+    Melody _queue[BUZZER_QUEUE_SIZE] = {};
+    uint8_t _queueCount = 0;
 };
 
 #endif
@@ -1,4 +1,5 @@
 #include "Charger.h"
+#include "I2CBus.h"
 
 Charger& Charger::instance() {
     static Charger _instance;
@@ -6,68 +7,164 @@ Charger& Charger::instance() {
 }
 
 bool Charger::begin() {
-    Wire.beginTransmission(MP2672A_ADDR);
-    if (Wire.endTransmission() != 0) {
+    pinMode(CHARGER_ACOK_PIN, INPUT);
+    attachInterrupt(CHARGER_ACOK_PIN, &Charger::onAcok, this, CHANGE);
+    _status.powerPresent = isPowerPresent();
+
+    if (!I2CBus::instance().probe(MP2672A_ADDR)) {
         Serial.println("MP2672A not found at 0x4B");
         _initialized = false;
         return false;
     }
 
     Serial.println("MP2672A found");
+    _dev = I2CBus::instance().addDevice(MP2672A_ADDR, "MP2672A", I2CBus::Priority::Normal);
     _initialized = true;
+    refresh();
+    updateStatus();
     readAllRegisters();
     return true;
 }
 
+void Charger::onAcok() {
+    _acokChanged = true;
+}
+
+void Charger::update() {
+    // ACOK edges are handled at once; CHG_STAT changes (pre -> fast -> done)
+    // and faults are caught by polling, only while external power is present
+    // A level that differs from the last status also counts: the edge that
+    // woke the MCU from sleep never reaches the ISR
+    bool edge = _acokChanged || isPowerPresent() != _status.powerPresent;
+    _acokChanged = false;
+    if (edge) {
+        refresh();
+    } else if (_status.powerPresent || _status.faults) {
+        registers(CHARGER_POLL_MS);
+    }
+    updateStatus();
+}
+
+void Charger::updateStatus() {
+    Status status;
+    status.powerPresent = isPowerPresent();
+    status.phase = _initialized ? (Phase)_regs.status.chgStat : Phase::NotCharging;
+    status.faults = _initialized ? _regs.fault.raw & 0xF8 : 0;
+    if (!status.powerPresent) status.phase = Phase::NotCharging;
+
+    if (status.powerPresent == _status.powerPresent && status.phase == _status.phase &&
+        status.faults == _status.faults) {
+        return;
+    }
+    _status = status;
+    for (int i = 0; i < CHARGER_MAX_SUBSCRIBERS; i++) {
+        if (_handlers[i]) _handlers[i](_status);
+    }
+}
+
+const Charger::Registers& Charger::registers(uint32_t maxAgeMs) {
+    if (_initialized && (_regsTime == 0 || millis() - _regsTime >= maxAgeMs)) {
+        refresh();
+    }
+    return _regs;
+}
+
+bool Charger::refresh() {
+    if (!_initialized) return false;
+
+    // REG00-REG04 in one transaction, the register pointer auto-increments
+    uint8_t buf[CHARGER_REG_COUNT];
+    if (I2CBus::instance().readRegs(_dev, REG00_VBATT, buf, sizeof(buf)) != I2CBus::Result::OK) {
+        return false;
+    }
+
+    _regs.reg00.raw = buf[0];
+    _regs.reg01 = buf[1];
+    _regs.reg02 = buf[2];
+    _regs.status.raw = buf[3];
+    _regs.fault.raw = buf[4];
+    _regsTime = millis();
+    if (_regsTime == 0) _regsTime = 1;
+    return true;
+}
+
+bool Charger::isPowerPresent() const {
+    return digitalRead(CHARGER_ACOK_PIN) == LOW;
+}
+
+bool Charger::isCharging() const {
+    return _status.phase == Phase::PreCharge || _status.phase == Phase::FastCharge;
+}
+
+bool Charger::subscribe(Handler handler) {
+    for (int i = 0; i < CHARGER_MAX_SUBSCRIBERS; i++) {
+        if (_handlers[i] == handler) return true;
+    }
+    for (int i = 0; i < CHARGER_MAX_SUBSCRIBERS; i++) {
+        if (!_handlers[i]) {
+            _handlers[i] = handler;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Charger::unsubscribe(Handler handler) {
+    for (int i = 0; i < CHARGER_MAX_SUBSCRIBERS; i++) {
+        if (_handlers[i] == handler) _handlers[i] = nullptr;
+    }
+}
+
+const char* Charger::phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::PreCharge:  return "pre-charge";
+        case Phase::FastCharge: return "fast charge";
+        case Phase::Done:       return "done";
+        default:                return "not charging";
+    }
+}
+
 void Charger::readAllRegisters() {
     if (!_initialized) return;
+    refresh();
+    const Registers& r = _regs;
 
     Serial.println("--- MP2672A Registers ---");
 
     // REG00: Battery voltage, charge config
-    uint8_t reg00 = readReg(REG00_VBATT);
-    Serial.printlnf("REG00 (VBATT/Config): 0x%02X = %s", reg00, String(reg00, BIN).c_str());
-    uint8_t vbatt = (reg00 >> 5) & 0x07;
-    const char* vbattStr[] = {"8.3V", "8.4V", "8.5V", "8.6V", "8.7V", "8.8V", "8.9V", "8.2V"};
-    Serial.printlnf("  VBATT_REG: %s", vbattStr[vbatt]);
+    static const char* const vbattStr[] = {"8.3V", "8.4V", "8.5V", "8.6V", "8.7V", "8.8V", "8.9V", "8.2V"};
+    Serial.printlnf("REG00 (VBATT/Config): 0x%02X", r.reg00.raw);
+    Serial.printlnf("  VBATT_REG: %s", vbattStr[r.reg00.vbattReg]);
 
     // REG01: Cell balance, charge current
-    uint8_t reg01 = readReg(REG01_BALANCE);
-    Serial.printlnf("REG01 (Balance/Current): 0x%02X = %s", reg01, String(reg01, BIN).c_str());
+    Serial.printlnf("REG01 (Balance/Current): 0x%02X", r.reg01);
 
     // REG02: Timer settings
-    uint8_t reg02 = readReg(REG02_TIMER);
-    Serial.printlnf("REG02 (Timer): 0x%02X = %s", reg02, String(reg02, BIN).c_str());
+    Serial.printlnf("REG02 (Timer): 0x%02X", r.reg02);
 
     // REG03: Status (read-only)
-    uint8_t reg03 = readReg(REG03_STATUS);
-    Serial.printlnf("REG03 (Status): 0x%02X = %s", reg03, String(reg03, BIN).c_str());
-    Serial.printlnf("  CHG_STAT[1:0]: %d (0=Not charging, 1=Pre-charge, 2=Fast charge, 3=Done)", (reg03 >> 4) & 0x03);
-    Serial.printlnf("  CELL_BAL: %d", (reg03 >> 3) & 0x01);
-    Serial.printlnf("  VIN_STAT: %d", (reg03 >> 2) & 0x01);
-    Serial.printlnf("  THERM_STAT: %d", (reg03 >> 1) & 0x01);
-    Serial.printlnf("  VSYS_STAT: %d", reg03 & 0x01);
+    Serial.printlnf("REG03 (Status): 0x%02X", r.status.raw);
+    Serial.printlnf("  CHG_STAT[1:0]: %d (%s)", r.status.chgStat, phaseName((Phase)r.status.chgStat));
+    Serial.printlnf("  CELL_BAL: %d", r.status.cellBal);
+    Serial.printlnf("  VIN_STAT: %d", r.status.vinStat);
+    Serial.printlnf("  THERM_STAT: %d", r.status.thermStat);
+    Serial.printlnf("  VSYS_STAT: %d", r.status.vsysStat);
 
     // REG04: Fault (read-only)
-    uint8_t reg04 = readReg(REG04_FAULT);
-    Serial.printlnf("REG04 (Fault): 0x%02X = %s", reg04, String(reg04, BIN).c_str());
-    Serial.printlnf("  WD_FAULT: %d", (reg04 >> 7) & 0x01);
-    Serial.printlnf("  VIN_OVP: %d", (reg04 >> 6) & 0x01);
-    Serial.printlnf("  THERM_SD: %d", (reg04 >> 5) & 0x01);
-    Serial.printlnf("  BAT_FAULT: %d", (reg04 >> 4) & 0x01);
-    Serial.printlnf("  CHG_TMR_FAULT: %d", (reg04 >> 3) & 0x01);
+    Serial.printlnf("REG04 (Fault): 0x%02X", r.fault.raw);
+    Serial.printlnf("  WD_FAULT: %d", r.fault.wdFault);
+    Serial.printlnf("  VIN_OVP: %d", r.fault.vinOvp);
+    Serial.printlnf("  THERM_SD: %d", r.fault.thermSd);
+    Serial.printlnf("  BAT_FAULT: %d", r.fault.batFault);
+    Serial.printlnf("  CHG_TMR_FAULT: %d", r.fault.chgTmrFault);
 
     Serial.println("-------------------------");
 }
 
 uint8_t Charger::readReg(uint8_t reg) {
-    Wire.beginTransmission(MP2672A_ADDR);
-    Wire.write(reg);
-    Wire.endTransmission(false);
-
-    Wire.requestFrom(MP2672A_ADDR, 1);
-    if (Wire.available()) {
-        return Wire.read();
+    uint8_t value;
+    if (I2CBus::instance().readRegs(_dev, reg, &value, 1) != I2CBus::Result::OK) {
+        return 0xFF;
     }
-    return 0xFF;
+    return value;
 }
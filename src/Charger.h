@@ -5,24 +5,115 @@
 
 #define MP2672A_ADDR    0x4B
 
+// Charger status pin (MP2672 ACOK)
+// ACOK is LOW when external power is present
+#define CHARGER_ACOK_PIN  D20
+
 // MP2672A Registers
 #define REG00_VBATT     0x00  // Battery voltage, charge config, SYS voltage
 #define REG01_BALANCE   0x01  // Cell balance, charge current
 #define REG02_TIMER     0x02  // Timer settings
 #define REG03_STATUS    0x03  // Status register (read-only)
 #define REG04_FAULT     0x04  // Fault register (read-only)
+#define CHARGER_REG_COUNT  5
+
+// CHG_STAT only moves on its own while powered: re-read this often then
+#define CHARGER_POLL_MS         5000
+#define CHARGER_MAX_SUBSCRIBERS 4
 
 class Charger {
 public:
+    // Register model, bit 0 first (GCC/ARM little-endian bitfield order)
+    union Reg00 {
+        uint8_t raw;
+        struct {
+            uint8_t config : 5;
+            uint8_t vbattReg : 3;     // 0=8.3V ... 6=8.9V, 7=8.2V
+        };
+    };
+
+    union Reg03 {
+        uint8_t raw;
+        struct {
+            uint8_t vsysStat : 1;
+            uint8_t thermStat : 1;
+            uint8_t vinStat : 1;
+            uint8_t cellBal : 1;
+            uint8_t chgStat : 2;      // Phase
+            uint8_t : 2;
+        };
+    };
+
+    union Reg04 {
+        uint8_t raw;
+        struct {
+            uint8_t : 3;
+            uint8_t chgTmrFault : 1;
+            uint8_t batFault : 1;
+            uint8_t thermSd : 1;
+            uint8_t vinOvp : 1;
+            uint8_t wdFault : 1;
+        };
+    };
+
+    struct Registers {
+        Reg00 reg00;
+        uint8_t reg01;            // Balance/current
+        uint8_t reg02;            // Timer
+        Reg03 status;
+        Reg04 fault;
+    };
+
+    enum class Phase : uint8_t {
+        NotCharging = 0,
+        PreCharge = 1,
+        FastCharge = 2,
+        Done = 3
+    };
+
+    struct Status {
+        bool powerPresent;        // ACOK
+        Phase phase;
+        uint8_t faults;           // REG04 fault bits, 0 if none
+    };
+
+    typedef void (*Handler)(const Status& status);
+
     static Charger& instance();
 
     bool begin();
-    void readAllRegisters();
+    void update();                // Call from a task: handles ACOK edges and polling
+
+    const Registers& registers(uint32_t maxAgeMs = CHARGER_POLL_MS);
+    bool refresh();
+
+    const Status& getStatus() const { return _status; }
+    bool isPowerPresent() const;  // ACOK, no I2C
+    Phase getPhase() const { return _status.phase; }
+    bool isCharging() const;      // Pre-charge or fast charge
+    uint8_t getFaults() const { return _status.faults; }
+    bool isPresent() const { return _initialized; }
+
+    bool subscribe(Handler handler);
+    void unsubscribe(Handler handler);
+
+    static const char* phaseName(Phase phase);
+
+    void readAllRegisters();      // Serial dump
     uint8_t readReg(uint8_t reg);
 
 private:
     Charger() = default;
+    void onAcok();
+    void updateStatus();
+
     bool _initialized = false;
+    int _dev = -1;                // I2CBus device id
+    Registers _regs = {};
+    uint32_t _regsTime = 0;
+    Status _status = {};
+    volatile bool _acokChanged = false;
+    Handler _handlers[CHARGER_MAX_SUBSCRIBERS] = {};
 };
 
 #endif
@@ -1,10 +1,22 @@
 #include "EPD_Display.h"
+#include "Perf.h"
 
 // Include a basic font
 #include <FreeSansBold24pt7b.h>
 
 static Logger logr("app.epd");
 
+#define EPD_SPI_MAGIC  0x45534331  // "ESC1"
+
+// Tuned clock survives resets; re-probed after power loss or a panel change
+struct EpdSpiTuning {
+    uint32_t magic;
+    uint32_t panel;
+    uint32_t clock;
+};
+
+retained static EpdSpiTuning _spiTuning;
+
 EPD_Display *EPD_Display::_instance = nullptr;
 
 EPD_Display &EPD_Display::instance() {
@@ -14,71 +26,324 @@ EPD_Display &EPD_Display::instance() {
     return *_instance;
 }
 
-EPD_Display::EPD_Display()
-    : display(GxEPD2_DRIVER_CLASS(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY)) {
+EPD_Display::EPD_Display() {
 }
 
 EPD_Display::~EPD_Display() {
+    delete _fullFrame;
+    delete _paged;
+    delete[] _shadow;
+    delete _list;
+}
+
+const char* EPD_Display::strategyName(Strategy strategy) {
+    switch (strategy) {
+        case Strategy::Auto: return "auto";
+        case Strategy::FullFrame: return "full frame";
+        case Strategy::Paged: return "paged";
+    }
+    return "?";
 }
 
-void EPD_Display::begin() {
+void EPD_Display::begin(Strategy strategy) {
     logr.info("Initializing EPD display...");
 
+    // The frame buffer lives inside the display object, so the strategy
+    // decides which one to allocate
+    if (!_display) {
+        uint32_t freeMem = System.freeMemory();
+        bool tryFull = strategy == Strategy::FullFrame ||
+            (strategy == Strategy::Auto && freeMem >= sizeof(EPD_FullFrame_t) + EPD_HEAP_RESERVE);
+        if (tryFull) {
+            _fullFrame = new (std::nothrow) EPD_FullFrame_t(GxEPD2_DRIVER_CLASS(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY));
+            _display = _fullFrame;
+        }
+        if (!_display) {
+            _paged = new (std::nothrow) EPD_Paged_t(GxEPD2_DRIVER_CLASS(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY));
+            _display = _paged;
+        }
+        if (!_display) {
+            logr.error("No heap for the EPD frame buffer");
+            return;
+        }
+        logr.info("EPD strategy %s: %s, %u page(s), %lu of %lu bytes free", strategyName(strategy),
+            _fullFrame ? "full frame" : "paged", _display->pages(),
+            (unsigned long)(_fullFrame ? sizeof(EPD_FullFrame_t) : sizeof(EPD_Paged_t)), (unsigned long)freeMem);
+    }
+    GxEPD2_GFX& display = *_display;
+
     SPI.begin();
 
+    // A clock retained from an older, faster table is tuned again
+    bool tuned = _spiTuning.magic == EPD_SPI_MAGIC && _spiTuning.panel == (uint32_t)display.epd2.panel &&
+        _spiTuning.clock <= EPD_SPI_CLOCK_MAX;
+    uint32_t clock = tuned ? _spiTuning.clock : EPD_SPI_CLOCK_DEFAULT;
+
     // Initialize display with 2ms reset pulse for Waveshare boards
+    display.epd2.setSPIClock(clock);
+    display.epd2.setReadPins(EPD_SCK, EPD_SDA);
     display.init(115200, true, 2, false);
+    if (!tuned) {
+        tuneSPI();
+    }
+
+    display.epd2.setBusyCallback(onBusy, this);
+    display.epd2.setRefreshCallback(onRefreshDone, this);
+    display.epd2.setAsyncRefresh(EPD_ASYNC_REFRESH);
+
+#if ENABLE_EPD_SHADOW && EPD_HAS_DIRTY_TRACKING
+    const size_t frameBytes = GxEPD2_DRIVER_CLASS::WIDTH / 8 * GxEPD2_DRIVER_CLASS::HEIGHT;
+    if (_fullFrame && !_shadow && System.freeMemory() >= frameBytes + EPD_HEAP_RESERVE) {
+        _shadow = new (std::nothrow) uint8_t[frameBytes];
+    }
+    if (_fullFrame && !_fullFrame->setShadowFrame(_shadow)) {
+        logr.warn("No heap for the EPD shadow frame");
+    }
+#endif
+#if EPD_HAS_DIRTY_TRACKING
+    // Without a shadow frame, pushChanges() sends what drawing touched
+    if (_fullFrame && !_shadow) {
+        _fullFrame->setDirtyTracking(true);
+    }
+#endif
 
-    logr.info("EPD initialized. Resolution: %dx%d", display.width(), display.height());
+#if ENABLE_EPD_DISPLAY_LIST
+    if (_paged && !_list && System.freeMemory() >= sizeof(EPD_DisplayList) + EPD_HEAP_RESERVE) {
+        _list = new (std::nothrow) EPD_DisplayList(GxEPD2_DRIVER_CLASS::WIDTH, GxEPD2_DRIVER_CLASS::HEIGHT);
+    }
+#endif
+
+    logr.info("EPD initialized. Resolution: %dx%d, SPI %lu Hz", display.width(), display.height(),
+        (unsigned long)getSPIClock());
+}
+
+uint32_t EPD_Display::tuneSPI() {
+    static const uint32_t clocks[] = EPD_SPI_CLOCKS;
+    const uint8_t count = sizeof(clocks) / sizeof(clocks[0]);
+
+    if (!_display) return 0;
+    GxEPD2_EPD& epd2 = _display->epd2;
+    uint32_t fastest = epd2.tuneSPIClock(clocks, count);
+    uint32_t clock = EPD_SPI_CLOCK_DEFAULT;
+    for (uint8_t i = 0; i < count; i++) {
+        if (clocks[i] == fastest) {
+            clock = i + 1 < count ? clocks[i + 1] : fastest;
+            break;
+        }
+    }
+    epd2.setSPIClock(clock);
+
+    _spiTuning.magic = EPD_SPI_MAGIC;
+    _spiTuning.panel = (uint32_t)epd2.panel;
+    _spiTuning.clock = clock;
+
+    logr.info("EPD SPI tuned: fastest read back %lu Hz, using %lu Hz (%lu bytes/s max)",
+        (unsigned long)fastest, (unsigned long)clock, (unsigned long)(clock / 8));
+    return clock;
 }
 
 void EPD_Display::showHelloWorld() {
+    if (!_display) return;
     logr.info("Displaying Hello World...");
+    Perf::Scope probe(Perf::PROBE_EPD);
+    GxEPD2_GFX& display = *_display;
+    _drawing = true;
+    uint32_t start = millis();
+    uint32_t renderUs = 0;
+    display.epd2.resetTransferTime();
 
     display.setRotation(0);
     display.setFullWindow();
 
+    // Paged: record once and replay per page if the list holds the whole
+    // screen, otherwise the drawing code runs once per page (twice more for
+    // the fast partial update's second phase)
+    if (_list) {
+        uint32_t recordStart = micros();
+        _list->clear();
+        _list->setRotation(display.getRotation());
+        drawHelloWorld(*_list);
+        renderUs = micros() - recordStart;
+        if (!_list->isOverflowed()) {
+            // One pass drawn straight into the page buffer, for comparison:
+            // recording does not rasterise, so it cannot stand in for this.
+            // The replay below starts from fillScreen() and overwrites it
+            uint32_t directStart = micros();
+            drawHelloWorld(display);
+            uint32_t passUs = micros() - directStart;
+            _list->render(display);
+            uint32_t recordUs = renderUs;
+            uint32_t directUs = passUs * _list->getPasses();
+            renderUs += _list->getReplayUs();
+            logr.info("EPD display list: %u items, record %lu us, replay %lu us over %u passes, %lu culled "
+                "(direct %lu us per pass, %lu us in all, saved %ld us)",
+                _list->getItemCount(), (unsigned long)recordUs, (unsigned long)_list->getReplayUs(),
+                _list->getPasses(), (unsigned long)_list->getCulled(), (unsigned long)passUs,
+                (unsigned long)directUs, (long)directUs - (long)renderUs);
+        } else {
+            logr.warn("EPD display list overflowed, drawing per page");
+        }
+    }
+    if (!_list || _list->isOverflowed()) {
+        uint32_t directUs = 0;
+        display.firstPage();
+        do {
+            uint32_t renderStart = micros();
+            drawHelloWorld(display);
+            directUs += micros() - renderStart;
+        } while (display.nextPage());
+        renderUs += directUs;
+    }
+#if EPD_HAS_DIRTY_TRACKING
+    // The panel holds this frame now: later pushes send only what changes
+    if (_fullFrame) _fullFrame->markClean();
+#endif
+
+    logr.info("Hello World displayed successfully (%lu ms, %s: render %lu us, upload %lu us, %lu bytes/s at %lu Hz)",
+        (unsigned long)(millis() - start), isFullFrame() ? "full frame" : "paged",
+        (unsigned long)renderUs, (unsigned long)display.epd2.getTransferTime(),
+        (unsigned long)getTransferRate(), (unsigned long)getSPIClock());
+    _drawing = false;
+}
+
+void EPD_Display::drawHelloWorld(Adafruit_GFX& display) {
+    display.fillScreen(GxEPD_WHITE);
+
+    display.setTextColor(GxEPD_BLACK);
+    display.setFont(&FreeSansBold24pt7b);
+
+    int16_t tbx, tby;
+    uint16_t tbw, tbh;
+
+    // --- TOP: "Hello World! (TOP)" ---
+    const char* topText = "Hello World! (TOP)";
+    display.getTextBounds(topText, 0, 0, &tbx, &tby, &tbw, &tbh);
+    int16_t topX = (display.width() - tbw) / 2 - tbx;
+    int16_t topY = 50 - tby;
+    display.setCursor(topX, topY);
+    display.print(topText);
+
+    // --- BOTTOM: "Hello World! (BOTTOM)" ---
+    const char* bottomText = "Hello World! (BOTTOM)";
+    display.getTextBounds(bottomText, 0, 0, &tbx, &tby, &tbw, &tbh);
+    int16_t bottomX = (display.width() - tbw) / 2 - tbx;
+    int16_t bottomY = display.height() - 50;
+    display.setCursor(bottomX, bottomY);
+    display.print(bottomText);
+
+    // --- CENTER: Display info ---
+    display.setFont();
+    display.setTextSize(2);
+    char info[64];
+    snprintf(info, sizeof(info), "%dx%d pixels", display.width(), display.height());
+    display.getTextBounds(info, 0, 0, &tbx, &tby, &tbw, &tbh);
+    display.setCursor((display.width() - tbw) / 2, display.height() / 2);
+    display.print(info);
+}
+
+bool EPD_Display::showStatus(int batteryPercent, const char* card) {
+    if (!_display) return false;
+    GxEPD2_GFX& display = *_display;
+    display.setRotation(0);
+    _drawing = true;
+
+#if EPD_HAS_DIRTY_TRACKING
+    // Full frame: redraw the strip in the buffer, the push finds what changed
+    if (_fullFrame) {
+        drawStatus(display, batteryPercent, card);
+        bool changed = pushChanges();
+        _drawing = false;
+        return changed;
+    }
+#endif
+
+    // Paged (or no dirty tracking): refresh just the strip as a partial window
+    Perf::Scope probe(Perf::PROBE_EPD);
+    uint32_t start = millis();
+    display.setPartialWindow(0, EPD_STATUS_Y, display.width(), EPD_STATUS_H);
     display.firstPage();
     do {
-        display.fillScreen(GxEPD_WHITE);
-
-        display.setTextColor(GxEPD_BLACK);
-        display.setFont(&FreeSansBold24pt7b);
-
-        int16_t tbx, tby;
-        uint16_t tbw, tbh;
-
-        // --- TOP: "Hello World! (TOP)" ---
-        const char* topText = "Hello World! (TOP)";
-        display.getTextBounds(topText, 0, 0, &tbx, &tby, &tbw, &tbh);
-        int16_t topX = (display.width() - tbw) / 2 - tbx;
-        int16_t topY = 50 - tby;
-        display.setCursor(topX, topY);
-        display.print(topText);
-
-        // --- BOTTOM: "Hello World! (BOTTOM)" ---
-        const char* bottomText = "Hello World! (BOTTOM)";
-        display.getTextBounds(bottomText, 0, 0, &tbx, &tby, &tbw, &tbh);
-        int16_t bottomX = (display.width() - tbw) / 2 - tbx;
-        int16_t bottomY = display.height() - 50;
-        display.setCursor(bottomX, bottomY);
-        display.print(bottomText);
-
-        // --- CENTER: Display info ---
-        display.setFont();
-        display.setTextSize(2);
-        char info[64];
-        snprintf(info, sizeof(info), "%dx%d pixels", display.width(), display.height());
-        display.getTextBounds(info, 0, 0, &tbx, &tby, &tbw, &tbh);
-        display.setCursor((display.width() - tbw) / 2, display.height() / 2);
-        display.print(info);
-
+        drawStatus(display, batteryPercent, card);
     } while (display.nextPage());
+    display.setFullWindow();
+    logr.info("EPD status: partial window (%lu ms)", (unsigned long)(millis() - start));
+    _drawing = false;
+    return true;
+}
+
+void EPD_Display::drawStatus(Adafruit_GFX& display, int batteryPercent, const char* card) {
+    display.fillRect(0, EPD_STATUS_Y, display.width(), EPD_STATUS_H, GxEPD_WHITE);
 
-    logr.info("Hello World displayed successfully");
+    char text[64];
+    char battery[8] = "--";
+    if (batteryPercent >= 0) {
+        // The gauge can report a little over 100% on a full pack
+        snprintf(battery, sizeof(battery), "%d%%", batteryPercent > 100 ? 100 : batteryPercent);
+    }
+    snprintf(text, sizeof(text), "Battery %s   Card %s", battery, card ? card : "--");
+
+    display.setTextColor(GxEPD_BLACK);
+    display.setFont();
+    display.setTextSize(2);
+    int16_t tbx, tby;
+    uint16_t tbw, tbh;
+    display.getTextBounds(text, 0, 0, &tbx, &tby, &tbw, &tbh);
+    display.setCursor((display.width() - tbw) / 2, EPD_STATUS_Y + (EPD_STATUS_H - tbh) / 2);
+    display.print(text);
+}
+
+bool EPD_Display::pushChanges() {
+#if EPD_HAS_DIRTY_TRACKING
+    if (!_fullFrame) return false;
+    Perf::Scope probe(Perf::PROBE_EPD);
+    uint32_t start = millis();
+    _fullFrame->epd2.resetTransferBytes();
+    bool changed = _fullFrame->displayDirty();
+    // A whole frame would send 2 x WIDTH / 8 x HEIGHT bytes; the time is mostly the refresh
+    logr.info("EPD push: %s (diff %lu us, %lu bytes sent, %lu ms)", changed ? "refreshed" : "unchanged",
+        (unsigned long)_fullFrame->diffTime(), (unsigned long)_fullFrame->epd2.getTransferBytes(),
+        (unsigned long)(millis() - start));
+    return changed;
+#else
+    return false;
+#endif
 }
 
 void EPD_Display::hibernate() {
+    if (!_display) return;
+    if (_display->epd2.isBusy()) {
+        _hibernatePending = true;
+        return;
+    }
+    _hibernatePending = false;
+    _powerOffPending = false;
     logr.info("EPD entering hibernate mode");
-    display.hibernate();
+    _display->hibernate();
+}
+
+void EPD_Display::powerOff() {
+    if (!_display) return;
+    if (_display->epd2.isBusy()) {
+        _powerOffPending = true;
+        return;
+    }
+    _powerOffPending = false;
+    _display->powerOff();
+}
+
+void EPD_Display::update() {
+    // Polling runs onRefreshDone() once BUSY has been released
+    if (_display) _display->epd2.isBusy();
+}
+
+void EPD_Display::onBusy(const void* param) {
+    EPD_Display* self = (EPD_Display*)param;
+    if (self->_busyHandler) self->_busyHandler();
+    else delay(1);
+}
+
+void EPD_Display::onRefreshDone(const void* param) {
+    EPD_Display* self = (EPD_Display*)param;
+    if (self->_hibernatePending) self->hibernate();
+    else if (self->_powerOffPending) self->powerOff();
 }
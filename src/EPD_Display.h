@@ -8,6 +8,46 @@
 #define EPD_DC    D4
 #define EPD_RST   D25
 #define EPD_BUSY  D22
+#define EPD_SCK   SCK
+#define EPD_SDA   MOSI  // The SSD1677 SDA is bidirectional; read back as GPIO
+
+// =====================================================
+// SPI clock tuning: candidates fastest first, one step
+// below the fastest clock whose RAM write reads back
+// intact is kept as margin. The SSD1677 write cycle is
+// 50 ns min (20 MHz), so nothing above is offered even
+// if a sample happens to pass.
+// =====================================================
+#define EPD_SPI_CLOCK_MAX     20000000
+#define EPD_SPI_CLOCKS        { EPD_SPI_CLOCK_MAX, 16000000, 10000000, 8000000 }
+#define EPD_SPI_CLOCK_DEFAULT 4000000   // GxEPD2 default, used if no candidate passes
+
+// =====================================================
+// Return from refresh() at once and finish on the BUSY
+// interrupt; later display access waits for completion
+// =====================================================
+#define EPD_ASYNC_REFRESH  1
+
+// =====================================================
+// Keep a copy of the last pushed frame (full-frame buffer
+// only) so pushChanges() sends just the differing words
+// =====================================================
+#define ENABLE_EPD_SHADOW  1
+
+// =====================================================
+// Status line (battery, last card) redrawn in place: a
+// partial refresh of the changed pixels on a full-frame
+// buffer, of this strip as a partial window when paged
+// =====================================================
+#define EPD_STATUS_Y  380     // Below the centre line, multiple of 8
+#define EPD_STATUS_H  40
+
+// =====================================================
+// Paged buffer only: record the drawing once into a
+// display list and replay it per page instead of running
+// the drawing code on every page
+// =====================================================
+#define ENABLE_EPD_DISPLAY_LIST  1
 
 // Enable GxEPD2_GFX base class
 #define ENABLE_GxEPD2_GFX 1
@@ -22,6 +62,14 @@
 // --- Option 2: 13.3" B&W display ---
 #define USE_133_INCH_BW
 
+// =====================================================
+// Frame buffer strategy, chosen in begin(): a full frame
+// renders in one pass, pages need one pass per page.
+// Auto takes the full frame when the heap allows it.
+// =====================================================
+#define EPD_FRAME_STRATEGY  EPD_Display::Strategy::Auto
+#define EPD_HEAP_RESERVE    (32 * 1024)  // Heap left to the rest of the firmware
+
 // =====================================================
 // Auto-configuration based on selection
 // =====================================================
@@ -31,31 +79,69 @@
     #include <GxEPD2_3C.h>
     #define GxEPD2_DRIVER_CLASS GxEPD2_420c  // GDEW042Z15 400x300, UC8176 (Waveshare)
     #define MAX_HEIGHT(EPD) (EPD::HEIGHT <= (MAX_DISPLAY_BUFFER_SIZE / 2) / (EPD::WIDTH / 8) ? EPD::HEIGHT : (MAX_DISPLAY_BUFFER_SIZE / 2) / (EPD::WIDTH / 8))
-    typedef GxEPD2_3C<GxEPD2_DRIVER_CLASS, MAX_HEIGHT(GxEPD2_DRIVER_CLASS)> EPD_Display_t;
+    typedef GxEPD2_3C<GxEPD2_DRIVER_CLASS, GxEPD2_DRIVER_CLASS::HEIGHT> EPD_FullFrame_t;
+    typedef GxEPD2_3C<GxEPD2_DRIVER_CLASS, MAX_HEIGHT(GxEPD2_DRIVER_CLASS)> EPD_Paged_t;
 
 #elif defined(USE_133_INCH_BW)
     #include <GxEPD2_BW.h>
     #define GxEPD2_DRIVER_CLASS GxEPD2_1330_GDEM133T91  // 960x680, SSD1677
     #define MAX_HEIGHT(EPD) (EPD::HEIGHT <= MAX_DISPLAY_BUFFER_SIZE / (EPD::WIDTH / 8) ? EPD::HEIGHT : MAX_DISPLAY_BUFFER_SIZE / (EPD::WIDTH / 8))
-    typedef GxEPD2_BW<GxEPD2_DRIVER_CLASS, MAX_HEIGHT(GxEPD2_DRIVER_CLASS)> EPD_Display_t;
+    typedef GxEPD2_BW<GxEPD2_DRIVER_CLASS, GxEPD2_DRIVER_CLASS::HEIGHT> EPD_FullFrame_t;
+    typedef GxEPD2_BW<GxEPD2_DRIVER_CLASS, MAX_HEIGHT(GxEPD2_DRIVER_CLASS)> EPD_Paged_t;
+    #define EPD_HAS_DIRTY_TRACKING 1
 
 #else
     #error "Please define USE_42_INCH_3C or USE_133_INCH_BW in EPD_Display.h"
 #endif
 
+#include "EPD_DisplayList.h"
+
 /**
  * EPD Display singleton class for 13.3" e-paper display
  */
 class EPD_Display {
 public:
+    enum class Strategy : uint8_t {
+        Auto,       // Full frame if the heap allows, else paged
+        FullFrame,  // Full frame, paged if the allocation fails
+        Paged
+    };
+
+    // Runs while display access waits for a refresh to finish
+    typedef void (*BusyHandler)();
+
     static EPD_Display &instance();
 
-    void begin();
+    void begin(Strategy strategy = EPD_FRAME_STRATEGY);
     void showHelloWorld();
-    void hibernate();
-
-    // Access to underlying display for advanced usage
-    EPD_Display_t& getDisplay() { return display; }
+    // Redraw the status line; batteryPercent < 0 or card nullptr show "--".
+    // Returns false if the panel content did not change
+    bool showStatus(int batteryPercent, const char* card);
+    void hibernate();                  // Deferred until an ongoing refresh completes
+    // Panel voltages off, controller RAM kept so the next push stays partial;
+    // deferred like hibernate()
+    void powerOff();
+
+    // Upload and refresh only what changed since the last push (full-frame
+    // buffer only); false if nothing changed
+    bool pushChanges();
+
+    // Refreshing, or a drawing call is waiting for a refresh
+    bool isBusy() { return _display && (_drawing || _display->epd2.isBusy()); }
+    void update();                     // Call often: completes refreshes, runs deferred work
+    void setBusyHandler(BusyHandler handler) { _busyHandler = handler; }
+
+    // Re-probe the SPI clock (otherwise kept in retained RAM across resets)
+    uint32_t tuneSPI();
+    uint32_t getSPIClock() { return _display ? _display->epd2.getSPIClock() : 0; }
+    // Bytes/s of the last frame upload
+    uint32_t getTransferRate() { return _display ? _display->epd2.getTransferRate() : 0; }
+
+    bool isFullFrame() const { return _fullFrame != nullptr; }
+    static const char* strategyName(Strategy strategy);
+
+    // Access to underlying display for advanced usage, valid after begin()
+    GxEPD2_GFX& getDisplay() { return *_display; }
 
 private:
     EPD_Display();
@@ -64,8 +150,22 @@ private:
     EPD_Display(const EPD_Display&) = delete;
     EPD_Display& operator=(const EPD_Display&) = delete;
 
+    void drawHelloWorld(Adafruit_GFX& display);
+    void drawStatus(Adafruit_GFX& display, int batteryPercent, const char* card);
+
+    static void onBusy(const void* param);
+    static void onRefreshDone(const void* param);
+
     static EPD_Display *_instance;
-    EPD_Display_t display;
+    GxEPD2_GFX* _display = nullptr;        // Either of the two below
+    EPD_FullFrame_t* _fullFrame = nullptr;
+    EPD_Paged_t* _paged = nullptr;
+    BusyHandler _busyHandler = nullptr;
+    uint8_t* _shadow = nullptr;
+    EPD_DisplayList* _list = nullptr;      // Paged buffer only
+    bool _hibernatePending = false;
+    bool _powerOffPending = false;
+    bool _drawing = false;                 // Guards against re-entry from the busy handler
 };
 
 #endif /* __EPD_DISPLAY_H */
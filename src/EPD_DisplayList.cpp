@@ -0,0 +1,263 @@
+#include "EPD_DisplayList.h"
+
+EPD_DisplayList::EPD_DisplayList(int16_t w, int16_t h) : Adafruit_GFX(w, h) {
+}
+
+void EPD_DisplayList::clear() {
+    _count = 0;
+    _textLength = 0;
+    _overflowed = false;
+}
+
+EPD_DisplayList::Item* EPD_DisplayList::add(Op op, uint16_t color,
+        int16_t bx0, int16_t by0, int16_t bx1, int16_t by1) {
+    // Off screen entirely: nothing to replay
+    if (bx1 < 0 || by1 < 0 || bx0 >= _width || by0 >= _height) return nullptr;
+    if (_count >= DISPLAY_LIST_MAX_ITEMS) {
+        _overflowed = true;
+        return nullptr;
+    }
+    Item& item = _items[_count++];
+    item.op = op;
+    item.color = color;
+    item.bx0 = bx0;
+    item.by0 = by0;
+    item.bx1 = bx1;
+    item.by1 = by1;
+    return &item;
+}
+
+void EPD_DisplayList::drawPixel(int16_t x, int16_t y, uint16_t color) {
+    // Extend the previous run when the pixel continues it
+    if (_count > 0) {
+        Item& last = _items[_count - 1];
+        if (last.op == Op::Fill && last.h == 1 && last.y == y && last.color == color &&
+                last.x + last.w == x) {
+            last.w++;
+            last.bx1 = x;
+            return;
+        }
+    }
+    fillRect(x, y, 1, 1, color);
+}
+
+void EPD_DisplayList::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    fillRect(x, y, w, 1, color);
+}
+
+void EPD_DisplayList::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    fillRect(x, y, 1, h, color);
+}
+
+void EPD_DisplayList::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    if (w <= 0 || h <= 0) return;
+    Item* item = add(Op::Fill, color, x, y, x + w - 1, y + h - 1);
+    if (!item) return;
+    item->x = x;
+    item->y = y;
+    item->w = w;
+    item->h = h;
+}
+
+void EPD_DisplayList::fillScreen(uint16_t color) {
+    // Everything recorded so far is covered
+    clear();
+    fillRect(0, 0, _width, _height, color);
+}
+
+void EPD_DisplayList::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    writeLine(x0, y0, x1, y1, color);
+}
+
+void EPD_DisplayList::writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    Item* item = add(Op::Line, color, x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1,
+        x0 > x1 ? x0 : x1, y0 > y1 ? y0 : y1);
+    if (!item) return;
+    item->x = x0;
+    item->y = y0;
+    item->w = x1;
+    item->h = y1;
+}
+
+void EPD_DisplayList::drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h,
+        uint16_t color) {
+    if (w <= 0 || h <= 0) return;
+    Item* item = add(Op::Bitmap, color, x, y, x + w - 1, y + h - 1);
+    if (!item) return;
+    item->x = x;
+    item->y = y;
+    item->w = w;
+    item->h = h;
+    item->hasBg = false;
+    item->bitmap = bitmap;
+}
+
+void EPD_DisplayList::drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h,
+        uint16_t color, uint16_t bg) {
+    drawBitmap(x, y, bitmap, w, h, color);
+    if (_count > 0 && _items[_count - 1].op == Op::Bitmap && _items[_count - 1].bitmap == bitmap) {
+        _items[_count - 1].hasBg = true;
+        _items[_count - 1].bg = bg;
+    }
+}
+
+bool EPD_DisplayList::charBox(uint8_t c, int16_t& x, int16_t& y,
+        int16_t& bx0, int16_t& by0, int16_t& bx1, int16_t& by1) {
+    if (!gfxFont) {
+        if (c == '\n') {
+            x = 0;
+            y += textsize * 8;
+            return false;
+        }
+        if (c == '\r') return false;
+        if (wrap && x + textsize * 6 > _width) {
+            x = 0;
+            y += textsize * 8;
+        }
+        bx0 = x;
+        by0 = y;
+        bx1 = x + textsize * 6 - 1;
+        by1 = y + textsize * 8 - 1;
+        x += textsize * 6;
+        return true;
+    }
+
+    if (c == '\n') {
+        x = 0;
+        y += (int16_t)textsize * gfxFont->yAdvance;
+        return false;
+    }
+    if (c == '\r' || c < gfxFont->first || c > gfxFont->last) return false;
+    const GFXglyph& glyph = gfxFont->glyph[c - gfxFont->first];
+    bool ink = glyph.width > 0 && glyph.height > 0;
+    if (ink) {
+        if (wrap && x + textsize * (glyph.xOffset + glyph.width) > _width) {
+            x = 0;
+            y += (int16_t)textsize * gfxFont->yAdvance;
+        }
+        bx0 = x + glyph.xOffset * textsize;
+        by0 = y + glyph.yOffset * textsize;
+        bx1 = bx0 + glyph.width * textsize - 1;
+        by1 = by0 + glyph.height * textsize - 1;
+    }
+    x += (int16_t)glyph.xAdvance * textsize;
+    return ink;
+}
+
+size_t EPD_DisplayList::write(uint8_t c) {
+    int16_t startX = cursor_x;
+    int16_t startY = cursor_y;
+    int16_t bx0, by0, bx1, by1;
+    bool ink = charBox(c, cursor_x, cursor_y, bx0, by0, bx1, by1);
+
+    // Continue the open run if nothing changed since its last character
+    Item* run = nullptr;
+    if (_count > 0) {
+        Item& last = _items[_count - 1];
+        if (last.op == Op::Text && _runX == startX && _runY == startY &&
+                last.text.font == gfxFont && last.size == textsize && last.wrap == wrap &&
+                last.color == textcolor && last.bg == textbgcolor &&
+                last.text.offset + last.text.length == _textLength) {
+            run = &last;
+        }
+    }
+    if (!run) {
+        // A run starts with ink; newlines and spaces before it only move the cursor
+        if (!ink) return 1;
+        run = add(Op::Text, textcolor, bx0, by0, bx1, by1);
+        if (!run) return 1;
+        run->x = startX;
+        run->y = startY;
+        run->size = textsize;
+        run->wrap = wrap;
+        run->bg = textbgcolor;
+        run->text.font = gfxFont;
+        run->text.offset = _textLength;
+        run->text.length = 0;
+    }
+    if (_textLength >= DISPLAY_LIST_TEXT_SIZE) {
+        _overflowed = true;
+        return 1;
+    }
+    _text[_textLength++] = c;
+    run->text.length++;
+    if (ink) {
+        if (bx0 < run->bx0) run->bx0 = bx0;
+        if (by0 < run->by0) run->by0 = by0;
+        if (bx1 > run->bx1) run->bx1 = bx1;
+        if (by1 > run->by1) run->by1 = by1;
+    }
+    _runX = cursor_x;
+    _runY = cursor_y;
+    return 1;
+}
+
+void EPD_DisplayList::render(GxEPD2_GFX& target) {
+    const uint16_t pages = target.pages();
+    const int16_t pageHeight = target.pageHeight();
+    const uint8_t rotation = target.getRotation();
+    // Pages split the native rows, which run along x when rotated by 90 or 270
+    const bool alongX = rotation & 1;
+    const int16_t nativeHeight = alongX ? target.width() : target.height();
+
+    _replayUs = 0;
+    _passes = 0;
+    _replayed = 0;
+    _culled = 0;
+
+    target.firstPage();
+    do {
+        uint32_t start = micros();
+        // The fast partial update's second phase starts over at page 0
+        int16_t ys = (_passes % pages) * pageHeight;
+        int16_t ye = ys + pageHeight - 1;
+        int16_t lo = ys, hi = ye;
+        if (rotation >= 2) {
+            lo = nativeHeight - 1 - ye;
+            hi = nativeHeight - 1 - ys;
+        }
+        for (uint16_t i = 0; i < _count; i++) {
+            const Item& item = _items[i];
+            int16_t a = alongX ? item.bx0 : item.by0;
+            int16_t b = alongX ? item.bx1 : item.by1;
+            if (b < lo || a > hi) {
+                _culled++;
+                continue;
+            }
+            replay(target, item);
+            _replayed++;
+        }
+        _replayUs += micros() - start;
+        _passes++;
+    } while (target.nextPage());
+}
+
+void EPD_DisplayList::replay(GxEPD2_GFX& target, const Item& item) {
+    switch (item.op) {
+        case Op::Fill:
+            // A full-screen fill clears the page buffer at once instead of pixel by pixel
+            if (item.x <= 0 && item.y <= 0 && item.x + item.w >= target.width() &&
+                item.y + item.h >= target.height()) target.fillScreen(item.color);
+            else if (item.h == 1) target.drawFastHLine(item.x, item.y, item.w, item.color);
+            else if (item.w == 1) target.drawFastVLine(item.x, item.y, item.h, item.color);
+            else target.fillRect(item.x, item.y, item.w, item.h, item.color);
+            break;
+        case Op::Line:
+            target.drawLine(item.x, item.y, item.w, item.h, item.color);
+            break;
+        case Op::Text:
+            target.setFont(item.text.font);
+            target.setTextSize(item.size);
+            target.setTextColor(item.color, item.bg);
+            target.setTextWrap(item.wrap);
+            target.setCursor(item.x, item.y);
+            for (uint16_t i = 0; i < item.text.length; i++) {
+                target.write((uint8_t)_text[item.text.offset + i]);
+            }
+            break;
+        case Op::Bitmap:
+            if (item.hasBg) target.drawBitmap(item.x, item.y, item.bitmap, item.w, item.h, item.color, item.bg);
+            else target.drawBitmap(item.x, item.y, item.bitmap, item.w, item.h, item.color);
+            break;
+    }
+}
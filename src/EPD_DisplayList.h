@@ -0,0 +1,102 @@
+#ifndef EPD_DISPLAY_LIST_H
+#define EPD_DISPLAY_LIST_H
+
+#include "Particle.h"
+#include <GxEPD2_GFX.h>
+
+// =====================================================
+// Display list for paged rendering: the drawing code runs
+// once against the list, which keeps compact primitives
+// (fills, lines, text runs, bitmaps) and replays them on
+// every page, skipping those outside the page's rows.
+// Anything else arrives as pixels and is merged into
+// horizontal runs.
+// =====================================================
+#define DISPLAY_LIST_MAX_ITEMS  128
+#define DISPLAY_LIST_TEXT_SIZE  512   // Characters of all text runs
+
+class EPD_DisplayList : public Adafruit_GFX {
+public:
+    // Same raw size as the display it is replayed on
+    EPD_DisplayList(int16_t w, int16_t h);
+
+    void clear();
+
+    // Items or text did not fit: the list is incomplete, draw directly instead
+    bool isOverflowed() const { return _overflowed; }
+    uint16_t getItemCount() const { return _count; }
+
+    // Runs the target's firstPage()/nextPage() loop, full window, replaying
+    // the items that overlap each page
+    void render(GxEPD2_GFX& target);
+
+    // Stats of the last render()
+    uint32_t getReplayUs() const { return _replayUs; }
+    uint16_t getPasses() const { return _passes; }
+    uint32_t getReplayed() const { return _replayed; }
+    uint32_t getCulled() const { return _culled; }
+
+    // Adafruit_GFX
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+    void fillScreen(uint16_t color) override;
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override;
+    void writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) override;
+    size_t write(uint8_t c) override;
+
+    // Recorded as one item when called on the list itself; through an
+    // Adafruit_GFX reference bitmaps arrive as pixel runs
+    void drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color);
+    void drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color, uint16_t bg);
+
+private:
+    enum class Op : uint8_t {
+        Fill,       // x, y, w, h
+        Line,       // x, y to w, h
+        Text,       // Cursor x, y; chars in _text
+        Bitmap,     // x, y, w, h; bg used if hasBg
+    };
+
+    struct Item {
+        Op op;
+        bool hasBg;             // Bitmap
+        bool wrap;              // Text
+        uint8_t size;           // Text
+        uint16_t color;
+        uint16_t bg;
+        int16_t x, y, w, h;
+        int16_t bx0, by0, bx1, by1;  // Bounding box, inclusive
+        union {
+            const uint8_t* bitmap;
+            struct {
+                const GFXfont* font;
+                uint16_t offset;
+                uint16_t length;
+            } text;
+        };
+    };
+
+    Item* add(Op op, uint16_t color, int16_t bx0, int16_t by0, int16_t bx1, int16_t by1);
+    void replay(GxEPD2_GFX& target, const Item& item);
+    // Box of character c printed at (x, y), advancing x, y exactly as write() does
+    bool charBox(uint8_t c, int16_t& x, int16_t& y, int16_t& bx0, int16_t& by0, int16_t& bx1, int16_t& by1);
+
+    Item _items[DISPLAY_LIST_MAX_ITEMS];
+    uint16_t _count = 0;
+    char _text[DISPLAY_LIST_TEXT_SIZE];
+    uint16_t _textLength = 0;
+    bool _overflowed = false;
+
+    // Where the open text run expects its next character
+    int16_t _runX = 0;
+    int16_t _runY = 0;
+
+    uint32_t _replayUs = 0;
+    uint16_t _passes = 0;
+    uint32_t _replayed = 0;
+    uint32_t _culled = 0;
+};
+
+#endif
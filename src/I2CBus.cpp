@@ -0,0 +1,245 @@
+#include "I2CBus.h"
+#include "Perf.h"
+
+I2CBus& I2CBus::instance() {
+    static I2CBus _instance;
+    return _instance;
+}
+
+void I2CBus::begin() {
+    Wire.begin();
+    _statsSince = millis();
+}
+
+int I2CBus::addDevice(uint8_t address, const char* name, Priority priority, pin_t demandPin) {
+    for (int i = 0; i < _deviceCount; i++) {
+        if (_devices[i].address == address) return i;
+    }
+    if (_deviceCount >= I2C_MAX_DEVICES) {
+        Serial.printlnf("I2C device table full, %s dropped", name);
+        return -1;
+    }
+    Device& d = _devices[_deviceCount];
+    d = Device();
+    d.address = address;
+    d.name = name;
+    d.priority = priority;
+    d.demandPin = demandPin;
+    return _deviceCount++;
+}
+
+bool I2CBus::mustYield(const Device& device) {
+    // Runs on the caller's thread between transactions, so an in-flight
+    // transfer is never interrupted; the yielding driver keeps its cached data
+    uint32_t now = millis();
+    bool yield = false;
+    for (int i = 0; i < _deviceCount; i++) {
+        Device& other = _devices[i];
+        if (other.demandPin == PIN_INVALID) continue;
+        if (digitalRead(other.demandPin) != LOW) {
+            other.demandSince = 0;
+            continue;
+        }
+        if (other.demandSince == 0) other.demandSince = now ? now : 1;
+        // A demand pin stuck LOW must not starve the rest of the bus
+        if (other.priority > device.priority && now - other.demandSince < I2C_DEFER_MAX_MS) {
+            yield = true;
+        }
+    }
+    return yield;
+}
+
+I2CBus::Result I2CBus::transfer(int dev, const Segment* segments, uint8_t count) {
+    if (dev < 0 || dev >= _deviceCount || count == 0) return Result::Error;
+    Device& device = _devices[dev];
+    DeviceStats& st = device.stats;
+
+    if (mustYield(device)) {
+        st.deferred++;
+        return Result::Busy;
+    }
+
+    Perf::Scope probe(Perf::PROBE_I2C);
+    uint32_t start = micros();
+    Result result;
+    uint8_t attempt = 0;
+
+    // Serialise against other threads for the whole batch
+    Wire.lock();
+    for (;;) {
+        result = runSegments(device, segments, count);
+        if (result != Result::Nack || attempt >= I2C_RETRIES || isStuck()) break;
+        attempt++;
+        st.retries++;
+    }
+    // A slave holding SDA (or SCL) low makes the master lose arbitration at
+    // once, which reads as a NACK rather than a timeout: check the lines
+    if (result == Result::Timeout || (result != Result::OK && isStuck())) {
+        recover();
+    }
+    Wire.unlock();
+
+    uint32_t elapsed = micros() - start;
+    st.transactions++;
+    st.totalUs += elapsed;
+    if (elapsed > st.maxUs) st.maxUs = elapsed;
+    if (result == Result::Nack) st.nacks++;
+    if (result == Result::Timeout) st.timeouts++;
+    if (result == Result::OK) {
+        for (uint8_t i = 0; i < count; i++) {
+            st.bytesTx += segments[i].txLen;
+            st.bytesRx += segments[i].rxLen;
+        }
+    }
+    return result;
+}
+
+I2CBus::Result I2CBus::runSegments(const Device& device, const Segment* segments, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        const Segment& seg = segments[i];
+        bool last = i == count - 1;
+
+        if (seg.txLen > 0 || seg.rxLen == 0) {
+            uint32_t t0 = millis();
+            Wire.beginTransmission(WireTransmission(device.address).timeout(I2C_TIMEOUT_MS));
+            if (seg.txLen > 0) Wire.write(seg.tx, seg.txLen);
+            // Repeated start into the read or the next segment
+            uint8_t err = Wire.endTransmission(last && seg.rxLen == 0);
+            if (err != 0) {
+                return millis() - t0 >= I2C_TIMEOUT_MS ? Result::Timeout : Result::Nack;
+            }
+        }
+        if (seg.rxLen > 0) {
+            uint32_t t0 = millis();
+            size_t n = Wire.requestFrom(WireTransmission(device.address)
+                .quantity(seg.rxLen).timeout(I2C_TIMEOUT_MS).stop(last));
+            if (n != seg.rxLen) {
+                while (Wire.available()) Wire.read();
+                return millis() - t0 >= I2C_TIMEOUT_MS ? Result::Timeout : Result::Nack;
+            }
+            for (uint8_t j = 0; j < seg.rxLen; j++) {
+                seg.rx[j] = Wire.read();
+            }
+        }
+    }
+    return Result::OK;
+}
+
+I2CBus::Result I2CBus::write(int dev, const uint8_t* data, uint8_t len) {
+    Segment seg = {data, len, nullptr, 0};
+    return transfer(dev, &seg, 1);
+}
+
+I2CBus::Result I2CBus::read(int dev, uint8_t* data, uint8_t len) {
+    Segment seg = {nullptr, 0, data, len};
+    return transfer(dev, &seg, 1);
+}
+
+I2CBus::Result I2CBus::writeRead(int dev, const uint8_t* tx, uint8_t txLen, uint8_t* rx, uint8_t rxLen) {
+    Segment seg = {tx, txLen, rx, rxLen};
+    return transfer(dev, &seg, 1);
+}
+
+I2CBus::Result I2CBus::readRegs(int dev, uint8_t reg, uint8_t* data, uint8_t len) {
+    return writeRead(dev, &reg, 1, data, len);
+}
+
+I2CBus::Result I2CBus::writeRegs(int dev, uint8_t reg, const uint8_t* data, uint8_t len) {
+    uint8_t buf[1 + 16];
+    if (len > sizeof(buf) - 1) return Result::Error;
+    buf[0] = reg;
+    memcpy(buf + 1, data, len);
+    return write(dev, buf, len + 1);
+}
+
+bool I2CBus::probe(uint8_t address) {
+    Wire.lock();
+    Wire.beginTransmission(WireTransmission(address).timeout(I2C_TIMEOUT_MS));
+    bool present = Wire.endTransmission() == 0;
+    Wire.unlock();
+    return present;
+}
+
+bool I2CBus::recover() {
+    // A slave stuck mid-byte holds SDA low: clock SCL (up to 9 bits) until it
+    // lets go, then issue a STOP by hand and restart the peripheral. Both
+    // lines are open drain, so a slave still holding one is never driven
+    // against
+    Wire.lock();
+    Wire.end();
+    pinMode(I2C_SDA_PIN, INPUT_PULLUP);
+    digitalWrite(I2C_SCL_PIN, HIGH);
+    pinMode(I2C_SCL_PIN, OUTPUT_OPEN_DRAIN);
+    for (int i = 0; i < 9 && digitalRead(I2C_SDA_PIN) == LOW; i++) {
+        digitalWrite(I2C_SCL_PIN, LOW);
+        delayMicroseconds(5);
+        digitalWrite(I2C_SCL_PIN, HIGH);
+        delayMicroseconds(5);
+    }
+    digitalWrite(I2C_SDA_PIN, LOW);
+    pinMode(I2C_SDA_PIN, OUTPUT_OPEN_DRAIN);
+    delayMicroseconds(5);
+    digitalWrite(I2C_SCL_PIN, HIGH);
+    delayMicroseconds(5);
+    digitalWrite(I2C_SDA_PIN, HIGH);
+    delayMicroseconds(5);
+    pinMode(I2C_SDA_PIN, INPUT);
+    pinMode(I2C_SCL_PIN, INPUT);
+    Wire.begin();
+    bool released = !isStuck();
+    Wire.unlock();
+
+    _recoveries++;
+    Serial.printlnf("I2C bus recovery %s", released ? "done" : "FAILED, SDA or SCL still low");
+    return released;
+}
+
+bool I2CBus::isStuck() const {
+    // Both lines idle high between transfers
+    return digitalRead(I2C_SDA_PIN) == LOW || digitalRead(I2C_SCL_PIN) == LOW;
+}
+
+bool I2CBus::PN532Transport::write(uint8_t address, const uint8_t* data, uint8_t len) {
+    (void)address;
+    return I2CBus::instance().write(dev, data, len) == Result::OK;
+}
+
+uint8_t I2CBus::PN532Transport::read(uint8_t address, uint8_t* data, uint8_t len) {
+    (void)address;
+    return I2CBus::instance().read(dev, data, len) == Result::OK ? len : 0;
+}
+
+DFRobot_PN532_Bus* I2CBus::pn532Bus(int dev) {
+    _pn532.dev = dev;
+    return &_pn532;
+}
+
+const I2CBus::DeviceStats* I2CBus::getStats(int dev) const {
+    if (dev < 0 || dev >= _deviceCount) return nullptr;
+    return &_devices[dev].stats;
+}
+
+void I2CBus::resetStats() {
+    for (int i = 0; i < _deviceCount; i++) {
+        _devices[i].stats = DeviceStats();
+    }
+    _recoveries = 0;
+    _statsSince = millis();
+}
+
+void I2CBus::printStats() {
+    Serial.printlnf("--- I2C bus (%lu ms, %lu recoveries) ---",
+        (unsigned long)(millis() - _statsSince), (unsigned long)_recoveries);
+    for (int i = 0; i < _deviceCount; i++) {
+        const Device& d = _devices[i];
+        const DeviceStats& st = d.stats;
+        Serial.printlnf("0x%02X %-8s xfers=%-6lu tx=%-7lu rx=%-7lu mean=%5lu us max=%6lu us "
+            "nack=%lu retry=%lu timeout=%lu yield=%lu",
+            d.address, d.name, (unsigned long)st.transactions,
+            (unsigned long)st.bytesTx, (unsigned long)st.bytesRx,
+            (unsigned long)(st.transactions ? st.totalUs / st.transactions : 0),
+            (unsigned long)st.maxUs, (unsigned long)st.nacks, (unsigned long)st.retries,
+            (unsigned long)st.timeouts, (unsigned long)st.deferred);
+    }
+    Serial.println("---------------------------------");
+}
@@ -0,0 +1,117 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include "Particle.h"
+#include "DFRobot_PN532.h"
+
+#define I2C_SDA_PIN         D0
+#define I2C_SCL_PIN         D1
+
+#define I2C_MAX_DEVICES     6
+#define I2C_TIMEOUT_MS      25    // Per transfer, a stuck bus is recovered after this
+#define I2C_RETRIES         2     // Extra attempts after a NACK
+#define I2C_DEFER_MAX_MS    50    // Longest a lower priority device yields to a waiting one
+
+// =====================================================
+// Shared I2C bus: every driver goes through here so
+// access is serialised, NACKs are retried, a stuck bus
+// is recovered and per-device traffic is counted.
+// =====================================================
+class I2CBus {
+public:
+    enum class Priority : uint8_t {
+        Low,        // Telemetry, battery
+        Normal,     // Charger
+        High        // PN532
+    };
+
+    enum class Result : uint8_t {
+        OK,
+        Nack,
+        Timeout,
+        Busy,       // Yielded to a higher priority device, try again later
+        Error
+    };
+
+    // One part of a batched transaction; segments are joined by repeated starts
+    struct Segment {
+        const uint8_t* tx;
+        uint8_t txLen;
+        uint8_t* rx;
+        uint8_t rxLen;
+    };
+
+    struct DeviceStats {
+        uint32_t transactions;
+        uint32_t bytesTx;
+        uint32_t bytesRx;
+        uint32_t nacks;
+        uint32_t timeouts;
+        uint32_t retries;
+        uint32_t deferred;      // Busy results
+        uint64_t totalUs;
+        uint32_t maxUs;
+    };
+
+    static I2CBus& instance();
+
+    void begin();
+
+    // Returns a device id, or -1 if the table is full. A device with a demand
+    // pin has data waiting while that pin is LOW (e.g. the PN532 IRQ);
+    // lower priority devices then yield for up to I2C_DEFER_MAX_MS.
+    int addDevice(uint8_t address, const char* name, Priority priority,
+                  pin_t demandPin = PIN_INVALID);
+
+    Result write(int dev, const uint8_t* data, uint8_t len);
+    Result read(int dev, uint8_t* data, uint8_t len);
+    Result writeRead(int dev, const uint8_t* tx, uint8_t txLen, uint8_t* rx, uint8_t rxLen);
+    Result transfer(int dev, const Segment* segments, uint8_t count);
+
+    // Register helpers (8-bit register pointer, auto-increment)
+    Result readRegs(int dev, uint8_t reg, uint8_t* data, uint8_t len);
+    Result writeRegs(int dev, uint8_t reg, const uint8_t* data, uint8_t len);
+
+    bool probe(uint8_t address);
+    bool recover();                 // Clock SCL until SDA is released, then STOP
+    bool isStuck() const;           // SDA or SCL held low while the bus is idle
+
+    // PN532 library transport over this bus
+    DFRobot_PN532_Bus* pn532Bus(int dev);
+
+    const DeviceStats* getStats(int dev) const;
+    uint32_t getRecoveries() const { return _recoveries; }
+    void resetStats();
+
+    // For debugging
+    void printStats();
+
+private:
+    struct Device {
+        uint8_t address;
+        const char* name;
+        Priority priority;
+        pin_t demandPin;
+        uint32_t demandSince;    // millis() the pin went LOW, 0 if not
+        DeviceStats stats;
+    };
+
+    class PN532Transport : public DFRobot_PN532_Bus {
+    public:
+        int dev = -1;
+        bool write(uint8_t address, const uint8_t* data, uint8_t len) override;
+        uint8_t read(uint8_t address, uint8_t* data, uint8_t len) override;
+    };
+
+    I2CBus() = default;
+    bool mustYield(const Device& device);
+    Result runSegments(const Device& device, const Segment* segments, uint8_t count);
+
+    Device _devices[I2C_MAX_DEVICES] = {};
+    uint8_t _deviceCount = 0;
+    uint32_t _recoveries = 0;
+    uint32_t _statsSince = 0;
+    PN532Transport _pn532;
+};
+
+#endif
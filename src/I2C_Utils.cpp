@@ -1,4 +1,5 @@
 #include "I2C_Utils.h"
+#include "I2CBus.h"
 
 void I2C_Utils::scanBus() {
     Log.info("I2C bus scan starting...");
@@ -19,6 +20,17 @@ void I2C_Utils::scanBus() {
 }
 
 bool I2C_Utils::devicePresent(uint8_t address) {
-    Wire.beginTransmission(address);
-    return (Wire.endTransmission() == 0);
+    return I2CBus::instance().probe(address);
+}
+
+void I2C_Utils::printStats() {
+    I2CBus::instance().printStats();
+}
+
+void I2C_Utils::resetStats() {
+    I2CBus::instance().resetStats();
+}
+
+bool I2C_Utils::recoverBus() {
+    return I2CBus::instance().recover();
 }
@@ -3,9 +3,13 @@
 
 #include "Particle.h"
 
+// Diagnostics for the shared bus (see I2CBus)
 namespace I2C_Utils {
     void scanBus();
     bool devicePresent(uint8_t address);
+    void printStats();
+    void resetStats();
+    bool recoverBus();
 }
 
 #endif
@@ -0,0 +1,38 @@
+#include "Perf.h"
+
+static const char* const PROBE_NAMES[Perf::PROBE_COUNT] = {
+    "loop", "rfid", "i2c", "battery", "epd"
+};
+
+Perf& Perf::instance() {
+    static Perf _instance;
+    return _instance;
+}
+
+void Perf::record(Probe probe, uint32_t us) {
+    Stats& st = _stats[probe];
+    st.count++;
+    st.totalUs += us;
+    if (us > st.maxUs) st.maxUs = us;
+}
+
+void Perf::reset() {
+    memset(_stats, 0, sizeof(_stats));
+    _since = millis();
+}
+
+void Perf::print() {
+    uint32_t elapsedMs = millis() - _since;
+    if (elapsedMs == 0) elapsedMs = 1;
+
+    Serial.printlnf("--- Perf (%lu ms) ---", (unsigned long)elapsedMs);
+    for (int i = 0; i < PROBE_COUNT; i++) {
+        const Stats& st = _stats[i];
+        if (st.count == 0) continue;
+        Serial.printlnf("%-12s n=%-7lu mean=%6lu us  max=%7lu us  busy=%5.2f%%",
+            PROBE_NAMES[i], (unsigned long)st.count,
+            (unsigned long)(st.totalUs / st.count), (unsigned long)st.maxUs,
+            st.totalUs / (elapsedMs * 10.0f));
+    }
+    Serial.println("---------------------");
+}
@@ -0,0 +1,54 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include "Particle.h"
+
+// =====================================================
+// Lightweight on-device timing probes: loop latency,
+// I2C bus time, display push time. Costs two micros()
+// calls per measured section.
+// =====================================================
+
+class Perf {
+public:
+    enum Probe {
+        PROBE_LOOP = 0,     // One loop() pass
+        PROBE_RFID,         // RFID::poll()
+        PROBE_I2C,          // I2CBus transactions (all devices)
+        PROBE_BATTERY,      // Battery sampling
+        PROBE_EPD,          // Display draw, upload and refresh
+        PROBE_COUNT
+    };
+
+    struct Stats {
+        uint32_t count;
+        uint64_t totalUs;
+        uint32_t maxUs;
+    };
+
+    // Measures the enclosing scope
+    class Scope {
+    public:
+        explicit Scope(Probe probe) : _probe(probe), _start(micros()) {}
+        ~Scope() { Perf::instance().record(_probe, micros() - _start); }
+    private:
+        Probe _probe;
+        uint32_t _start;
+    };
+
+    static Perf& instance();
+
+    void record(Probe probe, uint32_t us);
+    const Stats& get(Probe probe) const { return _stats[probe]; }
+    void reset();
+
+    // Count, mean, max and share of elapsed time per probe
+    void print();
+
+private:
+    Perf() = default;
+    Stats _stats[PROBE_COUNT] = {};
+    uint32_t _since = 0;   // millis() at the last reset
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "PowerManager.h"
+#include "RFID.h"
+#include "Buttons.h"
+#include "Buzzer.h"
+#include "Battery.h"
+#include "Charger.h"
+#include "EPD_Display.h"
+
+PowerManager& PowerManager::instance() {
+    static PowerManager _instance;
+    return _instance;
+}
+
+void PowerManager::begin() {
+    _lastActivity = millis();
+    _statsSince = millis();
+}
+
+void PowerManager::setEnabled(bool enable) {
+    _enabled = enable;
+    if (!enable) exitIdle();
+}
+
+void PowerManager::activity() {
+    _lastActivity = millis();
+    exitIdle();
+}
+
+void PowerManager::setExternalPower(bool present) {
+    if (present == _externalPower) return;
+    _externalPower = present;
+    // Plugging in or unplugging counts as activity: restart the hold time
+    activity();
+}
+
+void PowerManager::enterIdle() {
+    if (_idle) return;
+    _idle = true;
+    // Let the scan in flight finish; the next sweep starts the duty cycle
+    RFID::instance().pause();
+    _lastSweep = millis() - POWER_IDLE_SCAN_MS;
+}
+
+void PowerManager::exitIdle() {
+    if (!_idle) return;
+    _idle = false;
+    RFID::instance().resume();
+}
+
+void PowerManager::idle(uint32_t maxSleepMs) {
+    if (!_enabled || _externalPower) return;
+
+    uint32_t now = millis();
+    if (now - _lastActivity < POWER_ACTIVE_HOLD_MS) return;
+    enterIdle();
+
+    RFID& rfid = RFID::instance();
+    if (!rfid.isIdle()) return;  // Sweep or card hand-out in progress
+
+    uint32_t sinceSweep = now - _lastSweep;
+    if (sinceSweep >= POWER_IDLE_SCAN_MS) {
+        _lastSweep = now;
+        rfid.sweepOnce();
+        return;
+    }
+
+    if (!Buttons::instance().isIdle() || Buzzer::instance().isPlaying()) return;
+
+    uint32_t sleepMs = POWER_IDLE_SCAN_MS - sinceSweep;
+    if (maxSleepMs < sleepMs) sleepMs = maxSleepMs;
+    if (sleepMs < POWER_MIN_SLEEP_MS) return;
+
+    sleep(sleepMs);
+}
+
+void PowerManager::sleep(uint32_t ms) {
+    RFID::instance().powerDown();
+
+    SystemSleepConfiguration config;
+    config.mode(POWER_SLEEP_MODE)
+          .gpio(PN532_IRQ, FALLING)
+          .gpio(BUTTON_1_PIN, FALLING)
+          .gpio(BUTTON_2_PIN, FALLING)
+          .gpio(BUTTON_3_PIN, FALLING)
+          .gpio(BUTTON_4_PIN, FALLING)
+          .gpio(BATT_ALERT_PIN, FALLING)
+          .gpio(CHARGER_ACOK_PIN, CHANGE)
+          .gpio(EPD_BUSY, FALLING)
+          .duration(ms);
+    if (Particle.connected()) {
+        // Keep the cloud session; the radio stays in standby
+        config.network(NETWORK_INTERFACE_ALL, SystemSleepNetworkFlag::INACTIVE_STANDBY);
+    }
+
+    uint32_t start = millis();
+    SystemSleepResult result = System.sleep(config);
+    _sleepMs += millis() - start;
+    _sleeps++;
+
+    WakeSource source = WakeSource::Other;
+    if (result.wakeupReason() == SystemSleepWakeupReason::BY_RTC) {
+        source = WakeSource::Timer;
+    } else if (result.wakeupReason() == SystemSleepWakeupReason::BY_GPIO) {
+        pin_t pin = result.wakeupPin();
+        if (pin == PN532_IRQ) {
+            source = WakeSource::Rfid;
+        } else if (pin == BATT_ALERT_PIN) {
+            source = WakeSource::Battery;
+        } else if (pin == CHARGER_ACOK_PIN) {
+            source = WakeSource::Charger;
+        } else if (pin == EPD_BUSY) {
+            source = WakeSource::Display;
+        } else if (pin == BUTTON_1_PIN || pin == BUTTON_2_PIN ||
+                   pin == BUTTON_3_PIN || pin == BUTTON_4_PIN) {
+            source = WakeSource::Button;
+        }
+    }
+    _wakes[(int)source]++;
+
+    // The edge that woke the MCU never reached the button ISR
+    Buttons::instance().resync();
+    if (source == WakeSource::Rfid || source == WakeSource::Button) {
+        activity();
+    }
+}
+
+float PowerManager::getDutyCycle() const {
+    uint32_t elapsed = millis() - _statsSince;
+    if (elapsed == 0) return 100.0f;
+    return 100.0f * (elapsed - _sleepMs) / elapsed;
+}
+
+uint32_t PowerManager::getWakeCount(WakeSource source) const {
+    if (source >= WakeSource::Count) return 0;
+    return _wakes[(int)source];
+}
+
+void PowerManager::resetStats() {
+    _statsSince = millis();
+    _sleepMs = 0;
+    _sleeps = 0;
+    memset(_wakes, 0, sizeof(_wakes));
+}
+
+void PowerManager::printStats() {
+    Serial.printlnf("--- Power (%s) ---", _idle ? "idle" : "active");
+    Serial.printlnf("Awake %.1f%%, %lu sleeps (%lu ms)", getDutyCycle(),
+        (unsigned long)_sleeps, (unsigned long)_sleepMs);
+    Serial.printlnf("Wake: timer %lu  rfid %lu  button %lu  battery %lu  charger %lu  display %lu  other %lu",
+        (unsigned long)_wakes[(int)WakeSource::Timer],
+        (unsigned long)_wakes[(int)WakeSource::Rfid],
+        (unsigned long)_wakes[(int)WakeSource::Button],
+        (unsigned long)_wakes[(int)WakeSource::Battery],
+        (unsigned long)_wakes[(int)WakeSource::Charger],
+        (unsigned long)_wakes[(int)WakeSource::Display],
+        (unsigned long)_wakes[(int)WakeSource::Other]);
+    Serial.println("------------------");
+}
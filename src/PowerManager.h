@@ -0,0 +1,71 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include "Particle.h"
+
+// =====================================================
+// Idle duty cycling: once nothing has happened for
+// POWER_ACTIVE_HOLD_MS the antennas are swept every
+// POWER_IDLE_SCAN_MS and the MCU and PN532 sleep in between
+// =====================================================
+#define POWER_SLEEP_MODE        SystemSleepMode::ULTRA_LOW_POWER
+#define POWER_ACTIVE_HOLD_MS    10000  // Scan continuously after a card or button
+#define POWER_IDLE_SCAN_MS      300    // Worst-case card detection delay while idle
+#define POWER_MIN_SLEEP_MS      10     // Shorter gaps are not worth a sleep
+
+class PowerManager {
+public:
+    enum class WakeSource : uint8_t {
+        Timer,
+        Rfid,       // PN532 IRQ: external RF field
+        Button,
+        Battery,    // MAX17049 ALRT
+        Charger,    // ACOK: external power plugged or unplugged
+        Display,    // EPD BUSY released: refresh done
+        Other,
+        Count
+    };
+
+    static PowerManager& instance();
+
+    void begin();
+    void setEnabled(bool enable);
+    bool isEnabled() const { return _enabled; }
+
+    void activity();                   // Card read, button press: stay fully awake
+
+    // On external power there is no battery to save: never duty-cycle
+    void setExternalPower(bool present);
+    bool isIdle() const { return _idle; }
+
+    // Call at the end of loop(); sleeps at most maxSleepMs (time to the next
+    // scheduled task) when nothing else needs the MCU.
+    void idle(uint32_t maxSleepMs);
+
+    float getDutyCycle() const;        // % of time awake since resetStats()
+    uint32_t getSleepCount() const { return _sleeps; }
+    uint32_t getWakeCount(WakeSource source) const;
+    void resetStats();
+
+    // For debugging
+    void printStats();
+
+private:
+    PowerManager() = default;
+    void enterIdle();
+    void exitIdle();
+    void sleep(uint32_t ms);
+
+    bool _enabled = true;
+    bool _idle = false;
+    bool _externalPower = false;
+    uint32_t _lastActivity = 0;
+    uint32_t _lastSweep = 0;       // millis() of the last idle sweep
+
+    uint32_t _statsSince = 0;
+    uint32_t _sleepMs = 0;
+    uint32_t _sleeps = 0;
+    uint32_t _wakes[(int)WakeSource::Count] = {};
+};
+
+#endif
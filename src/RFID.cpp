@@ -1,4 +1,6 @@
 #include "RFID.h"
+#include "Perf.h"
+#include "I2CBus.h"
 
 // PE42412A-X Truth Table (LS=0)
 // Antenna:  V4 V3 V2 V1
@@ -16,6 +18,14 @@
 // RF12:      1  1  0  1
 // ALL OFF:   0  0  1  1
 
+// V1..V4 levels per antenna, bit0=V1 bit1=V2 bit2=V3 bit3=V4
+static const uint8_t ANTENNA_LINES[ANTENNA_COUNT + 1] = {
+    0x3,                            // ALL OFF
+    0x0, 0x8, 0x4, 0xC,             // RF1-RF4
+    0x2, 0xA, 0x6, 0xE,             // RF5-RF8
+    0x1, 0x9, 0x5, 0xD              // RF9-RF12
+};
+
 RFID& RFID::instance() {
     static RFID _instance;
     return _instance;
@@ -29,33 +39,12 @@ bool RFID::begin() {
     pinMode(RF_V4, OUTPUT);
     pinMode(PN532_RST, OUTPUT);
 
-    // Set antenna pins based on TEST_ANTENNA
-    int v1 = 0, v2 = 0, v3 = 0, v4 = 0;
-    switch (TEST_ANTENNA) {
-        case 1:  v1=0; v2=0; v3=0; v4=0; break;
-        case 2:  v1=0; v2=0; v3=0; v4=1; break;
-        case 3:  v1=0; v2=0; v3=1; v4=0; break;
-        case 4:  v1=0; v2=0; v3=1; v4=1; break;
-        case 5:  v1=0; v2=1; v3=0; v4=0; break;
-        case 6:  v1=0; v2=1; v3=0; v4=1; break;
-        case 7:  v1=0; v2=1; v3=1; v4=0; break;
-        case 8:  v1=0; v2=1; v3=1; v4=1; break;
-        case 9:  v1=1; v2=0; v3=0; v4=0; break;
-        case 10: v1=1; v2=0; v3=0; v4=1; break;
-        case 11: v1=1; v2=0; v3=1; v4=0; break;
-        case 12: v1=1; v2=0; v3=1; v4=1; break;
-        default: v1=1; v2=1; v3=0; v4=0; break; // ALL OFF
-    }
-
-    digitalWrite(RF_V1, v1);
-    digitalWrite(RF_V2, v2);
-    digitalWrite(RF_V3, v3);
-    digitalWrite(RF_V4, v4);
-
-    if (TEST_ANTENNA == 0) {
+    // Start on the first enabled antenna
+    setAntennaMask(ANTENNA_MASK);
+    if (_antennaMask == 0) {
         Serial.println("Antenna: ALL OFF");
     } else {
-        Serial.printlnf("Antenna %d: V1=%d V2=%d V3=%d V4=%d", TEST_ANTENNA, v1, v2, v3, v4);
+        Serial.printlnf("Antenna mask: 0x%03X, starting on RF%d", _antennaMask, _antenna);
     }
 
     // Reset PN532
@@ -64,8 +53,12 @@ bool RFID::begin() {
     digitalWrite(PN532_RST, HIGH);
     delay(50);
 
-    // Init PN532 (Wire.begin() called in main.cpp)
-    _nfc = new DFRobot_PN532_IIC(PN532_IRQ, 0);
+    // Init PN532 in IRQ mode on the shared bus (started in main.cpp). It has
+    // the highest priority: while IRQ is low a response is waiting and the
+    // other devices yield.
+    _nfc = new DFRobot_PN532_IIC(PN532_IRQ, 1);
+    I2CBus& bus = I2CBus::instance();
+    _nfc->setBus(bus.pn532Bus(bus.addDevice(I2C_ADDRESS, "PN532", I2CBus::Priority::High, PN532_IRQ)));
 
     if (!_nfc->begin()) {
         Serial.println("PN532 init FAILED");
@@ -73,17 +66,328 @@ bool RFID::begin() {
         return false;
     }
 
+    // Default is to retry forever; bound it so an empty field answers NbTg=0
+    if (!_nfc->setPassiveActivationRetries(PASSIVE_ACTIVATION_RETRIES)) {
+        Serial.println("PN532 RFConfiguration failed");
+    }
+
     Serial.println("PN532 OK - Scanning...");
     _initialized = true;
     return true;
 }
 
-bool RFID::scan(uint8_t* uid) {
+bool RFID::scan(Uid& uid) {
+    if (!_initialized) return false;
+    return _nfc->readUid(uid);
+}
+
+bool RFID::poll(Uid& uid, uint8_t* antenna) {
     if (!_initialized) return false;
+    Perf::Scope probe(Perf::PROBE_RFID);
 
-    if (_nfc->scan()) {
-        memcpy(uid, _nfc->nfcUid, 4);
+    // Hand out the remaining cards of the last RF cycle first
+    if (_targetNext < _targetCount) {
+        uid = _targets[_targetNext++].uid;
+        if (antenna) *antenna = _targetAntenna;
         return true;
     }
+
+    if (_antennaMask == 0) return false;
+
+    if (!_nfc->isBusy()) {
+        if (_paused) return false;
+
+        // selectAntenna() may have latched ALL OFF or a port outside the mask:
+        // move to an enabled antenna and let the switch settle on it first
+        if (_pendingAntenna == 0 || !(_antennaMask & (1 << (_pendingAntenna - 1)))) {
+            selectAntenna(nextAntenna(_pendingAntenna));
+            return false;
+        }
+
+        // Wait for the RF switch to settle on the antenna switched in early
+        if (micros() - _switchedAt < RF_SWITCH_SETTLE_US) return false;
+
+        _antenna = _pendingAntenna;
+        _nextSelected = false;
+
+        uint32_t nowMs = millis();
+        AntennaStats& st = _stats[_antenna - 1];
+        if (st.scans > 0 && nowMs - st.lastScan > st.maxRevisit) {
+            st.maxRevisit = nowMs - st.lastScan;
+        }
+        st.lastScan = nowMs;
+        st.scans++;
+        if (nowMs - _lastDecay >= ANTENNA_DECAY_MS) {
+            decayScores();
+            _lastDecay = nowMs;
+        }
+
+        if (_antenna == nextAntenna(0)) {
+            uint32_t now = micros();
+            if (_sweepStart != 0) {
+                _lastSweepUs = now - _sweepStart;
+                if (_lastSweepUs > _maxSweepUs) _maxSweepUs = _lastSweepUs;
+            }
+            _sweepStart = now;
+        }
+        // A sweep pauses once every enabled antenna has had its scan
+        bool sweeping = _sweepPending != 0;
+        _sweepPending &= ~(1 << (_antenna - 1));
+        startScan(sweeping);
+        if (sweeping && _sweepPending == 0) _paused = true;
+        return false;
+    }
+
+    // IRQ low while waiting for the response: the RF exchange on this antenna
+    // is over, so switch to the next one while the frame is read over I2C.
+    if (!_nextSelected &&
+        _nfc->getState() == DFRobot_PN532::eTransactionWaitResponse &&
+        digitalRead(PN532_IRQ) == LOW) {
+        selectAntenna(scheduleAntenna());
+        _nextSelected = true;
+    }
+
+    switch (_nfc->poll()) {
+        case DFRobot_PN532::eTransactionDone:
+            if (!_nextSelected) {
+                selectAntenna(scheduleAntenna());
+                _nextSelected = true;
+            }
+            _targetCount = _nfc->parseTargets(_targets, RFID_MAX_TARGETS);
+            _targetNext = 0;
+            _targetAntenna = _antenna;
+            if (_targetCount > 0) {
+                AntennaStats& st = _stats[_antenna - 1];
+                st.hits++;
+                st.score = st.score > 0xFFFF - ANTENNA_HIT_SCORE ? 0xFFFF : st.score + ANTENNA_HIT_SCORE;
+                uid = _targets[_targetNext++].uid;
+                if (antenna) *antenna = _antenna;
+                return true;
+            }
+            break;
+        case DFRobot_PN532::eTransactionTimeout:
+            Serial.printlnf("PN532 transaction timeout (RF%d)", _antenna);
+            selectAntenna(scheduleAntenna());
+            _nextSelected = true;
+            break;
+        case DFRobot_PN532::eTransactionError:
+            Serial.printlnf("PN532 transaction error (RF%d)", _antenna);
+            selectAntenna(scheduleAntenna());
+            _nextSelected = true;
+            break;
+        default:
+            break;
+    }
     return false;
 }
+
+bool RFID::startScan(bool sweeping) {
+    _endlessPoll = false;
+    if (_scanMode == ScanMode::AutoPoll) {
+        // With one antenna there is nothing to sweep: let the PN532 poll forever,
+        // unless this is a duty-cycled single sweep
+        _endlessPoll = nextAntenna(_antenna) == _antenna && !sweeping;
+        return _nfc->startAutoPoll(_endlessPoll ? 0xFF : AUTOPOLL_COUNT, AUTOPOLL_PERIOD);
+    }
+    return _nfc->startScan(RFID_MAX_TARGETS);
+}
+
+void RFID::abortScan() {
+    if (_initialized) {
+        _nfc->abortCommand();
+    }
+    _nextSelected = false;
+    _endlessPoll = false;
+}
+
+void RFID::pause() {
+    _paused = true;
+    _sweepPending = 0;
+    // An endless InAutoPoll would never let the reader go idle
+    if (_endlessPoll && _nfc->isBusy()) abortScan();
+}
+
+void RFID::resume() {
+    _paused = false;
+    _sweepPending = 0;
+}
+
+void RFID::sweepOnce() {
+    if (_antennaMask == 0) return;
+    _paused = false;
+    _sweepPending = _antennaMask;
+}
+
+bool RFID::isIdle() const {
+    if (!_initialized) return true;
+    return _paused && !_nfc->isBusy() && _targetNext >= _targetCount;
+}
+
+bool RFID::powerDown() {
+    if (!_initialized || _nfc->isBusy()) return false;
+    if (_nfc->isPoweredDown()) return true;
+    return _nfc->powerDown(PN532_SLEEP_WAKEUP);
+}
+
+void RFID::setScanMode(ScanMode mode) {
+    if (mode == _scanMode) return;
+    abortScan();
+    _scanMode = mode;
+}
+
+uint8_t RFID::getTargets(DFRobot_PN532::sTarget_t* targets, uint8_t maxTargets) const {
+    uint8_t count = _targetCount < maxTargets ? _targetCount : maxTargets;
+    memcpy(targets, _targets, count * sizeof(DFRobot_PN532::sTarget_t));
+    return count;
+}
+
+bool RFID::isBusy() const {
+    return _initialized && _nfc->isBusy();
+}
+
+uint32_t RFID::getLastLatency() const {
+    return _initialized ? _nfc->getLastLatency() : 0;
+}
+
+void RFID::setAntennaMask(uint16_t mask) {
+    abortScan();
+    _antennaMask = mask & ((1 << ANTENNA_COUNT) - 1);
+    if (_sweepPending) {
+        // Antennas dropped from the mask no longer hold the sweep open
+        _sweepPending &= _antennaMask;
+        if (_sweepPending == 0) _paused = true;
+    }
+    _sweepStart = 0;
+
+    uint8_t count = 0;
+    for (uint8_t a = 1; a <= ANTENNA_COUNT; a++) {
+        if (_antennaMask & (1 << (a - 1))) count++;
+    }
+    uint32_t rounds = (uint32_t)count * ANTENNA_SCAN_MS * ANTENNA_REVISIT_SLACK;
+    _revisitMs = rounds > ANTENNA_REVISIT_MS ? rounds : ANTENNA_REVISIT_MS;
+    if (_revisitMs > ANTENNA_REVISIT_MS) {
+        Serial.printlnf("Antenna revisit stretched to %lu ms for %d ports",
+            (unsigned long)_revisitMs, count);
+    }
+    uint8_t first = nextAntenna(0);
+    _antenna = first;
+    selectAntenna(first);
+}
+
+void RFID::selectAntenna(uint8_t antenna) {
+    if (antenna > ANTENNA_COUNT) antenna = 0;
+
+    uint8_t lines = ANTENNA_LINES[antenna];
+    digitalWrite(RF_V1, (lines >> 0) & 1);
+    digitalWrite(RF_V2, (lines >> 1) & 1);
+    digitalWrite(RF_V3, (lines >> 2) & 1);
+    digitalWrite(RF_V4, (lines >> 3) & 1);
+
+    _pendingAntenna = antenna;
+    _switchedAt = micros();
+}
+
+uint8_t RFID::nextAntenna(uint8_t antenna) const {
+    // Next enabled antenna after 'antenna' (wrapping), 0 if none are enabled
+    for (uint8_t i = 1; i <= ANTENNA_COUNT; i++) {
+        uint8_t candidate = (antenna + i - 1) % ANTENNA_COUNT + 1;
+        if (_antennaMask & (1 << (candidate - 1))) return candidate;
+    }
+    return 0;
+}
+
+uint8_t RFID::scheduleAntenna() {
+    // A sweep visits the antennas it has not scanned yet, in order
+    if (_sweepPending) {
+        for (uint8_t i = 1; i <= ANTENNA_COUNT; i++) {
+            uint8_t candidate = (_antenna + i - 1) % ANTENNA_COUNT + 1;
+            if (_sweepPending & (1 << (candidate - 1))) return candidate;
+        }
+    }
+    if (!_adaptive) return nextAntenna(_antenna);
+
+    // Cold antennas past their revisit deadline go first, most overdue wins
+    uint32_t now = millis();
+    uint8_t best = 0;
+    uint32_t bestAge = 0;
+    _slots++;
+    for (uint8_t a = 1; a <= ANTENNA_COUNT; a++) {
+        if (!(_antennaMask & (1 << (a - 1)))) continue;
+        uint32_t age = now - _stats[a - 1].lastScan;
+        if (age >= _revisitMs && age > bestAge) {
+            best = a;
+            bestAge = age;
+        }
+    }
+    if (best) {
+        _overdueSlots++;
+        return best;
+    }
+
+    // Otherwise smooth weighted round-robin: each antenna earns its weight in
+    // credit, the richest one is scanned and pays back the total.
+    int16_t total = 0;
+    for (uint8_t a = 1; a <= ANTENNA_COUNT; a++) {
+        if (!(_antennaMask & (1 << (a - 1)))) continue;
+        uint8_t weight = getAntennaWeight(a);
+        _stats[a - 1].credit += weight;
+        total += weight;
+        if (!best || _stats[a - 1].credit > _stats[best - 1].credit) best = a;
+    }
+    if (best) _stats[best - 1].credit -= total;
+    return best;
+}
+
+void RFID::decayScores() {
+    for (uint8_t i = 0; i < ANTENNA_COUNT; i++) {
+        _stats[i].score >>= 1;
+    }
+}
+
+uint8_t RFID::getAntennaWeight(uint8_t antenna) const {
+    if (antenna < 1 || antenna > ANTENNA_COUNT) return 0;
+    uint32_t weight = 1 + _stats[antenna - 1].score / ANTENNA_HIT_SCORE;
+    return weight > ANTENNA_MAX_WEIGHT ? ANTENNA_MAX_WEIGHT : weight;
+}
+
+uint32_t RFID::getAntennaHits(uint8_t antenna) const {
+    if (antenna < 1 || antenna > ANTENNA_COUNT) return 0;
+    return _stats[antenna - 1].hits;
+}
+
+uint32_t RFID::getAntennaScans(uint8_t antenna) const {
+    if (antenna < 1 || antenna > ANTENNA_COUNT) return 0;
+    return _stats[antenna - 1].scans;
+}
+
+uint32_t RFID::getMaxRevisit(uint8_t antenna) const {
+    if (antenna < 1 || antenna > ANTENNA_COUNT) return 0;
+    return _stats[antenna - 1].maxRevisit;
+}
+
+void RFID::resetAntennaStats() {
+    memset(_stats, 0, sizeof(_stats));
+    _maxSweepUs = 0;
+    _slots = 0;
+    _overdueSlots = 0;
+}
+
+void RFID::printAntennaStats() {
+    Serial.printlnf("--- Antenna schedule (%s) ---", _adaptive ? "adaptive" : "round-robin");
+    for (uint8_t a = 1; a <= ANTENNA_COUNT; a++) {
+        if (!(_antennaMask & (1 << (a - 1)))) continue;
+        const AntennaStats& st = _stats[a - 1];
+        Serial.printlnf("RF%-2d weight %d  hits %6lu  scans %8lu  max revisit %4lu ms",
+            a, getAntennaWeight(a), (unsigned long)st.hits, (unsigned long)st.scans,
+            (unsigned long)st.maxRevisit);
+    }
+    if (_adaptive && _slots > 0) {
+        uint32_t overdue = (uint32_t)((uint64_t)_overdueSlots * 100 / _slots);
+        Serial.printlnf("Revisit %lu ms, deadline took %lu%% of slots",
+            (unsigned long)_revisitMs, (unsigned long)overdue);
+        if (overdue >= 90) {
+            Serial.println("Revisit deadline drives the schedule: adaptive fell back to round-robin");
+        }
+    }
+    Serial.println("------------------------------");
+}
@@ -13,22 +13,146 @@
 #define PN532_RST   A2
 
 // =====================================================
-// CHANGE THIS TO TEST DIFFERENT ANTENNAS (1-12)
+// Antennas swept at runtime: bit n-1 enables RFn (1-12)
 // Set to 0 for ALL OFF (no antenna)
 // =====================================================
-#define TEST_ANTENNA  0
+#define ANTENNA_MASK  0x0FFF
+
+#define ANTENNA_COUNT           12
+#define RF_SWITCH_SETTLE_US     20   // PE42412A switching + RF field settling
+
+// Adaptive scheduling: hot antennas get up to ANTENNA_MAX_WEIGHT scan slots
+// per slot of a cold one; every antenna is revisited within ANTENNA_REVISIT_MS.
+// With many ports one cold round alone fills that window and the deadline
+// would force plain round-robin, so it stretches to ANTENNA_REVISIT_SLACK
+// cold rounds of ANTENNA_SCAN_MS per enabled port.
+#define ANTENNA_MAX_WEIGHT      8
+#define ANTENNA_REVISIT_MS      250
+#define ANTENNA_SCAN_MS         12     // Empty-field scan, I2C frames included
+#define ANTENNA_REVISIT_SLACK   2
+#define ANTENNA_DECAY_MS        10000  // Hit score halves every period
+#define ANTENNA_HIT_SCORE       64     // Score added per card read
+
+// InListPassiveTarget retries before the PN532 answers "no target"
+#define PASSIVE_ACTIVATION_RETRIES  0x02
+
+// Cards enumerated per RF cycle (InListPassiveTarget MaxTg, at most 2)
+#define RFID_MAX_TARGETS        PN532_MAX_TARGETS
+
+// InAutoPoll mode: rounds per antenna when sweeping (endless with a single
+// antenna enabled) and pause between rounds in units of 150 ms
+#define AUTOPOLL_COUNT          1
+#define AUTOPOLL_PERIOD         1
+
+// PN532 Power Down wake-up sources: host I2C access or an external reader's field
+#define PN532_SLEEP_WAKEUP      (PN532_WAKEUP_I2C | PN532_WAKEUP_RF)
+
+// Card UID with its length (4, 7 or 10 bytes), no heap involved
+typedef DFRobot_PN532::sUid_t Uid;
 
 class RFID {
 public:
+    enum class ScanMode {
+        ListPassive,   // Host issues InListPassiveTarget for every scan
+        AutoPoll       // PN532 polls on its own, IRQ only on detection
+    };
+
     static RFID& instance();
 
     bool begin();
-    bool scan(uint8_t* uid);
+    bool scan(Uid& uid);          // Blocking scan (waits for the PN532 response)
+
+    // Non-blocking scan: submits a scan when idle and completes from the
+    // PN532 IRQ. Sweeps the enabled antennas; returns true once per card read,
+    // with the antenna (1-12) that saw it. Cards found together in one RF
+    // cycle are returned on consecutive calls.
+    bool poll(Uid& uid, uint8_t* antenna = nullptr);
+    bool isBusy() const;
+    uint32_t getLastLatency() const;  // Last transaction, us
+
+    void setScanMode(ScanMode mode);
+    ScanMode getScanMode() const { return _scanMode; }
+
+    // Duty cycling: pause() lets the in-flight scan finish (an endless
+    // InAutoPoll is aborted) and starts no new ones; sweepOnce() scans every
+    // enabled antenna once, then pauses.
+    void pause();
+    void resume();
+    void sweepOnce();
+    bool isPaused() const { return _paused; }
+    bool isIdle() const;          // Paused, nothing in flight or left to hand out
+    bool powerDown();             // PN532 Power Down until the next scan
+
+    // Every target seen by the last completed scan
+    uint8_t getTargets(DFRobot_PN532::sTarget_t* targets, uint8_t maxTargets) const;
+
+    // Antenna selection (PE42412A RF1-RF12)
+    void setAntennaMask(uint16_t mask);
+    uint16_t getAntennaMask() const { return _antennaMask; }
+    void selectAntenna(uint8_t antenna);  // 1-12, 0 = ALL OFF
+    uint8_t getAntenna() const { return _antenna; }
+
+    // Full sweep of all enabled antennas, us
+    uint32_t getLastSweepTime() const { return _lastSweepUs; }
+    uint32_t getMaxSweepTime() const { return _maxSweepUs; }
+
+    // Adaptive scheduling: dwell on antennas where cards appear
+    void setAdaptive(bool enable) { _adaptive = enable; }
+    bool isAdaptive() const { return _adaptive; }
+    uint8_t getAntennaWeight(uint8_t antenna) const;  // Scan slots per round
+    uint32_t getAntennaHits(uint8_t antenna) const;
+    uint32_t getAntennaScans(uint8_t antenna) const;
+    uint32_t getMaxRevisit(uint8_t antenna) const;    // Worst gap between scans, ms
+    uint32_t getRevisitInterval() const { return _revisitMs; }  // For the enabled ports, ms
+    void resetAntennaStats();
+
+    // For debugging
+    void printAntennaStats();
 
 private:
+    struct AntennaStats {
+        uint32_t hits;
+        uint32_t scans;
+        uint16_t score;        // Decayed hit score
+        int16_t credit;        // Weighted round-robin credit
+        uint32_t lastScan;     // millis() of the last scan start
+        uint32_t maxRevisit;   // ms
+    };
+
     RFID() = default;
+    uint8_t nextAntenna(uint8_t antenna) const;
+    uint8_t scheduleAntenna();
+    void decayScores();
+    bool startScan(bool sweeping);
+    void abortScan();
+
     DFRobot_PN532_IIC* _nfc = nullptr;
     bool _initialized = false;
+
+    uint16_t _antennaMask = ANTENNA_MASK;
+    uint8_t _antenna = 0;          // Antenna the in-flight scan runs on
+    uint8_t _pendingAntenna = 0;   // Antenna already switched in for the next scan
+    uint32_t _switchedAt = 0;      // micros() of the last GPIO switch
+    uint32_t _sweepStart = 0;
+    uint32_t _lastSweepUs = 0;
+    uint32_t _maxSweepUs = 0;
+    bool _nextSelected = false;    // Next antenna chosen for the in-flight scan
+    bool _paused = false;
+    uint16_t _sweepPending = 0;    // Antennas sweepOnce() has still to scan
+    bool _endlessPoll = false;     // In-flight InAutoPoll only ends on a card
+
+    ScanMode _scanMode = ScanMode::ListPassive;
+    DFRobot_PN532::sTarget_t _targets[RFID_MAX_TARGETS] = {};
+    uint8_t _targetCount = 0;
+    uint8_t _targetNext = 0;       // Next target poll() hands out
+    uint8_t _targetAntenna = 0;
+
+    bool _adaptive = true;
+    uint32_t _revisitMs = ANTENNA_REVISIT_MS;
+    uint32_t _slots = 0;           // Scheduling decisions since the last stats reset
+    uint32_t _overdueSlots = 0;    // ...taken by the revisit deadline
+    AntennaStats _stats[ANTENNA_COUNT] = {};
+    uint32_t _lastDecay = 0;
 };
 
 #endif
@@ -0,0 +1,147 @@
+#include "Scheduler.h"
+
+Scheduler& Scheduler::instance() {
+    static Scheduler _instance;
+    return _instance;
+}
+
+int Scheduler::addPeriodic(const char* name, TaskFn fn, uint32_t periodMs, uint32_t delayMs) {
+    return addTask(name, fn, periodMs, delayMs);
+}
+
+int Scheduler::addOneShot(const char* name, TaskFn fn, uint32_t delayMs) {
+    // A one-shot is a task without a period that disarms after running
+    int id = addTask(name, fn, 0, delayMs);
+    if (id >= 0) _tasks[id].periodMs = UINT32_MAX;
+    return id;
+}
+
+int Scheduler::addTask(const char* name, TaskFn fn, uint32_t periodMs, uint32_t delayMs) {
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        // A slot freed by its own task is reused only once that task returns
+        if (!_tasks[i].active && !_tasks[i].running) {
+            Task& t = _tasks[i];
+            t = Task();
+            t.name = name;
+            t.fn = fn;
+            t.periodMs = periodMs;
+            t.due = millis() + delayMs;
+            t.active = true;
+            t.pending = true;
+            return i;
+        }
+    }
+    Serial.printlnf("Scheduler full, task %s dropped", name);
+    return -1;
+}
+
+void Scheduler::cancel(int id) {
+    if (id < 0 || id >= SCHEDULER_MAX_TASKS) return;
+    _tasks[id].pending = false;
+    _tasks[id].active = false;
+}
+
+void Scheduler::trigger(int id, uint32_t delayMs) {
+    if (id < 0 || id >= SCHEDULER_MAX_TASKS || !_tasks[id].active) return;
+    _tasks[id].due = millis() + delayMs;
+    _tasks[id].pending = true;
+}
+
+void Scheduler::setPeriod(int id, uint32_t periodMs) {
+    if (id < 0 || id >= SCHEDULER_MAX_TASKS || !_tasks[id].active) return;
+    _tasks[id].periodMs = periodMs;
+}
+
+bool Scheduler::isPending(int id) const {
+    if (id < 0 || id >= SCHEDULER_MAX_TASKS) return false;
+    return _tasks[id].active && _tasks[id].pending;
+}
+
+void Scheduler::run() {
+    // Each due task runs at most once per pass so none can starve the others
+    uint32_t ran = 0;
+    for (;;) {
+        uint32_t now = millis();
+        int next = -1;
+        int32_t mostLate = INT32_MIN;
+        for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+            const Task& t = _tasks[i];
+            if (!t.active || !t.pending || t.running || (ran & (1UL << i))) continue;
+            int32_t late = (int32_t)(now - t.due);
+            if (late >= 0 && late > mostLate) {
+                mostLate = late;
+                next = i;
+            }
+        }
+        if (next < 0) return;
+
+        Task& t = _tasks[next];
+        ran |= 1UL << next;
+        if ((uint32_t)mostLate > t.stats.maxLatencyMs) t.stats.maxLatencyMs = mostLate;
+
+        // Rearm before running so the task may cancel or retrigger itself
+        if (t.periodMs == UINT32_MAX) {
+            t.pending = false;
+        } else {
+            t.due += t.periodMs;
+            // Fell more than a period behind: restart the cadence instead of bursting
+            if ((int32_t)(now - t.due) >= 0) t.due = now + t.periodMs;
+        }
+
+        uint32_t start = micros();
+        t.running = true;
+        t.fn();
+        t.running = false;
+        uint32_t runUs = micros() - start;
+
+        t.stats.runs++;
+        t.stats.totalUs += runUs;
+        if (runUs > t.stats.maxRunUs) t.stats.maxRunUs = runUs;
+
+        // A completed one-shot frees its slot unless it retriggered itself
+        if (t.periodMs == UINT32_MAX && !t.pending) t.active = false;
+    }
+}
+
+uint32_t Scheduler::msUntilNext() const {
+    uint32_t now = millis();
+    uint32_t best = UINT32_MAX;
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        const Task& t = _tasks[i];
+        if (!t.active || !t.pending || t.periodMs == 0) continue;
+        int32_t wait = (int32_t)(t.due - now);
+        if (wait <= 0) return 0;
+        if ((uint32_t)wait < best) best = wait;
+    }
+    return best;
+}
+
+const Scheduler::TaskStats* Scheduler::getStats(int id) const {
+    if (id < 0 || id >= SCHEDULER_MAX_TASKS || !_tasks[id].active) return nullptr;
+    return &_tasks[id].stats;
+}
+
+void Scheduler::resetStats() {
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        _tasks[i].stats = TaskStats();
+    }
+    _statsSince = millis();
+}
+
+void Scheduler::printStats() {
+    uint32_t elapsedMs = millis() - _statsSince;
+    if (elapsedMs == 0) elapsedMs = 1;
+
+    Serial.printlnf("--- Scheduler (%lu ms) ---", (unsigned long)elapsedMs);
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        const Task& t = _tasks[i];
+        if (!t.active) continue;
+        const TaskStats& st = t.stats;
+        Serial.printlnf("%-10s runs=%-7lu mean=%6lu us  max=%7lu us  late<=%5lu ms  cpu=%5.2f%%",
+            t.name, (unsigned long)st.runs,
+            (unsigned long)(st.runs ? st.totalUs / st.runs : 0),
+            (unsigned long)st.maxRunUs, (unsigned long)st.maxLatencyMs,
+            st.totalUs / (elapsedMs * 10.0f));
+    }
+    Serial.println("--------------------------");
+}
@@ -0,0 +1,68 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Particle.h"
+
+#define SCHEDULER_MAX_TASKS  12
+
+// =====================================================
+// Deadline-based cooperative scheduler. Tasks are plain
+// functions that must return quickly; run() from loop()
+// starts every due task once, earliest deadline first.
+// =====================================================
+
+class Scheduler {
+public:
+    typedef void (*TaskFn)();
+
+    struct TaskStats {
+        uint32_t runs;
+        uint64_t totalUs;       // Time spent inside the task
+        uint32_t maxRunUs;
+        uint32_t maxLatencyMs;  // Worst start time past the deadline
+    };
+
+    static Scheduler& instance();
+
+    // Returns a task id, or -1 if the task table is full.
+    // periodMs 0 runs the task on every pass.
+    int addPeriodic(const char* name, TaskFn fn, uint32_t periodMs, uint32_t delayMs = 0);
+    // A one-shot's slot and id are released once it has run.
+    int addOneShot(const char* name, TaskFn fn, uint32_t delayMs);
+
+    void cancel(int id);        // Removes the task; its id becomes invalid
+    void trigger(int id, uint32_t delayMs = 0);  // (Re)arm a task
+    void setPeriod(int id, uint32_t periodMs);
+    bool isPending(int id) const;
+
+    void run();                 // Call from loop(); may nest from a task's wait loop
+    // Time to the next deadline, 0 if a task is due. Tasks with period 0 run
+    // on every pass while awake but do not hold off sleep.
+    uint32_t msUntilNext() const;
+
+    const TaskStats* getStats(int id) const;
+    void resetStats();
+
+    // For debugging
+    void printStats();
+
+private:
+    struct Task {
+        const char* name;
+        TaskFn fn;
+        uint32_t periodMs;
+        uint32_t due;           // millis() deadline
+        bool active;            // Slot in use
+        bool pending;           // Armed
+        bool running;           // Inside fn, skipped by nested run() passes
+        TaskStats stats;
+    };
+
+    Scheduler() = default;
+    int addTask(const char* name, TaskFn fn, uint32_t periodMs, uint32_t delayMs);
+
+    Task _tasks[SCHEDULER_MAX_TASKS] = {};
+    uint32_t _statsSince = 0;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "SocEstimator.h"
+
+#define Q16_ONE          65536
+#define SOC_FULL         (100 * Q16_ONE)
+#define MS_PER_HOUR      3600000
+#define MAX_DT_MS        (10 * 60 * 1000)  // Longer gaps (sleep) restart the filter
+
+// VCELL is 156.25 uV per LSB
+#define SOC_EMPTY_VCELL  ((uint16_t)(SOC_EMPTY_MV * 32 / 5))
+
+SocEstimator& SocEstimator::instance() {
+    static SocEstimator _instance;
+    return _instance;
+}
+
+void SocEstimator::reset() {
+    _valid = false;
+    _maxUpdateUs = 0;
+}
+
+void SocEstimator::update(const Battery::Snapshot& snapshot, ChargeState state) {
+    if (snapshot.timestamp == 0) return;
+    uint32_t start = micros();
+
+    // Measurements: SOC register is 1/256 % per LSB, CRATE 0.208 %/h per LSB
+    int32_t z = (int32_t)snapshot.soc << 8;
+    if (z > SOC_FULL) z = SOC_FULL;
+    if (snapshot.vcell < SOC_EMPTY_VCELL) z = 0;  // Past the knee the model is too optimistic
+    if (state == ChargeState::Full) z = SOC_FULL;
+    int32_t crate = (int32_t)(int16_t)snapshot.crate * 13632;
+
+    uint32_t dt = snapshot.timestamp - _lastMs;
+    if (!_valid || dt > MAX_DT_MS) {
+        _soc = z;
+        _rate = crate;
+    } else if (dt > 0) {
+        if (state != _state) {
+            // Rate is discontinuous when the charger switches
+            _rate = crate;
+        }
+
+        int32_t predicted = _soc + (int32_t)((int64_t)_rate * dt / MS_PER_HOUR);
+        int32_t residual = z - predicted;
+        _soc = predicted + (residual >> SOC_ALPHA_SHIFT);
+        _rate += (int32_t)(((int64_t)residual * MS_PER_HOUR / dt) >> SOC_BETA_SHIFT);
+        _rate += (crate - _rate) >> SOC_GAMMA_SHIFT;
+    }
+
+    // The charger state fixes the sign of the rate
+    switch (state) {
+        case ChargeState::Discharging:
+            if (_rate > 0) _rate = 0;
+            break;
+        case ChargeState::Charging:
+            if (_rate < 0) _rate = 0;
+            break;
+        case ChargeState::Full:
+            _rate = 0;
+            break;
+    }
+    if (_soc < 0) _soc = 0;
+    if (_soc > SOC_FULL) _soc = SOC_FULL;
+
+    _state = state;
+    _lastMs = snapshot.timestamp;
+    _valid = true;
+
+    _lastUpdateUs = micros() - start;
+    if (_lastUpdateUs > _maxUpdateUs) _maxUpdateUs = _lastUpdateUs;
+}
+
+float SocEstimator::getSoC() const {
+    return _soc / (float)Q16_ONE;
+}
+
+float SocEstimator::getRate() const {
+    return _rate / (float)Q16_ONE;
+}
+
+uint32_t SocEstimator::getMinutesToEmpty() const {
+    if (!_valid || _rate > -SOC_MIN_RATE) return UINT32_MAX;
+    return (uint32_t)((int64_t)_soc * 60 / -_rate);
+}
+
+uint32_t SocEstimator::getMinutesToFull() const {
+    if (!_valid || _rate < SOC_MIN_RATE) return UINT32_MAX;
+    return (uint32_t)((int64_t)(SOC_FULL - _soc) * 60 / _rate);
+}
+
+void SocEstimator::print() {
+    static const char* const states[] = {"discharging", "charging", "full"};
+    Serial.printlnf("--- SoC estimator (%s) ---", states[(int)_state]);
+    Serial.printlnf("SoC %.2f%%, rate %.2f%%/h", getSoC(), getRate());
+    uint32_t tte = getMinutesToEmpty();
+    uint32_t ttf = getMinutesToFull();
+    if (tte != UINT32_MAX) Serial.printlnf("Time to empty: %lu min", (unsigned long)tte);
+    if (ttf != UINT32_MAX) Serial.printlnf("Time to full: %lu min", (unsigned long)ttf);
+    Serial.printlnf("Update %lu us (max %lu us, budget %d us)", (unsigned long)_lastUpdateUs,
+        (unsigned long)_maxUpdateUs, SOC_UPDATE_BUDGET_US);
+    Serial.println("---------------------------");
+}
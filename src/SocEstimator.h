@@ -0,0 +1,57 @@
+#ifndef SOC_ESTIMATOR_H
+#define SOC_ESTIMATOR_H
+
+#include "Particle.h"
+#include "Battery.h"
+
+// =====================================================
+// Fixed-point alpha-beta filter over the MAX17049 SOC,
+// with CRATE as a second measurement of the rate and the
+// charger state constraining its sign. Q16 throughout,
+// no floats or heap in update().
+// =====================================================
+#define SOC_ALPHA_SHIFT     3       // SOC correction gain 1/8
+#define SOC_BETA_SHIFT      8       // Rate correction from the SOC residual, 1/256
+#define SOC_GAMMA_SHIFT     2       // Rate pull towards CRATE, 1/4
+#define SOC_EMPTY_MV        6000    // 2S pack at 3.0 V/cell: treat as empty
+#define SOC_MIN_RATE        (65536 / 20)  // 0.05 %/h, slower counts as idle (Q16)
+#define SOC_UPDATE_BUDGET_US  100
+
+class SocEstimator {
+public:
+    enum class ChargeState : uint8_t {
+        Discharging,
+        Charging,
+        Full
+    };
+
+    static SocEstimator& instance();
+
+    void reset();
+    void update(const Battery::Snapshot& snapshot, ChargeState state);
+
+    bool isValid() const { return _valid; }
+    float getSoC() const;              // Smoothed, %
+    float getRate() const;             // %/h, negative when discharging
+    uint32_t getMinutesToEmpty() const;  // UINT32_MAX if not discharging
+    uint32_t getMinutesToFull() const;   // UINT32_MAX if not charging
+
+    uint32_t getLastUpdateUs() const { return _lastUpdateUs; }
+    uint32_t getMaxUpdateUs() const { return _maxUpdateUs; }
+
+    // For debugging
+    void print();
+
+private:
+    SocEstimator() = default;
+
+    bool _valid = false;
+    ChargeState _state = ChargeState::Discharging;
+    int32_t _soc = 0;       // % in Q16
+    int32_t _rate = 0;      // %/h in Q16
+    uint32_t _lastMs = 0;
+    uint32_t _lastUpdateUs = 0;
+    uint32_t _maxUpdateUs = 0;
+};
+
+#endif
@@ -0,0 +1,353 @@
+#include "Telemetry.h"
+
+#define TELEMETRY_MAGIC  0x544C4D31  // "TLM1"
+#define MAX_RECORD_SIZE  16          // Largest keyframe or delta record
+
+// Survives resets (not power loss); validated by magic and length
+struct TelemetryLog {
+    uint32_t magic;
+    uint16_t length;       // Bytes used in data
+    uint16_t samples;
+    uint32_t dropped;
+    bool synced;           // Times are Unix time
+    Telemetry::State lastState;
+    uint32_t lastTime;     // Last sample, absolute, for the next delta
+    uint16_t lastSoc;
+    uint16_t lastVcell;
+    int16_t lastCrate;
+    uint8_t data[TELEMETRY_BUFFER_SIZE];
+};
+
+retained static TelemetryLog _log;
+retained static TelemetryLog _earlier;  // Unsynced log of an earlier boot, waiting for the cloud
+
+static bool isValid(const TelemetryLog& log) {
+    return log.magic == TELEMETRY_MAGIC && log.length <= TELEMETRY_BUFFER_SIZE &&
+        (log.length == 0) == (log.samples == 0);
+}
+
+static uint8_t putVarint(uint32_t value, uint8_t* out) {
+    uint8_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static uint8_t getVarint(const uint8_t* in, uint32_t& value) {
+    uint8_t n = 0;
+    value = 0;
+    do {
+        value |= (uint32_t)(in[n] & 0x7F) << (7 * n);
+    } while (in[n++] & 0x80 && n < 5);
+    return n;
+}
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+Telemetry& Telemetry::instance() {
+    static Telemetry _instance;
+    return _instance;
+}
+
+void Telemetry::begin() {
+    if (!isValid(_earlier)) {
+        _earlier.magic = TELEMETRY_MAGIC;
+        _earlier.length = 0;
+        _earlier.samples = 0;
+    }
+    if (!isValid(_log)) {
+        reset();
+        _log.dropped = 0;
+        return;
+    }
+    if (_log.samples == 0) return;
+
+    Serial.printlnf("Telemetry: recovered %u samples (%u bytes)", _log.samples, _log.length);
+    if (!_log.synced) {
+        // Seconds since an earlier boot cannot be continued: keep that log
+        // apart until the cloud takes it. Only the newest one is kept.
+        if (_earlier.samples > 0) _log.dropped += _earlier.samples;
+        memcpy(&_earlier, &_log, sizeof(_earlier));
+        reset();
+        return;
+    }
+    // Age of the recovered samples is unknown, upload them at the first chance
+    _oldestMillis = millis() - TELEMETRY_FLUSH_MS;
+}
+
+void Telemetry::reset() {
+    _log.magic = TELEMETRY_MAGIC;
+    _log.length = 0;
+    _log.samples = 0;
+    if (!_publishingEarlier) _publishedSamples = 0;
+}
+
+uint32_t Telemetry::now() const {
+    return Time.isValid() ? (uint32_t)Time.now() : millis() / 1000;
+}
+
+void Telemetry::record(const Battery::Snapshot& snapshot, uint8_t state) {
+    if (snapshot.timestamp == 0) return;
+
+    // Samples of this boot move to Unix time once the clock syncs
+    if (_log.samples > 0 && !_log.synced && Time.isValid() &&
+        !rebase((uint32_t)Time.now() - millis() / 1000)) {
+        _log.dropped += _log.samples;
+        reset();
+    }
+
+    Sample s;
+    s.time = now();
+    s.soc = snapshot.soc;
+    s.vcell = snapshot.vcell;
+    s.crate = (int16_t)snapshot.crate;
+    s.state = state & 0x07;
+
+    if (_log.samples > 0 && s.soc == _log.lastSoc && s.vcell == _log.lastVcell &&
+        s.crate == _log.lastCrate && s.state == _log.lastState &&
+        s.time - _log.lastTime < TELEMETRY_HEARTBEAT_S) {
+        return;
+    }
+
+    while (!append(s)) {
+        if (!dropOldest()) {
+            reset();
+        }
+        _log.dropped++;
+    }
+}
+
+bool Telemetry::append(const Sample& s) {
+    uint8_t record[MAX_RECORD_SIZE];
+    uint16_t len;
+    bool synced = Time.isValid();
+    if (_log.samples == 0) {
+        record[0] = TELEMETRY_FORMAT | (synced ? 0 : TELEMETRY_UNSYNCED);
+        len = 1 + encodeKeyframe(s, record + 1);
+    } else {
+        Sample prev = {_log.lastTime, _log.lastSoc, _log.lastVcell, _log.lastCrate, _log.lastState};
+        len = encodeDelta(s, prev, record);
+    }
+    if (_log.length + len > TELEMETRY_BUFFER_SIZE) return false;
+
+    if (_log.samples == 0) {
+        _oldestMillis = millis();
+        _log.synced = synced;
+    }
+    memcpy(_log.data + _log.length, record, len);
+    _log.length += len;
+    _log.samples++;
+    _log.lastTime = s.time;
+    _log.lastSoc = s.soc;
+    _log.lastVcell = s.vcell;
+    _log.lastCrate = s.crate;
+    _log.lastState = (State)s.state;
+    return true;
+}
+
+bool Telemetry::dropOldest() {
+    // The second sample becomes the new keyframe
+    if (_log.samples < 2) return false;
+
+    Sample first, second;
+    uint16_t pos = 1;
+    pos += decodeKeyframe(_log.data + pos, first);
+    pos += decodeDelta(_log.data + pos, first, second);
+
+    uint8_t head[1 + MAX_RECORD_SIZE];
+    head[0] = _log.data[0];
+    uint16_t headLen = 1 + encodeKeyframe(second, head + 1);
+    if (headLen > pos) return false;  // Cannot happen: a keyframe is smaller than two records
+
+    uint16_t rest = _log.length - pos;
+    memmove(_log.data + headLen, _log.data + pos, rest);
+    memcpy(_log.data, head, headLen);
+    _log.length = headLen + rest;
+    _log.samples--;
+    // A sample the in-flight event carries is gone already
+    if (!_publishingEarlier && _publishedSamples > 0) _publishedSamples--;
+    return true;
+}
+
+bool Telemetry::rebase(uint32_t offset) {
+    // Move the keyframe from seconds since boot to Unix time; deltas are unchanged
+    for (;;) {
+        if (_log.samples == 0) return false;
+        Sample first;
+        uint16_t oldLen = decodeKeyframe(_log.data + 1, first);
+        first.time += offset;
+        uint8_t keyframe[MAX_RECORD_SIZE];
+        uint16_t newLen = encodeKeyframe(first, keyframe);
+        if (_log.length - oldLen + newLen <= TELEMETRY_BUFFER_SIZE) {
+            memmove(_log.data + 1 + newLen, _log.data + 1 + oldLen, _log.length - 1 - oldLen);
+            memcpy(_log.data + 1, keyframe, newLen);
+            _log.data[0] = TELEMETRY_FORMAT;
+            _log.length = _log.length - oldLen + newLen;
+            _log.lastTime += offset;
+            _log.synced = true;
+            return true;
+        }
+        if (!dropOldest()) return false;
+        _log.dropped++;
+    }
+}
+
+uint16_t Telemetry::encodeKeyframe(const Sample& s, uint8_t* out) const {
+    uint16_t n = 0;
+    n += putVarint(s.time, out + n);
+    n += putVarint(s.soc, out + n);
+    n += putVarint(s.vcell, out + n);
+    n += putVarint(zigzag(s.crate), out + n);
+    out[n++] = s.state;
+    return n;
+}
+
+uint16_t Telemetry::encodeDelta(const Sample& s, const Sample& prev, uint8_t* out) const {
+    uint16_t n = 0;
+    // Small clock corrections backwards are clamped
+    uint32_t dt = s.time > prev.time ? s.time - prev.time : 0;
+    if (dt > 0x1FFFFFFF) dt = 0x1FFFFFFF;
+    n += putVarint(dt << 3 | s.state, out + n);
+    n += putVarint(zigzag((int32_t)s.soc - prev.soc), out + n);
+    n += putVarint(zigzag((int32_t)s.vcell - prev.vcell), out + n);
+    n += putVarint(zigzag((int32_t)s.crate - prev.crate), out + n);
+    return n;
+}
+
+uint16_t Telemetry::decodeKeyframe(const uint8_t* in, Sample& s) const {
+    uint16_t n = 0;
+    uint32_t v;
+    n += getVarint(in + n, v);
+    s.time = v;
+    n += getVarint(in + n, v);
+    s.soc = v;
+    n += getVarint(in + n, v);
+    s.vcell = v;
+    n += getVarint(in + n, v);
+    s.crate = unzigzag(v);
+    s.state = in[n++];
+    return n;
+}
+
+uint16_t Telemetry::decodeDelta(const uint8_t* in, const Sample& prev, Sample& s) const {
+    uint16_t n = 0;
+    uint32_t v;
+    n += getVarint(in + n, v);
+    s.time = prev.time + (v >> 3);
+    s.state = v & 0x07;
+    n += getVarint(in + n, v);
+    s.soc = prev.soc + unzigzag(v);
+    n += getVarint(in + n, v);
+    s.vcell = prev.vcell + unzigzag(v);
+    n += getVarint(in + n, v);
+    s.crate = prev.crate + unzigzag(v);
+    return n;
+}
+
+bool Telemetry::flushIfDue() {
+    process();
+    bool connected = Particle.connected();
+    bool reconnected = connected && !_wasConnected;
+    _wasConnected = connected;
+    if (!connected || _publishing) return false;
+
+    // An earlier boot's log goes out at the first connection
+    if (_earlier.samples > 0) return publish(true);
+    if (_log.samples == 0) return false;
+
+    if (reconnected || _log.length >= TELEMETRY_FLUSH_BYTES ||
+        millis() - _oldestMillis >= TELEMETRY_FLUSH_MS) {
+        return publish(false);
+    }
+    return false;
+}
+
+bool Telemetry::flush() {
+    process();
+    if (_publishing || !Particle.connected()) return false;
+    if (_earlier.samples > 0) return publish(true);
+    if (_log.samples == 0) return false;
+    return publish(false);
+}
+
+bool Telemetry::publish(bool earlier) {
+    const TelemetryLog& log = earlier ? _earlier : _log;
+
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static char encoded[(TELEMETRY_BUFFER_SIZE + 2) / 3 * 4 + 1];
+    const uint8_t* in = log.data;
+    uint16_t len = log.length;
+    char* out = encoded;
+    for (uint16_t i = 0; i < len; i += 3) {
+        uint32_t chunk = (uint32_t)in[i] << 16;
+        if (i + 1 < len) chunk |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) chunk |= in[i + 2];
+        *out++ = alphabet[(chunk >> 18) & 0x3F];
+        *out++ = alphabet[(chunk >> 12) & 0x3F];
+        *out++ = i + 1 < len ? alphabet[(chunk >> 6) & 0x3F] : '=';
+        *out++ = i + 2 < len ? alphabet[chunk & 0x3F] : '=';
+    }
+    *out = '\0';
+
+    // Completion is picked up by process(); the log is kept until then
+    _publish = Particle.publish(TELEMETRY_EVENT_NAME, encoded, PRIVATE);
+    _publishing = true;
+    _publishingEarlier = earlier;
+    _publishedSamples = log.samples;
+    return true;
+}
+
+void Telemetry::process() {
+    if (!_publishing || !_publish.isDone()) return;
+    _publishing = false;
+    bool earlier = _publishingEarlier;
+    _publishingEarlier = false;
+
+    if (!_publish.isSucceeded()) {
+        Serial.println("Telemetry: publish failed, samples kept");
+        return;
+    }
+    if (earlier) {
+        Serial.printlnf("Telemetry: published %u samples of an earlier boot", _earlier.samples);
+        _earlier.length = 0;
+        _earlier.samples = 0;
+        return;
+    }
+    Serial.printlnf("Telemetry: published %u samples", _publishedSamples);
+    release(_publishedSamples);
+}
+
+void Telemetry::release(uint16_t samples) {
+    // Drop the samples the cloud confirmed; newer ones stay for the next event
+    if (samples == 0) return;
+    if (samples >= _log.samples) {
+        reset();
+        return;
+    }
+    while (samples-- > 0) {
+        dropOldest();
+    }
+    _oldestMillis = millis();
+}
+
+uint16_t Telemetry::getSize() const {
+    return _log.length;
+}
+
+uint16_t Telemetry::getSampleCount() const {
+    return _log.samples;
+}
+
+uint32_t Telemetry::getDropped() const {
+    return _log.dropped;
+}
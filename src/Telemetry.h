@@ -0,0 +1,92 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "Particle.h"
+#include "Battery.h"
+
+// =====================================================
+// Battery telemetry log, kept in retained RAM across
+// resets and uploaded as one packed event.
+//
+// Event data is base64 of:
+//   version byte (TELEMETRY_FORMAT, bit 7 set if times
+//   are seconds since boot because the clock never synced)
+//   keyframe:  varint time (s), varint SOC, varint VCELL,
+//              zigzag CRATE, state byte
+//   then per sample: varint (dt << 3 | state),
+//              zigzag dSOC, zigzag dVCELL, zigzag dCRATE
+// SOC, VCELL and CRATE are raw MAX17049 register values.
+// A log started before the clock synced is rebased to
+// Unix time on sync. One left from an earlier boot without
+// a synced clock is set aside and uploaded as its own
+// event at the first cloud connection.
+// Uploads do not wait for the cloud's acknowledgement:
+// samples are released once the event is confirmed, and
+// samples recorded meanwhile stay in the log.
+// =====================================================
+#define TELEMETRY_UNSYNCED        0x80
+#define TELEMETRY_FORMAT          1
+#define TELEMETRY_BUFFER_SIZE     640     // Base64 of a full buffer fits one event
+#define TELEMETRY_FLUSH_BYTES     480     // Upload once the log is this big
+#define TELEMETRY_FLUSH_MS        (30 * 60 * 1000)  // ... or the oldest sample this old
+#define TELEMETRY_HEARTBEAT_S     300     // Log unchanged readings at least this often
+#define TELEMETRY_EVENT_NAME      "battery/telemetry"
+
+class Telemetry {
+public:
+    enum State : uint8_t {
+        StateOnBattery = 0,
+        StateCharging = 1
+    };
+
+    static Telemetry& instance();
+
+    void begin();     // Recovers a log that survived a reset
+
+    // Append one sample; the oldest samples are dropped when the log is full.
+    // Readings identical to the last one are skipped up to the heartbeat.
+    void record(const Battery::Snapshot& snapshot, uint8_t state);
+
+    // Upload when a budget is exceeded or the cloud just reconnected.
+    // Returns true if an event was submitted.
+    bool flushIfDue();
+    bool flush();                      // Upload now if connected and none in flight
+    void process();                    // Settle a finished upload
+    bool isPublishing() const { return _publishing; }
+
+    uint16_t getSize() const;          // Bytes logged
+    uint16_t getSampleCount() const;
+    uint32_t getDropped() const;       // Samples lost to a full log
+
+private:
+    struct Sample {
+        uint32_t time;
+        uint16_t soc;
+        uint16_t vcell;
+        int16_t crate;
+        uint8_t state;
+    };
+
+    Telemetry() = default;
+    uint32_t now() const;
+    bool publish(bool earlier);
+    void release(uint16_t samples);
+    void reset();
+    bool append(const Sample& sample);
+    bool dropOldest();
+    bool rebase(uint32_t offset);
+    uint16_t encodeKeyframe(const Sample& s, uint8_t* out) const;
+    uint16_t encodeDelta(const Sample& s, const Sample& prev, uint8_t* out) const;
+    uint16_t decodeKeyframe(const uint8_t* in, Sample& s) const;
+    uint16_t decodeDelta(const uint8_t* in, const Sample& prev, Sample& s) const;
+
+    bool _wasConnected = false;
+    uint32_t _oldestMillis = 0;
+
+    particle::Future<bool> _publish;
+    bool _publishing = false;
+    bool _publishingEarlier = false;   // In-flight event carries the earlier-boot log
+    uint16_t _publishedSamples = 0;    // Samples of the current log it carries
+};
+
+#endif
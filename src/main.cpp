@@ -2,8 +2,16 @@
 #include "RFID.h"
 #include "Buzzer.h"
 #include "Battery.h"
+#include "Charger.h"
+#include "SocEstimator.h"
 #include "EPD_Display.h"
 #include "Buttons.h"
+#include "Perf.h"
+#include "Scheduler.h"
+#include "PowerManager.h"
+#include "Telemetry.h"
+#include "I2CBus.h"
+#include "I2C_Utils.h"
 
 using namespace std::chrono_literals;
 
@@ -17,31 +25,73 @@ using namespace std::chrono_literals;
 // =====================================================
 #define ENABLE_EPD_TEST  1
 
+// =====================================================
+// Enable/disable periodic timing report on serial
+// =====================================================
+#define ENABLE_PERF_REPORT  1
+
+// =====================================================
+// Enable/disable MCU/PN532 sleep between idle antenna sweeps
+// =====================================================
+#define ENABLE_IDLE_SLEEP  1
+
 // =====================================================
 // Timing intervals using chrono literals
 // =====================================================
-constexpr auto BATTERY_READ_INTERVAL = 5s;
-constexpr auto CLOUD_PUBLISH_INTERVAL = 5min;
+constexpr auto BATTERY_READ_INTERVAL = 5s;     // Check of the cached snapshot, not a gauge read
+constexpr auto TELEMETRY_CHECK_INTERVAL = 1s;  // Flush budget and reconnect check
+constexpr auto PERF_REPORT_INTERVAL = 1min;
+constexpr auto CARD_REPEAT_HOLDOFF = 1s;     // Ignore the same card re-read within this window
 
 // =====================================================
 // Low battery threshold for hibernate
 // =====================================================
 constexpr float LOW_BATTERY_THRESHOLD = 5.0f;  // Hibernate at 5% SoC
+constexpr auto HIBERNATE_RESERVE = 20min;      // ... or when predicted to empty sooner
+
+SYSTEM_MODE(SEMI_AUTOMATIC);
 
 // =====================================================
-// Charger status pin (MP2672 ACOK)
-// ACOK is LOW when external power is present
+// Enlarge the Wire buffers (default 32 bytes) so multi-target and
+// batched PN532 responses can be read in a single transfer
 // =====================================================
-#define CHARGER_ACOK_PIN  D20
+constexpr size_t I2C_BUFFER_SIZE = 128;
+
+hal_i2c_config_t acquireWireBuffer() {
+    hal_i2c_config_t config = {
+        .size = sizeof(hal_i2c_config_t),
+        .version = HAL_I2C_CONFIG_VERSION_1,
+        .rx_buffer = new (std::nothrow) uint8_t[I2C_BUFFER_SIZE],
+        .rx_buffer_size = I2C_BUFFER_SIZE,
+        .tx_buffer = new (std::nothrow) uint8_t[I2C_BUFFER_SIZE],
+        .tx_buffer_size = I2C_BUFFER_SIZE
+    };
+    return config;
+}
 
-SYSTEM_MODE(SEMI_AUTOMATIC);
+// Recently seen cards, one slot per card that can share an RF cycle
+unsigned long lastCardTime[RFID_MAX_TARGETS] = {0};
+Uid lastCardUid[RFID_MAX_TARGETS] = {};
 
-unsigned long lastBattRead = 0;
-unsigned long lastPublish = 0;
+// Shown on the EPD status line once the panel is idle
+int statusBattery = -1;
+char statusCard[2 * PN532_MAX_UID_LENGTH + 1] = "";
+bool statusPending = false;
 
 // Forward declarations
-void enterHibernate();
+void enterHibernate(float soc, const char* reason);
 bool isCharging();
+SocEstimator::ChargeState chargeState();
+void taskButtons();
+void taskCharger();
+void onCharger(const Charger::Status& status);
+void onButton(const Buttons::Event& event);
+void taskRfid();
+void taskBattery();
+void taskTelemetry();
+void taskPerfReport();
+void taskDisplay();
+void displayBusy();
 
 void setup() {
     Serial.begin(115200);
@@ -51,102 +101,217 @@ void setup() {
     Buzzer::instance().init();
     Buzzer::instance().playSuccessTone();
 
-    Wire.begin();  // Init I2C first
+    I2CBus::instance().begin();  // Init I2C first, shared by every driver
 
     RFID::instance().begin();
     Battery::instance().begin();
+    Charger::instance().begin();
+    Charger::instance().subscribe(onCharger);
     Buttons::instance().begin();
+    Buttons::instance().subscribe(onButton);
+    Telemetry::instance().begin();
+
+#if ENABLE_CLOUD_PUBLISH
+    Particle.connect();
+    Serial.println("Connecting to cloud...");
+#endif
 
-    // Configure charger status pin
-    pinMode(CHARGER_ACOK_PIN, INPUT);
+    PowerManager::instance().begin();
+    PowerManager::instance().setEnabled(ENABLE_IDLE_SLEEP);
+    PowerManager::instance().setExternalPower(Charger::instance().isPowerPresent());
+
+    // Subsystems run as cooperative tasks; each must return quickly
+    Scheduler& sched = Scheduler::instance();
+    sched.addPeriodic("buttons", taskButtons, 0);
+    sched.addPeriodic("rfid", taskRfid, 0);
+    sched.addPeriodic("charger", taskCharger, 0);
+    sched.addPeriodic("battery", taskBattery, std::chrono::milliseconds(BATTERY_READ_INTERVAL).count());
+#if ENABLE_CLOUD_PUBLISH
+    sched.addPeriodic("telemetry", taskTelemetry, std::chrono::milliseconds(TELEMETRY_CHECK_INTERVAL).count());
+#endif
+#if ENABLE_PERF_REPORT
+    sched.addPeriodic("perf", taskPerfReport, std::chrono::milliseconds(PERF_REPORT_INTERVAL).count(),
+        std::chrono::milliseconds(PERF_REPORT_INTERVAL).count());
+#endif
 
 #if ENABLE_EPD_TEST
+    // After the tasks exist, so scanning continues while the panel refreshes
     Serial.println("Initializing EPD display...");
     EPD_Display::instance().begin();
+    EPD_Display::instance().setBusyHandler(displayBusy);
+    sched.addPeriodic("display", taskDisplay, 0);
     Serial.println("Displaying Hello World...");
     EPD_Display::instance().showHelloWorld();
-    EPD_Display::instance().hibernate();
+    EPD_Display::instance().powerOff();   // Not hibernate: the status line pushes only its changes
     Serial.println("EPD test complete");
 #endif
+}
+
+void loop() {
+    {
+        Perf::Scope loopProbe(Perf::PROBE_LOOP);
 
 #if ENABLE_CLOUD_PUBLISH
-    Particle.connect();
-    Serial.println("Connecting to cloud...");
+        Particle.process();
 #endif
+
+        Scheduler::instance().run();
+    }
+
+    // Sleep until the next deadline when idle
+    PowerManager::instance().idle(Scheduler::instance().msUntilNext());
 }
 
-void loop() {
+void taskDisplay() {
+    EPD_Display& epd = EPD_Display::instance();
+    epd.update();
+    if (!statusPending || epd.isBusy()) return;
+    statusPending = false;
+    epd.showStatus(statusBattery, statusCard[0] ? statusCard : nullptr);
+    epd.powerOff();
+}
+
+void displayBusy() {
+    // Display access is waiting for a refresh: keep the other tasks going
 #if ENABLE_CLOUD_PUBLISH
     Particle.process();
 #endif
+    Scheduler::instance().run();
+}
 
-    // Check buttons
+void taskButtons() {
     Buttons::instance().update();
+}
 
-    // RFID scanning
-    uint8_t uid[4];
-    if (RFID::instance().scan(uid)) {
-        Serial.printlnf("CARD: %02X%02X%02X%02X", uid[0], uid[1], uid[2], uid[3]);
-        Buzzer::instance().playSuccessTone();
-        delay(1000);
+void onButton(const Buttons::Event& event) {
+    PowerManager::instance().activity();
+    static const char* const names[] = {"short", "long", "double", "chord"};
+    Serial.printlnf("Button %d %s (mask 0x%X)", event.button,
+        names[(int)event.gesture], event.mask);
+}
+
+void taskCharger() {
+    Charger::instance().update();
+}
+
+void onCharger(const Charger::Status& status) {
+    Serial.printlnf("Charger: %s, %s%s", status.powerPresent ? "external power" : "on battery",
+        Charger::phaseName(status.phase), status.faults ? " [FAULT]" : "");
+    if (status.faults) {
+        Charger::instance().readAllRegisters();
     }
+    PowerManager::instance().setExternalPower(status.powerPresent);
+}
 
-    // Battery to serial every 5 seconds
-    if (millis() - lastBattRead >= BATTERY_READ_INTERVAL.count() * 1000) {
-        float soc = Battery::instance().getSoC();
-        float voltage = Battery::instance().getVoltage();
-        bool charging = isCharging();
-        Serial.printlnf("Battery: %.1f%% (%.2fV) %s", soc, voltage,
-            charging ? "[Charging]" : "[On Battery]");
-        lastBattRead = millis();
-
-        // Check for low battery and enter hibernate (only if not charging)
-        if (soc <= LOW_BATTERY_THRESHOLD && soc > 0 && !charging) {
-            enterHibernate();
+void taskRfid() {
+    // Non-blocking, completes from the PN532 IRQ
+    Uid uid;
+    uint8_t antenna = 0;
+    if (!RFID::instance().poll(uid, &antenna)) return;
+    PowerManager::instance().activity();
+
+    // Refresh the slot holding this card, else reuse the oldest slot
+    int slot = 0;
+    for (int i = 0; i < RFID_MAX_TARGETS; i++) {
+        if (uid == lastCardUid[i]) {
+            slot = i;
+            break;
         }
+        if (lastCardTime[i] < lastCardTime[slot]) slot = i;
     }
+    bool repeat = uid == lastCardUid[slot] &&
+        millis() - lastCardTime[slot] < std::chrono::milliseconds(CARD_REPEAT_HOLDOFF).count();
+    lastCardTime[slot] = millis();
+    if (!repeat) {
+        lastCardUid[slot] = uid;
+        char hex[2 * PN532_MAX_UID_LENGTH + 1];
+        uid.toHex(hex, sizeof(hex));
+        Serial.printlnf("CARD: %s on RF%d (%lu us, sweep %lu us)", hex, antenna,
+            (unsigned long)RFID::instance().getLastLatency(),
+            (unsigned long)RFID::instance().getLastSweepTime());
+        strcpy(statusCard, hex);
+        statusPending = true;
+        Buzzer::instance().playSuccessTone();
+    }
+}
 
-#if ENABLE_CLOUD_PUBLISH
-    // Publish to cloud every 5 minutes
-    if (Particle.connected() && millis() - lastPublish >= std::chrono::milliseconds(CLOUD_PUBLISH_INTERVAL).count()) {
-        float soc = Battery::instance().getSoC();
-        float voltage = Battery::instance().getVoltage();
-        uint16_t raw = Battery::instance().getRawVoltage();
-        bool charging = isCharging();
-        char data[128];
-        snprintf(data, sizeof(data), "{\"soc\":%.1f,\"voltage\":%.2f,\"raw\":%u,\"charging\":%s}",
-            soc, voltage, raw, charging ? "true" : "false");
-        Particle.publish("battery", data, PRIVATE);
-        Serial.printlnf("Published: %s", data);
-        lastPublish = millis();
+void taskBattery() {
+    Perf::Scope battProbe(Perf::PROBE_BATTERY);
+    // Served from the cached snapshot: ALRT (1% SOC change) resamples it,
+    // BATTERY_MAX_AGE_MS bounds its age otherwise. Telemetry and the
+    // estimator skip a snapshot they have already seen
+    const Battery::Snapshot& batt = Battery::instance().snapshot();
+    bool charging = isCharging();
+    Telemetry::instance().record(batt,
+        charging ? Telemetry::StateCharging : Telemetry::StateOnBattery);
+
+    SocEstimator& est = SocEstimator::instance();
+    est.update(batt, chargeState());
+    if (!est.isValid()) return;
+    float soc = est.getSoC();
+    uint32_t minutesLeft = est.getMinutesToEmpty();
+    Serial.printlnf("Battery: %.1f%% (%.2fV, %.2f%%/h) %s", soc, batt.voltage, est.getRate(),
+        charging ? "[Charging]" : "[On Battery]");
+    if ((int)(soc + 0.5f) != statusBattery) {
+        statusBattery = (int)(soc + 0.5f);
+        statusPending = true;
     }
-#endif
+
+    // Hibernate on low battery, or early if the trend says it will run out
+    // within the reserve (only if not charging). The estimator seeds at 0%
+    // below the empty voltage, so its validity is the gate, not soc > 0
+    if (charging) return;
+    if (soc <= LOW_BATTERY_THRESHOLD) {
+        enterHibernate(soc, "threshold");
+    } else if (minutesLeft <= (uint32_t)std::chrono::minutes(HIBERNATE_RESERVE).count()) {
+        enterHibernate(soc, "reserve");
+    }
+}
+
+void taskTelemetry() {
+    Telemetry::instance().flushIfDue();
 }
 
-void enterHibernate() {
-    float soc = Battery::instance().getSoC();
+void taskPerfReport() {
+    Perf::instance().print();
+    Perf::instance().reset();
+    Scheduler::instance().printStats();
+    Scheduler::instance().resetStats();
+    PowerManager::instance().printStats();
+    PowerManager::instance().resetStats();
+    I2C_Utils::printStats();
+    I2C_Utils::resetStats();
+    SocEstimator::instance().print();
+}
+
+void enterHibernate(float soc, const char* reason) {
     float voltage = Battery::instance().getVoltage();
 
-    Serial.printlnf("Low battery (%.1f%%) - entering hibernate mode", soc);
+    Serial.printlnf("Low battery (%.1f%%, %s) - entering hibernate mode", soc, reason);
 
 #if ENABLE_CLOUD_PUBLISH
-    // Publish final status before sleeping
+    // Publish the logged samples and final status before sleeping
+    Telemetry::instance().flush();
     if (Particle.connected()) {
         char data[128];
         snprintf(data, sizeof(data),
-            "{\"soc\":%.1f,\"voltage\":%.2f,\"status\":\"hibernating\"}",
-            soc, voltage);
+            "{\"soc\":%.1f,\"voltage\":%.2f,\"reason\":\"%s\",\"status\":\"hibernating\"}",
+            soc, voltage, reason);
         Particle.publish("battery", data, PRIVATE);
         Serial.println("Published sleep notification");
 
         // Wait for publish to complete
         delay(2000);
+        // Release the uploaded samples so they are not sent again after waking
+        Telemetry::instance().process();
     }
 #endif
 
-    // Play sleep tone
+    // Play sleep tone and let it finish before the MCU stops
     Buzzer::instance().playSleepTone();
-    delay(500);
+    while (Buzzer::instance().isPlaying()) {
+        delay(10);
+    }
 
     Serial.println("Going to hibernate - press Button 3 (A7) to wake");
     Serial.flush();
@@ -165,5 +330,22 @@ void enterHibernate() {
 
 bool isCharging() {
     // MP2672 ACOK pin is LOW when external power is present
-    return digitalRead(CHARGER_ACOK_PIN) == LOW;
+    return Charger::instance().isPowerPresent();
+}
+
+SocEstimator::ChargeState chargeState() {
+    Charger& charger = Charger::instance();
+    if (!charger.isPowerPresent()) return SocEstimator::ChargeState::Discharging;
+    if (!charger.isPresent()) return SocEstimator::ChargeState::Charging;
+
+    // On external power: the phase tells charging from done (or suspended)
+    switch (charger.getPhase()) {
+        case Charger::Phase::PreCharge:
+        case Charger::Phase::FastCharge:
+            return SocEstimator::ChargeState::Charging;
+        case Charger::Phase::Done:
+            return SocEstimator::ChargeState::Full;
+        default:
+            return SocEstimator::ChargeState::Discharging;
+    }
 }
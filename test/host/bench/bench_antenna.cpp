@@ -0,0 +1,221 @@
+// Replays a card-arrival trace through RFID::poll() against the simulated
+// PN532 and reports the mean time-to-detect per antenna port, to tune the
+// adaptive antenna schedule against plain round-robin:
+//
+//   BENCH <name> <value> <unit>
+//
+// Usage: bench_antenna [--trace FILE] [--round-robin] [--mask HEX]
+//                      [--seconds N] [--verbose]
+//
+// A trace is one card per line, '#' starts a comment:
+//
+//   <placed ms>,<removed ms>,<antenna 1-12>
+//
+// Without --trace a deterministic trace is generated with most arrivals on
+// two hot ports (RF3, RF8) and the rest spread over the others.
+
+#include "Particle.h"
+#include "Sim.h"
+#include "SimPN532.h"
+#include "I2CBus.h"
+#include "RFID.h"
+
+#include <new>
+#include <vector>
+
+// Same enlarged Wire buffers as main.cpp: a two-target frame exceeds the default 32
+hal_i2c_config_t acquireWireBuffer() {
+    hal_i2c_config_t config = {
+        .size = sizeof(hal_i2c_config_t),
+        .version = HAL_I2C_CONFIG_VERSION_1,
+        .rx_buffer = new (std::nothrow) uint8_t[PN532_PACKBUFFSIZ],
+        .rx_buffer_size = PN532_PACKBUFFSIZ,
+        .tx_buffer = new (std::nothrow) uint8_t[PN532_PACKBUFFSIZ],
+        .tx_buffer_size = PN532_PACKBUFFSIZ
+    };
+    return config;
+}
+
+namespace {
+
+const sim::Pin RF_LINES[4] = {RF_V1, RF_V2, RF_V3, RF_V4};
+
+struct Options {
+    const char* trace = nullptr;
+    bool roundRobin = false;
+    uint16_t mask = ANTENNA_MASK;
+    double seconds = 120;
+    bool verbose = false;
+};
+
+struct Arrival {
+    uint64_t placedMs;
+    uint64_t removedMs;
+    uint8_t antenna;
+};
+
+bool parse(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--round-robin")) {
+            opt.roundRobin = true;
+            continue;
+        }
+        if (!strcmp(arg, "--verbose")) {
+            opt.verbose = true;
+            continue;
+        }
+        if (!value) return false;
+        if (!strcmp(arg, "--trace")) opt.trace = value;
+        else if (!strcmp(arg, "--mask")) opt.mask = (uint16_t)strtoul(value, nullptr, 16);
+        else if (!strcmp(arg, "--seconds")) opt.seconds = atof(value);
+        else return false;
+        i++;
+    }
+    return opt.seconds > 0;
+}
+
+bool loadTrace(const char* path, std::vector<Arrival>& trace) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[128];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        unsigned long long placed, removed;
+        unsigned antenna;
+        int n = sscanf(line, " %llu , %llu , %u", &placed, &removed, &antenna);
+        if (n == EOF || n == 0) continue;
+        if (n != 3 || antenna < 1 || antenna > ANTENNA_COUNT || removed <= placed) {
+            fprintf(stderr, "%s:%d: bad arrival\n", path, lineNo);
+            fclose(f);
+            return false;
+        }
+        trace.push_back({placed, removed, (uint8_t)antenna});
+    }
+    fclose(f);
+    return true;
+}
+
+// Skewed arrivals: 3 of 4 cards on RF3 or RF8, dwell 300-800 ms
+void generateTrace(uint64_t endMs, std::vector<Arrival>& trace) {
+    uint32_t seed = 2024;
+    uint64_t t = 1000;
+    while (t < endMs) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t r = seed >> 8;
+        uint8_t antenna = r % 4 != 0 ? (r & 0x10 ? 3 : 8) : 1 + (r >> 5) % ANTENNA_COUNT;
+        uint64_t dwell = 300 + (r >> 12) % 500;
+        trace.push_back({t, t + dwell, antenna});
+        t += dwell + 200 + (r >> 3) % 600;
+    }
+}
+
+void report(const char* name, double value, const char* unit) {
+    printf("BENCH %-28s %12.3f %s\n", name, value, unit);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        fprintf(stderr, "usage: %s [--trace FILE] [--round-robin] [--mask HEX] "
+            "[--seconds N] [--verbose]\n", argv[0]);
+        return 2;
+    }
+    sim::setHalCallNs(250);
+    sim::setSerialEcho(opt.verbose);
+
+    std::vector<Arrival> trace;
+    uint64_t endMs = (uint64_t)(opt.seconds * 1000);
+    if (opt.trace) {
+        if (!loadTrace(opt.trace, trace)) {
+            fprintf(stderr, "cannot read trace %s\n", opt.trace);
+            return 2;
+        }
+        endMs = 0;
+        for (const Arrival& a : trace) {
+            if (a.removedMs > endMs) endMs = a.removedMs;
+        }
+    } else {
+        generateTrace(endMs, trace);
+    }
+
+    sim::SimPN532 pn532(PN532_IRQ, PN532_RST, RF_LINES);
+    I2CBus::instance().begin();
+    RFID& rfid = RFID::instance();
+    if (!rfid.begin()) {
+        printf("PN532 init failed\n");
+        return 1;
+    }
+    rfid.setAntennaMask(opt.mask);
+    rfid.setAdaptive(!opt.roundRobin);
+    rfid.resetAntennaStats();
+
+    // Card uid carries its trace index
+    uint64_t offsetMs = sim::nowMs();
+    for (size_t i = 0; i < trace.size(); i++) {
+        uint8_t uid[4] = {0x04, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i};
+        pn532.addCard(trace[i].antenna, uid, sizeof(uid),
+            (offsetMs + trace[i].placedMs) * 1000000ull, (offsetMs + trace[i].removedMs) * 1000000ull);
+    }
+
+    // A loop pass is the poll plus ~100 us of other tasks
+    while (sim::nowMs() < offsetMs + endMs) {
+        Uid uid;
+        rfid.poll(uid);
+        delayMicroseconds(100);
+    }
+
+    struct PortStats {
+        uint32_t placed, detected;
+        uint64_t totalNs, maxNs;
+    };
+    PortStats ports[ANTENNA_COUNT + 1] = {};
+    for (size_t i = 0; i < pn532.cardCount(); i++) {
+        const sim::SimPN532::Card& c = pn532.card(i);
+        if (!(opt.mask & (1 << (c.antenna - 1)))) continue;
+        PortStats* targets[2] = {&ports[c.antenna], &ports[0]};
+        for (PortStats* p : targets) {
+            p->placed++;
+            if (c.detectedNs == 0) continue;
+            uint64_t ns = c.detectedNs - c.placedNs;
+            p->detected++;
+            p->totalNs += ns;
+            if (ns > p->maxNs) p->maxNs = ns;
+        }
+    }
+
+    if (opt.verbose) rfid.printAntennaStats();
+    printf("\n");
+    report(opt.roundRobin ? "schedule.round_robin" : "schedule.adaptive", 1, "");
+    report("revisit", rfid.getRevisitInterval(), "ms");
+    for (uint8_t a = 0; a <= ANTENNA_COUNT; a++) {
+        const PortStats& p = ports[a];
+        if (a > 0 && p.placed == 0) continue;
+        char port[8];
+        if (a) snprintf(port, sizeof(port), "RF%u", a);
+        else strcpy(port, "all");
+        char key[40];
+        snprintf(key, sizeof(key), "ttd.%s.mean", port);
+        report(key, p.detected ? p.totalNs / 1e6 / p.detected : 0, "ms");
+        snprintf(key, sizeof(key), "ttd.%s.max", port);
+        report(key, p.maxNs / 1e6, "ms");
+        snprintf(key, sizeof(key), "ttd.%s.missed", port);
+        report(key, p.placed - p.detected, "");
+        if (a) {
+            snprintf(key, sizeof(key), "scans.%s", port);
+            report(key, rfid.getAntennaScans(a), "");
+        }
+    }
+
+    if (ports[0].detected == 0) {
+        printf("No card detected\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Pushes a sequence of screen transitions through a full-frame GxEPD2_BW on
+// the simulated SSD1677 and reports what each push costs, with the shadow
+// frame and with the drawing record only (setDirtyTracking):
+//
+//   BENCH <mode>.<transition>.<metric> <value> <unit>
+//
+// spi_bytes counts every byte sent to the panel (commands included),
+// ram_bytes what landed in panel RAM, ms the virtual time of the push
+// including its refresh. Each screen is redrawn from scratch, as
+// showHelloWorld() does, so an identical redraw still touches every pixel
+// of the text.
+//
+// Usage: bench_epd [--hal-ns N] [--cpu-scale X]
+//
+// diff_us (shadow frame only) is the row compare; it only shows up with
+// --cpu-scale, which charges the host's CPU time to the virtual clock.
+
+#include "Particle.h"
+#include "Sim.h"
+#include "SimSSD1677.h"
+#include "EPD_Display.h"
+
+#include <FreeSansBold24pt7b.h>
+
+#include <new>
+
+namespace {
+
+typedef GxEPD2_BW<GxEPD2_1330_GDEM133T91, GxEPD2_1330_GDEM133T91::HEIGHT> FullFrame_t;
+
+const uint32_t FRAME_BYTES = GxEPD2_1330_GDEM133T91::WIDTH / 8 * GxEPD2_1330_GDEM133T91::HEIGHT;
+
+struct Screen {
+    const char* name;
+    const char* title;
+    int cards;
+    int battery;
+};
+
+// Status digits change, then a redraw with no change, then the title
+const Screen SCREENS[] = {
+    {"first", "BA Reader", 0, 80},
+    {"same", "BA Reader", 0, 80},
+    {"status", "BA Reader", 1, 80},
+    {"status2", "BA Reader", 12, 79},
+    {"same2", "BA Reader", 12, 79},
+    {"title", "Card accepted", 12, 79},
+};
+
+void report(const char* mode, const char* transition, const char* metric, double value, const char* unit) {
+    char name[48];
+    snprintf(name, sizeof(name), "%s.%s.%s", mode, transition, metric);
+    printf("BENCH %-28s %12.3f %s\n", name, value, unit);
+}
+
+void draw(FullFrame_t& display, const Screen& screen) {
+    display.fillScreen(GxEPD_WHITE);
+    display.setTextColor(GxEPD_BLACK);
+    display.setFont(&FreeSansBold24pt7b);
+    display.setCursor(60, 120);
+    display.print(screen.title);
+    display.setCursor(60, 500);
+    display.printf("Cards: %d   Battery: %d%%", screen.cards, screen.battery);
+}
+
+// Returns the total SPI bytes of the sequence after the first push
+uint32_t run(const char* mode, bool shadowed, FullFrame_t& display, sim::SimSSD1677& epd) {
+    uint32_t total = 0;
+    for (const Screen& screen : SCREENS) {
+        draw(display, screen);
+        sim::SimSSD1677::Stats before = epd.stats();
+        display.epd2.resetTransferBytes();
+        uint64_t t0 = sim::nowNs();
+        bool changed = display.displayDirty();
+        uint64_t ns = sim::nowNs() - t0;
+        const sim::SimSSD1677::Stats& after = epd.stats();
+
+        uint32_t bytes = display.epd2.getTransferBytes();
+        if (&screen != &SCREENS[0]) total += bytes;
+        report(mode, screen.name, "changed", changed, "");
+        report(mode, screen.name, "spi_bytes", bytes, "B");
+        report(mode, screen.name, "ram_bytes", (double)(after.ramBytes - before.ramBytes), "B");
+        report(mode, screen.name, "refresh", after.partialRefreshes - before.partialRefreshes, "");
+        report(mode, screen.name, "ms", ns / 1e6, "ms");
+        if (shadowed) report(mode, screen.name, "diff_us", display.diffTime(), "us");
+    }
+    return total;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double cpuScale = 0;
+    uint32_t halNs = 250;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--hal-ns")) halNs = (uint32_t)atol(argv[i + 1]);
+        else if (!strcmp(argv[i], "--cpu-scale")) cpuScale = atof(argv[i + 1]);
+        else {
+            fprintf(stderr, "usage: %s [--hal-ns N] [--cpu-scale X]\n", argv[0]);
+            return 2;
+        }
+    }
+    sim::setCpuScale(cpuScale);
+    sim::setHalCallNs(halNs);
+
+    static sim::SimSSD1677 epd(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY, EPD_SCK, EPD_SDA);
+    FullFrame_t* display = new FullFrame_t(GxEPD2_1330_GDEM133T91(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY));
+    uint8_t* shadow = new (std::nothrow) uint8_t[FRAME_BYTES];
+
+    SPI.begin();
+    display->init(0, true, 2, false);
+    display->epd2.setSPIClock(EPD_SPI_CLOCK_DEFAULT);
+
+    // Whole frame per update, for reference (the first one after init also clears)
+    display->fillScreen(GxEPD_WHITE);
+    display->display(true);
+    display->epd2.resetTransferBytes();
+    display->display(true);
+    report("frame", "full", "spi_bytes", display->epd2.getTransferBytes(), "B");
+
+    display->setShadowFrame(shadow);
+    uint32_t shadowBytes = run("shadow", true, *display, epd);
+
+    display->setShadowFrame(nullptr);
+    display->setDirtyTracking(true);
+    uint32_t recordBytes = run("record", false, *display, epd);
+
+    report("shadow", "total", "spi_bytes", shadowBytes, "B");
+    report("record", "total", "spi_bytes", recordBytes, "B");
+
+    if (epd.stats().garbled > 0) {
+        printf("SPI bytes sent to the EPD above its %lu Hz limit\n", (unsigned long)epd.maxClock());
+        return 1;
+    }
+    if (shadowBytes >= recordBytes) {
+        printf("Shadow frame pushes sent no fewer bytes than the drawing record\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,249 @@
+// Runs the unmodified firmware (setup()/loop() from src/main.cpp) against the
+// simulated board for a stretch of virtual time and reports loop latency,
+// I2C bus utilisation, EPD push time, the status line's partial pushes and
+// card detection as BENCH lines:
+//
+//   BENCH <name> <value> <unit>
+//
+// Usage: bench_firmware [--seconds N] [--cpu-scale X] [--hal-ns N]
+//                       [--free-memory BYTES] [--cards N] [--soc PCT]
+//                       [--voltage V] [--epd-max-clock HZ] [--verbose]
+//
+// Garbled EPD bytes fail the run unless they were sent by the SPI clock
+// tuning during setup, which must then have rejected that clock.
+
+#include "Particle.h"
+#include "Sim.h"
+#include "SimBoard.h"
+
+#include <vector>
+
+void setup();
+void loop();
+
+namespace {
+
+struct Options {
+    double seconds = 60;
+    double cpuScale = 0;          // 0: deterministic, HAL call cost only
+    uint32_t halNs = 250;
+    uint32_t freeMemory = 3 * 1024 * 1024;
+    int cards = 20;
+    double soc = 80;
+    double voltage = -1;          // < 0: follows the SoC
+    uint32_t epdMaxClock = 0;     // 0: the SSD1677's 20 MHz
+    bool verbose = false;
+};
+
+// Loop pass latency histogram, 1 us buckets up to 100 ms
+class Histogram {
+public:
+    Histogram() : _buckets(100000, 0) {}
+
+    void add(uint64_t ns) {
+        uint64_t us = ns / 1000;
+        _buckets[us < _buckets.size() ? us : _buckets.size() - 1]++;
+        _count++;
+        _totalNs += ns;
+        if (ns > _maxNs) _maxNs = ns;
+    }
+
+    uint64_t count() const { return _count; }
+    double meanUs() const { return _count ? _totalNs / 1000.0 / _count : 0; }
+    double maxUs() const { return _maxNs / 1000.0; }
+
+    double percentileUs(double p) const {
+        uint64_t target = (uint64_t)(_count * p / 100.0);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < _buckets.size(); i++) {
+            seen += _buckets[i];
+            if (seen > target) return (double)i;
+        }
+        return maxUs();
+    }
+
+private:
+    std::vector<uint32_t> _buckets;
+    uint64_t _count = 0;
+    uint64_t _totalNs = 0;
+    uint64_t _maxNs = 0;
+};
+
+bool parse(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--verbose")) {
+            opt.verbose = true;
+            continue;
+        }
+        if (!value) return false;
+        if (!strcmp(arg, "--seconds")) opt.seconds = atof(value);
+        else if (!strcmp(arg, "--cpu-scale")) opt.cpuScale = atof(value);
+        else if (!strcmp(arg, "--hal-ns")) opt.halNs = (uint32_t)atol(value);
+        else if (!strcmp(arg, "--free-memory")) opt.freeMemory = (uint32_t)atol(value);
+        else if (!strcmp(arg, "--cards")) opt.cards = atoi(value);
+        else if (!strcmp(arg, "--soc")) opt.soc = atof(value);
+        else if (!strcmp(arg, "--voltage")) opt.voltage = atof(value);
+        else if (!strcmp(arg, "--epd-max-clock")) opt.epdMaxClock = (uint32_t)atol(value);
+        else return false;
+        i++;
+    }
+    return opt.seconds > 0;
+}
+
+void report(const char* name, double value, const char* unit) {
+    printf("BENCH %-28s %12.3f %s\n", name, value, unit);
+}
+
+// Deterministic card trace: one card at a time, on a pseudo-random antenna
+void placeCards(sim::SimBoard& board, int count, uint64_t startMs, uint64_t endMs) {
+    if (count <= 0 || endMs <= startMs) return;
+    uint32_t seed = 12345;
+    uint64_t stepMs = (endMs - startMs) / count;
+    for (int i = 0; i < count; i++) {
+        seed = seed * 1103515245u + 12345u;
+        uint8_t antenna = 1 + (seed >> 16) % 12;
+        uint8_t uid[4] = {0x04, (uint8_t)(i >> 8), (uint8_t)i, (uint8_t)(seed >> 24)};
+        uint64_t at = startMs + i * stepMs + (seed >> 8) % 200;
+        uint64_t dwellMs = stepMs * 2 / 3;
+        board.pn532.addCard(antenna, uid, sizeof(uid), at * 1000000ull,
+            (at + dwellMs) * 1000000ull, i % 3 == 2);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        fprintf(stderr, "usage: %s [--seconds N] [--cpu-scale X] [--hal-ns N] "
+            "[--free-memory BYTES] [--cards N] [--soc PCT] [--voltage V] [--epd-max-clock HZ] [--verbose]\n",
+            argv[0]);
+        return 2;
+    }
+    sim::setCpuScale(opt.cpuScale);
+    sim::setHalCallNs(opt.halNs);
+    sim::setFreeMemory(opt.freeMemory);
+    sim::setSerialEcho(opt.verbose);
+
+    static sim::SimBoard board;
+    board.gauge.setSoC(opt.soc);
+    board.gauge.setRate(-4);
+    board.gauge.setVoltageOverride(opt.voltage);
+    if (opt.epdMaxClock) board.epd.setMaxClock(opt.epdMaxClock);
+
+    uint64_t endMs = (uint64_t)(opt.seconds * 1000);
+    placeCards(board, opt.cards, 5000, endMs);
+    board.pressButton(1, endMs / 3, 120);
+    board.pressButton(2, endMs / 2, 1000);
+
+    Histogram loopHist;
+    const char* resetReason = nullptr;
+    uint64_t setupNs = 0;
+    uint64_t loopStartNs = 0;
+    uint64_t setupRamBytes = 0;
+    uint32_t setupPartials = 0;
+    uint32_t setupGarbled = 0;
+    try {
+        setup();
+        setupNs = sim::nowNs();
+        setupRamBytes = board.epd.stats().ramBytes;
+        setupPartials = board.epd.stats().partialRefreshes;
+        setupGarbled = board.epd.stats().garbled;
+        loopStartNs = sim::nowNs();
+        while (sim::nowMs() < endMs) {
+            uint64_t t0 = sim::nowNs();
+            uint64_t slept0 = sim::sleptNs();
+            loop();
+            loopHist.add((sim::nowNs() - t0) - (sim::sleptNs() - slept0));
+        }
+    } catch (const sim::Reset& reset) {
+        resetReason = reset.what();
+    }
+    fflush(stdout);
+
+    uint64_t elapsedNs = sim::nowNs();
+    uint64_t loopNs = elapsedNs - loopStartNs;
+    printf("\n");
+    report("virtual_time", elapsedNs / 1e9, "s");
+    report("setup", setupNs / 1e6, "ms");
+    report("loop.passes", (double)loopHist.count(), "");
+    report("loop.mean", loopHist.meanUs(), "us");
+    report("loop.p99", loopHist.percentileUs(99), "us");
+    report("loop.max", loopHist.maxUs(), "us");
+    report("mcu.asleep", loopNs ? 100.0 * sim::sleptNs() / loopNs : 0, "%");
+
+    uint64_t i2cBusy = 0;
+    for (const auto& entry : sim::i2cStats()) {
+        char name[40];
+        snprintf(name, sizeof(name), "i2c.0x%02X.util", entry.first);
+        report(name, 100.0 * entry.second.busyNs / elapsedNs, "%");
+        snprintf(name, sizeof(name), "i2c.0x%02X.transfers", entry.first);
+        report(name, entry.second.transfers, "");
+        i2cBusy += entry.second.busyNs;
+    }
+    report("i2c.util", 100.0 * i2cBusy / elapsedNs, "%");
+
+    const sim::SimSSD1677::Stats& epd = board.epd.stats();
+    report("epd.uploads", epd.uploads, "");
+    report("epd.upload.mean", epd.uploads ? epd.uploadNs / 1e6 / epd.uploads : 0, "ms");
+    report("epd.upload.max", epd.maxUploadNs / 1e6, "ms");
+    report("epd.ram_bytes", (double)epd.ramBytes, "B");
+    report("epd.refresh.full", epd.fullRefreshes, "");
+    report("epd.refresh.partial", epd.partialRefreshes, "");
+    report("epd.busy", epd.busyNs / 1e6, "ms");
+    // Status line pushes after the first full frame, against a full frame per update
+    uint32_t pushes = epd.partialRefreshes - setupPartials;
+    report("epd.push.count", pushes, "");
+    report("epd.push.ram_bytes", pushes ? (double)(epd.ramBytes - setupRamBytes) / pushes : 0, "B");
+    report("epd.push.frame_bytes", 2.0 * sim::SimSSD1677::WIDTH / 8 * sim::SimSSD1677::HEIGHT, "B");  // Both RAMs
+    report("epd.garbled_bytes.tuning", setupGarbled, "");
+    report("epd.garbled_bytes", epd.garbled - setupGarbled, "");
+    report("spi.busy", sim::spiStats().busyNs / 1e6, "ms");
+
+    const sim::SimPN532::CommandStats& scans = board.pn532.stats(0x4A);
+    report("pn532.scans", scans.count, "");
+    report("pn532.scan.mean", scans.count ? scans.totalNs / 1e6 / scans.count : 0, "ms");
+    report("pn532.scan.max", scans.maxNs / 1e6, "ms");
+
+    int detected = 0;
+    uint64_t detectTotal = 0;
+    uint64_t detectMax = 0;
+    for (size_t i = 0; i < board.pn532.cardCount(); i++) {
+        const sim::SimPN532::Card& c = board.pn532.card(i);
+        if (c.placedNs >= elapsedNs) continue;
+        if (c.detectedNs == 0) continue;
+        uint64_t ns = c.detectedNs - c.placedNs;
+        detected++;
+        detectTotal += ns;
+        if (ns > detectMax) detectMax = ns;
+    }
+    int placed = 0;
+    for (size_t i = 0; i < board.pn532.cardCount(); i++) {
+        if (board.pn532.card(i).placedNs < elapsedNs) placed++;
+    }
+    report("cards.placed", placed, "");
+    report("cards.detected", detected, "");
+    report("cards.detect.mean", detected ? detectTotal / 1e6 / detected : 0, "ms");
+    report("cards.detect.max", detectMax / 1e6, "ms");
+
+    if (resetReason) {
+        printf("Firmware reset before the end of the run: %s\n", resetReason);
+        return 1;
+    }
+    if (detected == 0 || epd.uploads == 0) {
+        printf("No card read or no display upload\n");
+        return 1;
+    }
+    if (pushes == 0) {
+        printf("No status line pushed as a partial update\n");
+        return 1;
+    }
+    if (epd.garbled > setupGarbled) {
+        printf("SPI bytes sent to the EPD above its %lu Hz limit\n",
+            (unsigned long)board.epd.maxClock());
+        return 1;
+    }
+    return 0;
+}
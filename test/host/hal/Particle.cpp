@@ -0,0 +1,373 @@
+#include "Particle.h"
+#include "Sim.h"
+
+#include <algorithm>
+#include <ctype.h>
+
+USBSerial Serial;
+HardwareSerial Serial1;
+const Logger Log("app");
+SystemClass System;
+CloudClass Particle;
+TimeClass Time;
+
+namespace {
+
+bool g_echo = true;
+uint32_t g_freeMemory = 3 * 1024 * 1024;   // P2 user heap
+
+sim::CloudConfig g_cloud;
+std::vector<sim::Publish> g_published;
+bool g_connecting = false;
+bool g_connected = false;
+uint64_t g_connectedAtNs = 0;
+
+// Wall clock once the cloud has synced time
+const time_t SIM_EPOCH = 1790000000;
+
+} // namespace
+
+namespace sim {
+
+CloudConfig& cloud() {
+    return g_cloud;
+}
+
+const std::vector<Publish>& published() {
+    return g_published;
+}
+
+void setFreeMemory(uint32_t bytes) {
+    g_freeMemory = bytes;
+}
+
+void setSerialEcho(bool echo) {
+    g_echo = echo;
+}
+
+} // namespace sim
+
+// ---- String ----
+
+static std::string formatNumber(unsigned long long n, int base) {
+    if (base < 2) base = 10;
+    char buf[8 * sizeof(n) + 1];
+    char* p = buf + sizeof(buf) - 1;
+    *p = '\0';
+    do {
+        int digit = n % base;
+        *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        n /= base;
+    } while (n);
+    return p;
+}
+
+static std::string formatSigned(long long n, int base) {
+    if (n < 0 && base == 10) return "-" + formatNumber(-(unsigned long long)n, base);
+    return formatNumber((unsigned long long)n, base);
+}
+
+static std::string formatFloat(double n, int digits) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return buf;
+}
+
+String::String(unsigned char value, unsigned char base) : _s(formatNumber(value, base)) {}
+String::String(int value, unsigned char base) : _s(formatSigned(value, base)) {}
+String::String(unsigned int value, unsigned char base) : _s(formatNumber(value, base)) {}
+String::String(long value, unsigned char base) : _s(formatSigned(value, base)) {}
+String::String(unsigned long value, unsigned char base) : _s(formatNumber(value, base)) {}
+String::String(float value, int decimals) : _s(formatFloat(value, decimals)) {}
+String::String(double value, int decimals) : _s(formatFloat(value, decimals)) {}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= _s.size()) return String();
+    return String(_s.substr(from, to - from));
+}
+
+int String::indexOf(char c, unsigned int from) const {
+    size_t pos = _s.find(c, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String& s, unsigned int from) const {
+    size_t pos = _s.find(s._s, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+void String::toUpperCase() {
+    for (char& c : _s) c = toupper((unsigned char)c);
+}
+
+void String::toLowerCase() {
+    for (char& c : _s) c = tolower((unsigned char)c);
+}
+
+bool String::equalsIgnoreCase(const String& s) const {
+    if (_s.size() != s._s.size()) return false;
+    for (size_t i = 0; i < _s.size(); i++) {
+        if (tolower((unsigned char)_s[i]) != tolower((unsigned char)s._s[i])) return false;
+    }
+    return true;
+}
+
+// ---- Print / Stream ----
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+}
+
+size_t Print::printNumber(unsigned long long n, int base) {
+    return write(formatNumber(n, base).c_str());
+}
+
+size_t Print::printSigned(long long n, int base) {
+    return write(formatSigned(n, base).c_str());
+}
+
+size_t Print::print(double n, int digits) {
+    return write(formatFloat(n, digits).c_str());
+}
+
+size_t Print::vprintf(bool newline, const char* format, va_list args) {
+    char buf[512];
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(buf, sizeof(buf), format, copy);
+    va_end(copy);
+    size_t n;
+    if (len >= (int)sizeof(buf)) {
+        std::string big(len + 1, '\0');
+        vsnprintf(&big[0], big.size(), format, args);
+        n = write((const uint8_t*)big.data(), len);
+    } else {
+        n = write((const uint8_t*)buf, len > 0 ? len : 0);
+    }
+    if (newline) n += println();
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t n = vprintf(false, format, args);
+    va_end(args);
+    return n;
+}
+
+size_t Print::printlnf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t n = vprintf(true, format, args);
+    va_end(args);
+    return n;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+        int c = read();
+        if (c < 0) break;
+        buffer[n++] = (char)c;
+    }
+    return n;
+}
+
+size_t USBSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t USBSerial::write(const uint8_t* buffer, size_t size) {
+    sim::HalCall hal;
+    if (!g_echo) return size;
+    // Drop the CR of CRLF line ends on the host terminal
+    for (size_t i = 0; i < size; i++) {
+        if (buffer[i] != '\r') fputc(buffer[i], stdout);
+    }
+    return size;
+}
+
+void USBSerial::flush() {
+    sim::HalCall hal;
+    fflush(stdout);
+}
+
+// ---- Logging ----
+
+void Logger::log(LogLevel level, const char* format, va_list args) const {
+    const char* name = level >= LOG_LEVEL_ERROR ? "ERROR" : level >= LOG_LEVEL_WARN ? "WARN" :
+        level >= LOG_LEVEL_INFO ? "INFO" : "TRACE";
+    Serial.printf("%010lu [%s] %s: ", (unsigned long)millis(), _name, name);
+    Serial.vprintf(true, format, args);
+}
+
+#define LOGGER_METHOD(method, level) \
+    void Logger::method(const char* format, ...) const { \
+        va_list args; \
+        va_start(args, format); \
+        log(level, format, args); \
+        va_end(args); \
+    }
+
+LOGGER_METHOD(trace, LOG_LEVEL_TRACE)
+LOGGER_METHOD(info, LOG_LEVEL_INFO)
+LOGGER_METHOD(warn, LOG_LEVEL_WARN)
+LOGGER_METHOD(error, LOG_LEVEL_ERROR)
+
+// ---- Software timers ----
+
+bool Timer::start(unsigned block) {
+    (void)block;
+    sim::HalCall hal;
+    stop();
+    _active = true;
+    _event = sim::scheduleIn((uint64_t)_period * 1000000ull, [this]() { fire(); }, true);
+    return true;
+}
+
+bool Timer::stop(unsigned block) {
+    (void)block;
+    if (_event) sim::cancel(_event);
+    _event = 0;
+    _active = false;
+    return true;
+}
+
+bool Timer::changePeriod(unsigned period, unsigned block) {
+    // As on Device OS, changing the period (re)starts the timer
+    _period = period;
+    return start(block);
+}
+
+void Timer::fire() {
+    _event = 0;
+    if (_oneShot) {
+        _active = false;
+    } else {
+        _event = sim::scheduleIn((uint64_t)_period * 1000000ull, [this]() { fire(); }, true);
+    }
+    if (_callback) _callback();
+}
+
+// ---- Sleep and System ----
+
+SystemSleepConfiguration& SystemSleepConfiguration::gpio(pin_t pin, InterruptMode mode) {
+    if (_pinCount < sizeof(_pins) / sizeof(_pins[0])) {
+        _pins[_pinCount++] = WakePin{pin, mode};
+    }
+    return *this;
+}
+
+SystemSleepResult SystemClass::sleep(const SystemSleepConfiguration& config) {
+    sim::HalCall hal;
+    if (config.getMode() == SystemSleepMode::HIBERNATE) {
+        Serial.flush();
+        throw sim::Reset("hibernate");
+    }
+    if (!config.keepsNetwork()) g_connected = g_connecting = false;
+
+    size_t count;
+    const SystemSleepConfiguration::WakePin* pins = config.getPins(count);
+    std::vector<sim::WakePin> wake;
+    for (size_t i = 0; i < count; i++) {
+        wake.push_back(sim::WakePin{pins[i].pin, pins[i].mode == CHANGE ? 0 : pins[i].mode == RISING ? 1 : 2});
+    }
+    sim::SleepResult result = sim::sleep(wake.data(), wake.size(), config.getDuration());
+    if (result.byPin) return SystemSleepResult(SystemSleepWakeupReason::BY_GPIO, result.pin);
+    return SystemSleepResult(SystemSleepWakeupReason::BY_RTC, PIN_INVALID);
+}
+
+uint32_t SystemClass::freeMemory() {
+    sim::HalCall hal;
+    return g_freeMemory;
+}
+
+void SystemClass::reset() {
+    Serial.flush();
+    throw sim::Reset("System.reset()");
+}
+
+uint32_t SystemClass::ticks() {
+    sim::HalCall hal;
+    return (uint32_t)(sim::nowNs() / 5);
+}
+
+uint64_t SystemClass::millis() {
+    sim::HalCall hal;
+    return sim::nowMs();
+}
+
+// ---- Cloud ----
+
+void particle::waitForFuture(const std::function<bool()>& done) {
+    // Blocks the calling thread: time passes, nothing else of the firmware runs
+    sim::HalCall hal;
+    while (!done()) {
+        sim::advanceNs(1000000);
+    }
+}
+
+void CloudClass::connect() {
+    sim::HalCall hal;
+    if (g_connected || g_connecting || !g_cloud.reachable) return;
+    g_connecting = true;
+    sim::scheduleIn((uint64_t)g_cloud.connectMs * 1000000ull, []() {
+        if (!g_connecting || !g_cloud.reachable) return;
+        g_connecting = false;
+        g_connected = true;
+        g_connectedAtNs = sim::nowNs();
+    });
+}
+
+void CloudClass::disconnect() {
+    sim::HalCall hal;
+    g_connected = g_connecting = false;
+}
+
+bool CloudClass::connected() {
+    sim::HalCall hal;
+    return g_connected;
+}
+
+particle::Future<bool> CloudClass::publish(const char* name, const char* data, PublishFlags flags) {
+    sim::HalCall hal;
+    auto state = std::make_shared<particle::Future<bool>::State>();
+    if (!g_connected) {
+        state->done = true;
+        return particle::Future<bool>(state);
+    }
+    bool ok = !g_cloud.failPublishes;
+    size_t index = g_published.size();
+    g_published.push_back(sim::Publish{name, data ? data : "", sim::nowNs(), false});
+
+    // NO_ACK completes once the message is sent; otherwise on the cloud's ACK
+    uint64_t latencyNs = (uint64_t)g_cloud.publishMs * 1000000ull;
+    if (flags & NO_ACK) latencyNs /= 10;
+    sim::scheduleIn(latencyNs, [state, ok, index]() {
+        state->done = true;
+        state->succeeded = ok && g_connected;
+        state->value = state->succeeded;
+        g_published[index].succeeded = state->succeeded;
+    });
+    return particle::Future<bool>(state);
+}
+
+bool TimeClass::isValid() {
+    sim::HalCall hal;
+    return g_connected || g_connectedAtNs != 0;
+}
+
+time_t TimeClass::now() {
+    sim::HalCall hal;
+    return SIM_EPOCH + (time_t)sim::nowMs() / 1000;
+}
+
+int TimeClass::year(time_t t) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    return tm.tm_year + 1900;
+}
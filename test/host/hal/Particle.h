@@ -0,0 +1,442 @@
+#ifndef PARTICLE_H
+#define PARTICLE_H
+
+// =====================================================
+// Host build of the Device OS API subset the firmware
+// uses, backed by the simulation core in Sim.h. Keeps
+// the Device OS names and signatures so src/ and lib/
+// compile unchanged.
+// =====================================================
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+
+typedef uint16_t pin_t;
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint32_t system_tick_t;
+
+// ---- Pins: D0-D29, A0-A7 ----
+
+enum : pin_t {
+    D0, D1, D2, D3, D4, D5, D6, D7, D8, D9, D10, D11, D12, D13, D14, D15,
+    D16, D17, D18, D19, D20, D21, D22, D23, D24, D25, D26, D27, D28, D29,
+    A0 = 100, A1, A2, A3, A4, A5, A6, A7
+};
+#define PIN_INVALID 0xFF
+
+// Gen 3 SPI pins
+#define SCK  D13
+#define MOSI D12
+#define MISO D11
+
+enum PinMode { INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN, OUTPUT_OPEN_DRAIN };
+enum InterruptMode { CHANGE, RISING, FALLING };
+#define HIGH 1
+#define LOW 0
+
+// unsigned char like the String base parameter, so String(uint8_t, HEX)
+// does not also match String(float, int)
+#define DEC ((unsigned char)10)
+#define HEX ((unsigned char)16)
+#define OCT ((unsigned char)8)
+#define BIN ((unsigned char)2)
+
+#define PROGMEM
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+#define pgm_read_byte(a) (*(const uint8_t*)(a))
+#define pgm_read_word(a) (*(const uint16_t*)(a))
+#define _BV(b) (1UL << (b))
+
+template <class T> T min(T a, T b) { return a < b ? a : b; }
+template <class T> T max(T a, T b) { return a > b ? a : b; }
+inline int min(uint8_t a, int b) { return a < b ? a : b; }
+inline int max(uint8_t a, int b) { return a > b ? a : b; }
+template <class T, class L, class H> T constrain(T x, L lo, H hi) { return x < lo ? lo : (x > hi ? hi : x); }
+
+// ---- Application macros ----
+
+#define SYSTEM_MODE(mode)
+#define SYSTEM_THREAD(state)
+#define STARTUP(code)
+#define retained
+
+// No threads on the host; ATOMIC_BLOCK holds interrupts off for its body
+struct ParticleAtomicBlock {
+    ParticleAtomicBlock();
+    ~ParticleAtomicBlock();
+    bool once = true;
+};
+#define ATOMIC_BLOCK() for (ParticleAtomicBlock _atomic; _atomic.once; _atomic.once = false)
+#define SINGLE_THREADED_BLOCK() if (true)
+#define WITH_LOCK(lockable) if (true)
+
+// ---- Wiring ----
+
+void pinMode(pin_t pin, PinMode mode);
+void digitalWrite(pin_t pin, uint8_t value);
+int32_t digitalRead(pin_t pin);
+inline int32_t pinReadFast(pin_t pin) { return digitalRead(pin); }
+inline void pinSetFast(pin_t pin) { digitalWrite(pin, HIGH); }
+inline void pinResetFast(pin_t pin) { digitalWrite(pin, LOW); }
+int32_t analogRead(pin_t pin);
+void tone(pin_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(pin_t pin);
+
+system_tick_t millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+bool attachInterrupt(pin_t pin, std::function<void()> handler, InterruptMode mode,
+                     int8_t priority = -1, uint8_t subpriority = 0);
+template <class T>
+bool attachInterrupt(pin_t pin, void (T::*handler)(), T* instance, InterruptMode mode,
+                     int8_t priority = -1, uint8_t subpriority = 0) {
+    return attachInterrupt(pin, std::bind(handler, instance), mode, priority, subpriority);
+}
+bool detachInterrupt(pin_t pin);
+void interrupts();
+void noInterrupts();
+
+// ---- String ----
+
+class String {
+public:
+    String(const char* s = "") : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    String(char c) : _s(1, c) {}
+    String(unsigned char value, unsigned char base = 10);
+    String(int value, unsigned char base = 10);
+    String(unsigned int value, unsigned char base = 10);
+    String(long value, unsigned char base = 10);
+    String(unsigned long value, unsigned char base = 10);
+    String(float value, int decimals = 2);
+    String(double value, int decimals = 2);
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return _s.length(); }
+    char charAt(unsigned int index) const { return index < _s.length() ? _s[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    String substring(unsigned int from) const { return substring(from, length()); }
+    String substring(unsigned int from, unsigned int to) const;
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& s, unsigned int from = 0) const;
+    long toInt() const { return atol(_s.c_str()); }
+    float toFloat() const { return atof(_s.c_str()); }
+    void toUpperCase();
+    void toLowerCase();
+    bool equals(const String& s) const { return _s == s._s; }
+    bool equalsIgnoreCase(const String& s) const;
+    bool startsWith(const String& s) const { return _s.compare(0, s._s.size(), s._s) == 0; }
+
+    String& operator+=(const String& s) { _s += s._s; return *this; }
+    String& operator+=(const char* s) { _s += s ? s : ""; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+    String& concat(const String& s) { return *this += s; }
+    bool operator==(const String& s) const { return _s == s._s; }
+    bool operator==(const char* s) const { return _s == (s ? s : ""); }
+    bool operator!=(const String& s) const { return !(*this == s); }
+    bool operator!=(const char* s) const { return !(*this == s); }
+    bool operator<(const String& s) const { return _s < s._s; }
+    friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+
+private:
+    std::string _s;
+};
+
+// ---- Print / Stream ----
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return printNumber(n, base); }
+    size_t print(int n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned int n, int base = DEC) { return printNumber(n, base); }
+    size_t print(long n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(long long n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned long long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(double n, int digits = 2);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t printlnf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t vprintf(bool newline, const char* format, va_list args);
+
+private:
+    size_t printNumber(unsigned long long n, int base);
+    size_t printSigned(long long n, int base);
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+    size_t readBytes(char* buffer, size_t length);
+    void setTimeout(system_tick_t timeout) { _timeout = timeout; }
+
+protected:
+    system_tick_t _timeout = 1000;
+};
+
+class USBSerial : public Stream {
+public:
+    void begin(long speed = 9600) { (void)speed; }
+    void end() {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override;
+    bool isConnected() { return true; }
+    explicit operator bool() { return true; }
+};
+extern USBSerial Serial;
+
+// Present for the PN532 UART transport, no device behind it
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long speed) { (void)speed; }
+    void end() {}
+    size_t write(uint8_t c) override { (void)c; return 1; }
+    using Print::write;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+};
+extern HardwareSerial Serial1;
+
+// ---- Logging ----
+
+enum LogLevel {
+    LOG_LEVEL_ALL = 1,
+    LOG_LEVEL_TRACE = 1,
+    LOG_LEVEL_INFO = 30,
+    LOG_LEVEL_WARN = 40,
+    LOG_LEVEL_ERROR = 50,
+    LOG_LEVEL_NONE = 70
+};
+
+class Logger {
+public:
+    explicit Logger(const char* name = "app") : _name(name) {}
+    void trace(const char* format, ...) const __attribute__((format(printf, 2, 3)));
+    void info(const char* format, ...) const __attribute__((format(printf, 2, 3)));
+    void warn(const char* format, ...) const __attribute__((format(printf, 2, 3)));
+    void error(const char* format, ...) const __attribute__((format(printf, 2, 3)));
+    void log(LogLevel level, const char* format, va_list args) const;
+
+private:
+    const char* _name;
+};
+extern const Logger Log;
+
+// ---- Software timers ----
+
+class Timer {
+public:
+    typedef std::function<void()> timer_callback_fn;
+
+    Timer(unsigned period, timer_callback_fn callback, bool oneShot = false)
+        : _period(period), _callback(callback), _oneShot(oneShot) {}
+    template <typename T>
+    Timer(unsigned period, void (T::*handler)(), T& instance, bool oneShot = false)
+        : Timer(period, std::bind(handler, &instance), oneShot) {}
+    ~Timer() { dispose(); }
+
+    bool start(unsigned block = 0);
+    bool stop(unsigned block = 0);
+    bool reset(unsigned block = 0) { return start(block); }
+    bool changePeriod(unsigned period, unsigned block = 0);
+    bool startFromISR() { return start(); }
+    bool stopFromISR() { return stop(); }
+    bool resetFromISR() { return reset(); }
+    bool changePeriodFromISR(unsigned period) { return changePeriod(period); }
+    bool isActive() const { return _active; }
+    void dispose() { stop(); }
+
+private:
+    void fire();
+
+    unsigned _period;
+    timer_callback_fn _callback;
+    bool _oneShot;
+    bool _active = false;
+    uint32_t _event = 0;
+};
+
+// ---- Sleep and System ----
+
+enum class SystemSleepMode : uint8_t { NONE, STOP, ULTRA_LOW_POWER, HIBERNATE };
+enum class SystemSleepWakeupReason : uint16_t { UNKNOWN, BY_GPIO, BY_ADC, BY_DAC, BY_RTC, BY_LPCOMP, BY_USART, BY_CAN, BY_NFC, BY_NETWORK };
+enum class SystemSleepNetworkFlag : uint8_t { NONE, INACTIVE_STANDBY };
+typedef int network_interface_t;
+#define NETWORK_INTERFACE_ALL 0
+
+class SystemSleepConfiguration {
+public:
+    struct WakePin {
+        pin_t pin;
+        InterruptMode mode;
+    };
+
+    SystemSleepConfiguration& mode(SystemSleepMode mode) { _mode = mode; return *this; }
+    SystemSleepConfiguration& gpio(pin_t pin, InterruptMode mode);
+    SystemSleepConfiguration& duration(system_tick_t ms) { _durationMs = ms; return *this; }
+    SystemSleepConfiguration& duration(std::chrono::milliseconds ms) { return duration((system_tick_t)ms.count()); }
+    SystemSleepConfiguration& network(network_interface_t netif,
+                                      SystemSleepNetworkFlag flag = SystemSleepNetworkFlag::NONE) {
+        (void)netif;
+        _keepNetwork = flag == SystemSleepNetworkFlag::INACTIVE_STANDBY;
+        return *this;
+    }
+
+    SystemSleepMode getMode() const { return _mode; }
+    system_tick_t getDuration() const { return _durationMs; }
+    const WakePin* getPins(size_t& count) const { count = _pinCount; return _pins; }
+    bool keepsNetwork() const { return _keepNetwork; }
+
+private:
+    SystemSleepMode _mode = SystemSleepMode::NONE;
+    system_tick_t _durationMs = 0;
+    WakePin _pins[16] = {};
+    size_t _pinCount = 0;
+    bool _keepNetwork = false;
+};
+
+class SystemSleepResult {
+public:
+    SystemSleepResult() = default;
+    SystemSleepResult(SystemSleepWakeupReason reason, pin_t pin) : _reason(reason), _pin(pin) {}
+    SystemSleepWakeupReason wakeupReason() const { return _reason; }
+    pin_t wakeupPin() const { return _pin; }
+
+private:
+    SystemSleepWakeupReason _reason = SystemSleepWakeupReason::UNKNOWN;
+    pin_t _pin = PIN_INVALID;
+};
+
+class SystemClass {
+public:
+    SystemSleepResult sleep(const SystemSleepConfiguration& config);
+    uint32_t freeMemory();
+    [[noreturn]] void reset();
+    uint32_t ticks();
+    static uint32_t ticksPerMicrosecond() { return 200; }
+    uint64_t millis();
+    uint32_t uptime() { return (uint32_t)(millis() / 1000); }
+};
+extern SystemClass System;
+
+// ---- Cloud ----
+
+namespace particle {
+
+// Result of an asynchronous operation; converting to the value waits for it
+template <typename T>
+class Future {
+public:
+    struct State {
+        bool done = false;
+        bool succeeded = false;
+        T value = T();
+    };
+
+    Future() : _state(std::make_shared<State>()) {}
+    explicit Future(std::shared_ptr<State> state) : _state(state) {}
+
+    bool isDone() const { return _state->done; }
+    bool isSucceeded() const { return _state->done && _state->succeeded; }
+    bool isFailed() const { return _state->done && !_state->succeeded; }
+    Future& wait();
+    T result() const { return _state->value; }
+    operator T() { wait(); return _state->value; }
+
+private:
+    std::shared_ptr<State> _state;
+};
+
+void waitForFuture(const std::function<bool()>& done);
+
+template <typename T>
+Future<T>& Future<T>::wait() {
+    std::shared_ptr<State> state = _state;
+    waitForFuture([state]() { return state->done; });
+    return *this;
+}
+
+} // namespace particle
+
+typedef int PublishFlags;
+constexpr PublishFlags PUBLIC = 0x00;
+constexpr PublishFlags PRIVATE = 0x01;
+constexpr PublishFlags NO_ACK = 0x02;
+constexpr PublishFlags WITH_ACK = 0x08;
+
+class CloudClass {
+public:
+    void connect();
+    void disconnect();
+    bool connected();
+    bool disconnected() { return !connected(); }
+    void process() {}
+    particle::Future<bool> publish(const char* name, const char* data, PublishFlags flags = PUBLIC);
+    particle::Future<bool> publish(const char* name, PublishFlags flags = PUBLIC) { return publish(name, nullptr, flags); }
+};
+extern CloudClass Particle;
+
+class TimeClass {
+public:
+    static bool isValid();
+    static time_t now();
+    static int year(time_t t);
+};
+extern TimeClass Time;
+
+// ---- I2C buffers (Device OS acquireWireBuffer() hook) ----
+
+#define HAL_I2C_CONFIG_VERSION_1 1
+struct hal_i2c_config_t {
+    uint16_t size;
+    uint16_t version;
+    uint8_t* rx_buffer;
+    uint32_t rx_buffer_size;
+    uint8_t* tx_buffer;
+    uint32_t tx_buffer_size;
+};
+
+#include "Wire.h"
+#include "SPI.h"
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef SPI_H
+#define SPI_H
+
+#include "Particle.h"
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x01
+#define SPI_MODE2 0x02
+#define SPI_MODE3 0x03
+#define MHZ 1000000
+
+class SPISettings {
+public:
+    SPISettings() = default;
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+        : _clock(clock), _bitOrder(bitOrder), _dataMode(dataMode) {}
+    uint32_t getClock() const { return _clock; }
+
+private:
+    uint32_t _clock = 4000000;
+    uint8_t _bitOrder = MSBFIRST;
+    uint8_t _dataMode = SPI_MODE0;
+};
+
+typedef void (*wiring_spi_dma_transfercomplete_callback_t)(void);
+
+class SPIClass {
+public:
+    void begin() {}
+    void begin(pin_t ssPin) { (void)ssPin; }
+    void end() {}
+    int32_t beginTransaction() { return 0; }
+    int32_t beginTransaction(const SPISettings& settings);
+    void endTransaction() {}
+    void setClockSpeed(unsigned value, unsigned scale = 1) { _clock = value * scale; }
+    void setBitOrder(uint8_t order) { (void)order; }
+    void setDataMode(uint8_t mode) { (void)mode; }
+
+    uint8_t transfer(uint8_t data);
+    // DMA transfer; the wire time is charged before the callback runs
+    void transfer(const void* tx, void* rx, size_t length, wiring_spi_dma_transfercomplete_callback_t callback);
+    void transferCancel() {}
+
+private:
+    uint32_t _clock = 4000000;
+};
+extern SPIClass SPI;
+
+#endif
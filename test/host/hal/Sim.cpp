@@ -0,0 +1,407 @@
+#include "Sim.h"
+
+#include <chrono>
+#include <vector>
+
+namespace sim {
+
+namespace {
+
+// ---- Clock and events ----
+
+struct Event {
+    uint64_t at;
+    uint64_t seq;
+    EventId id;
+    std::function<void()> fn;
+    bool cpu;
+};
+
+uint64_t g_now = 0;
+double g_cpuScale = 0;
+uint32_t g_callNs = 50;
+int g_depth = 0;
+bool g_hostMarked = false;
+std::chrono::steady_clock::time_point g_hostMark;
+
+std::vector<Event> g_events;
+uint64_t g_seq = 0;
+EventId g_nextId = 1;
+
+// ---- GPIO ----
+
+struct PinState {
+    Mode mode = Mode::Unset;
+    int out = 0;
+    int ext = -1;
+    std::function<void()> isr;
+    int edge = 0;
+    std::vector<std::function<void(int)>> watchers;
+};
+
+std::map<Pin, PinState> g_pins;
+uint32_t g_contentions = 0;
+bool g_interrupts = true;
+std::vector<Pin> g_pendingIsr;
+
+bool g_sleeping = false;
+bool g_woken = false;
+Pin g_wakePin = 0;
+std::vector<WakePin> g_wakePins;
+uint64_t g_slept = 0;
+
+// ---- Buses ----
+
+std::map<uint8_t, I2CDevice*> g_i2c;
+std::map<uint8_t, BusStats> g_i2cStats;
+uint32_t g_i2cHz = 100000;
+
+struct StuckSda {
+    bool active = false;
+    bool watching = false;
+    Pin sda = 0;
+    uint8_t left = 0;
+} g_stuck;
+
+std::vector<SPIDevice*> g_spi;
+SpiStats g_spiStats = {};
+
+// Run the earliest event due by 'limit'; false if there is none
+bool runNext(uint64_t limit) {
+    size_t best = g_events.size();
+    for (size_t i = 0; i < g_events.size(); i++) {
+        const Event& e = g_events[i];
+        if (e.at > limit || (e.cpu && g_sleeping)) continue;
+        if (best == g_events.size() || e.at < g_events[best].at ||
+            (e.at == g_events[best].at && e.seq < g_events[best].seq)) {
+            best = i;
+        }
+    }
+    if (best == g_events.size()) return false;
+    Event e = std::move(g_events[best]);
+    g_events.erase(g_events.begin() + best);
+    if (e.at > g_now) g_now = e.at;
+    g_depth++;
+    e.fn();
+    g_depth--;
+    return true;
+}
+
+int levelOf(const PinState& p) {
+    // Open-drain outputs only pull low and idle on the external pull-up;
+    // a push-pull output loses to an external low (counted as contention)
+    if (p.mode == Mode::OutputOpenDrain) return p.out ? (p.ext >= 0 ? p.ext : 1) : 0;
+    if (p.mode == Mode::Output) return p.ext == 0 ? 0 : p.out;
+    if (p.ext >= 0) return p.ext;
+    return p.mode == Mode::InputPulldown ? 0 : 1;
+}
+
+bool edgeMatches(int edge, int level) {
+    return edge == 0 || (edge == 1 && level) || (edge == 2 && !level);
+}
+
+void changed(Pin pin, PinState& p, int level) {
+    // Watchers may change other pins; copy so the list can grow meanwhile
+    std::vector<std::function<void(int)>> watchers = p.watchers;
+    for (auto& w : watchers) w(level);
+
+    if (g_sleeping) {
+        for (const WakePin& w : g_wakePins) {
+            if (w.pin == pin && !g_woken && edgeMatches(w.edge, level)) {
+                g_woken = true;
+                g_wakePin = pin;
+            }
+        }
+        return;
+    }
+    if (!p.isr || p.mode == Mode::Output || p.mode == Mode::OutputOpenDrain || !edgeMatches(p.edge, level)) return;
+    if (!g_interrupts) {
+        g_pendingIsr.push_back(pin);
+        return;
+    }
+    std::function<void()> isr = p.isr;
+    g_depth++;
+    isr();
+    g_depth--;
+}
+
+template <typename F>
+void update(Pin pin, F mutate) {
+    PinState& p = g_pins[pin];
+    int before = levelOf(p);
+    bool fought = p.mode == Mode::Output && p.ext >= 0 && p.ext != p.out;
+    mutate(p);
+    int after = levelOf(p);
+    if (!fought && p.mode == Mode::Output && p.ext >= 0 && p.ext != p.out) g_contentions++;
+    if (before != after) changed(pin, p, after);
+}
+
+uint64_t i2cNs(size_t bytes) {
+    // START, 9 clocks per byte including the address byte, STOP
+    return (uint64_t)(2 + 9 * (bytes + 1)) * 1000000000ull / g_i2cHz;
+}
+
+} // namespace
+
+uint64_t nowNs() {
+    return g_now;
+}
+
+void runUntilNs(uint64_t t) {
+    while (runNext(t)) {
+    }
+    if (t > g_now) g_now = t;
+}
+
+void advanceNs(uint64_t ns) {
+    runUntilNs(g_now + ns);
+}
+
+void setCpuScale(double scale) {
+    g_cpuScale = scale;
+}
+
+void setHalCallNs(uint32_t ns) {
+    g_callNs = ns;
+}
+
+HalCall::HalCall() {
+    if (g_depth++ != 0) return;
+    uint64_t ns = g_callNs;
+    if (g_cpuScale > 0 && g_hostMarked) {
+        auto host = std::chrono::steady_clock::now() - g_hostMark;
+        ns += (uint64_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(host).count() * g_cpuScale);
+    }
+    advanceNs(ns);
+}
+
+HalCall::~HalCall() {
+    if (--g_depth != 0) return;
+    g_hostMark = std::chrono::steady_clock::now();
+    g_hostMarked = true;
+}
+
+EventId schedule(uint64_t atNs, std::function<void()> fn, bool cpu) {
+    Event e;
+    e.at = atNs;
+    e.seq = g_seq++;
+    e.id = g_nextId++;
+    e.fn = fn;
+    e.cpu = cpu;
+    g_events.push_back(std::move(e));
+    return g_events.back().id;
+}
+
+void cancel(EventId id) {
+    for (size_t i = 0; i < g_events.size(); i++) {
+        if (g_events[i].id == id) {
+            g_events.erase(g_events.begin() + i);
+            return;
+        }
+    }
+}
+
+void drive(Pin pin, int level) {
+    update(pin, [level](PinState& p) { p.ext = level < 0 ? -1 : (level ? 1 : 0); });
+}
+
+int level(Pin pin) {
+    return levelOf(g_pins[pin]);
+}
+
+Mode mode(Pin pin) {
+    return g_pins[pin].mode;
+}
+
+uint32_t contentions() {
+    return g_contentions;
+}
+
+void watch(Pin pin, std::function<void(int level)> fn) {
+    g_pins[pin].watchers.push_back(fn);
+}
+
+void setMode(Pin pin, Mode mode) {
+    update(pin, [mode](PinState& p) { p.mode = mode; });
+}
+
+void write(Pin pin, int level) {
+    update(pin, [level](PinState& p) { p.out = level ? 1 : 0; });
+}
+
+void attachIsr(Pin pin, std::function<void()> isr, int edge) {
+    PinState& p = g_pins[pin];
+    p.isr = isr;
+    p.edge = edge;
+}
+
+void detachIsr(Pin pin) {
+    g_pins[pin].isr = nullptr;
+}
+
+void setInterrupts(bool enabled) {
+    g_interrupts = enabled;
+    if (!enabled) return;
+    std::vector<Pin> pending;
+    pending.swap(g_pendingIsr);
+    for (Pin pin : pending) {
+        PinState& p = g_pins[pin];
+        if (!p.isr) continue;
+        std::function<void()> isr = p.isr;
+        g_depth++;
+        isr();
+        g_depth--;
+    }
+}
+
+SleepResult sleep(const WakePin* pins, size_t count, uint32_t durationMs) {
+    g_wakePins.assign(pins, pins + count);
+    g_woken = false;
+    g_sleeping = true;
+    g_pendingIsr.clear();
+    uint64_t start = g_now;
+    uint64_t deadline = durationMs ? g_now + (uint64_t)durationMs * 1000000ull : UINT64_MAX;
+    while (!g_woken) {
+        if (!runNext(deadline)) {
+            if (deadline != UINT64_MAX) g_now = deadline;
+            break;
+        }
+    }
+    g_sleeping = false;
+    g_slept += g_now - start;
+    g_hostMarked = false;
+    return SleepResult{g_woken, g_woken ? g_wakePin : (Pin)0};
+}
+
+bool isSleeping() {
+    return g_sleeping;
+}
+
+uint64_t sleptNs() {
+    return g_slept;
+}
+
+void attachI2C(I2CDevice* device) {
+    g_i2c[device->address] = device;
+}
+
+void detachI2C(I2CDevice* device) {
+    auto it = g_i2c.find(device->address);
+    if (it != g_i2c.end() && it->second == device) g_i2c.erase(it);
+}
+
+void setI2CClock(uint32_t hz) {
+    if (hz) g_i2cHz = hz;
+}
+
+uint8_t i2cWrite(uint8_t address, const uint8_t* data, size_t len, bool stop, uint32_t timeoutMs) {
+    (void)timeoutMs;
+    BusStats& st = g_i2cStats[address];
+    st.transfers++;
+    if (g_stuck.active && level(g_stuck.sda) == 0) {
+        // SDA held low: the master loses arbitration on its first high bit
+        st.busyNs += i2cNs(0);
+        st.nacks++;
+        advanceNs(i2cNs(0));
+        return 1;
+    }
+    auto it = g_i2c.find(address);
+    if (it == g_i2c.end()) {
+        st.busyNs += i2cNs(0);
+        st.nacks++;
+        advanceNs(i2cNs(0));
+        return 3;
+    }
+    uint64_t ns = i2cNs(len);
+    st.busyNs += ns;
+    st.bytes += len + 1;
+    advanceNs(ns);
+    if (!it->second->write(data, len, stop)) {
+        st.nacks++;
+        return 3;
+    }
+    return 0;
+}
+
+size_t i2cRead(uint8_t address, uint8_t* data, size_t len, bool stop, uint32_t timeoutMs) {
+    (void)timeoutMs;
+    BusStats& st = g_i2cStats[address];
+    st.transfers++;
+    auto it = g_i2c.end();
+    if (!g_stuck.active || level(g_stuck.sda) != 0) it = g_i2c.find(address);
+    if (it == g_i2c.end()) {
+        st.busyNs += i2cNs(0);
+        st.nacks++;
+        advanceNs(i2cNs(0));
+        return 0;
+    }
+    size_t n = it->second->read(data, len, stop);
+    uint64_t ns = i2cNs(n);
+    st.busyNs += ns;
+    st.bytes += n + 1;
+    advanceNs(ns);
+    return n;
+}
+
+void i2cHoldSda(Pin sda, Pin scl, uint8_t clocks) {
+    g_stuck.active = true;
+    g_stuck.sda = sda;
+    g_stuck.left = clocks ? clocks : 1;
+    drive(sda, 0);
+    if (g_stuck.watching) return;
+    g_stuck.watching = true;
+    watch(scl, [](int level) {
+        if (!g_stuck.active || !level) return;
+        if (--g_stuck.left == 0) {
+            g_stuck.active = false;
+            drive(g_stuck.sda, -1);
+        }
+    });
+}
+
+const std::map<uint8_t, BusStats>& i2cStats() {
+    return g_i2cStats;
+}
+
+void resetI2CStats() {
+    g_i2cStats.clear();
+}
+
+void attachSPI(SPIDevice* device) {
+    g_spi.push_back(device);
+}
+
+void detachSPI(SPIDevice* device) {
+    for (size_t i = 0; i < g_spi.size(); i++) {
+        if (g_spi[i] == device) {
+            g_spi.erase(g_spi.begin() + i);
+            return;
+        }
+    }
+}
+
+void spiTransfer(const uint8_t* tx, uint8_t* rx, size_t len, uint32_t clockHz, bool dma) {
+    SPIDevice* device = nullptr;
+    for (SPIDevice* d : g_spi) {
+        if (level(d->cs) == 0) {
+            device = d;
+            break;
+        }
+    }
+    for (size_t i = 0; i < len; i++) {
+        uint8_t in = device ? device->transfer(tx ? tx[i] : 0xFF, clockHz) : 0xFF;
+        if (rx) rx[i] = in;
+    }
+    // Wire time plus the driver overhead: per call for DMA, per byte otherwise
+    uint64_t ns = (uint64_t)len * 8 * 1000000000ull / (clockHz ? clockHz : 1);
+    ns += dma ? 2000 : 150 * len;
+    g_spiStats.busyNs += ns;
+    g_spiStats.bytes += len;
+    advanceNs(ns);
+}
+
+const SpiStats& spiStats() {
+    return g_spiStats;
+}
+
+} // namespace sim
@@ -0,0 +1,182 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// =====================================================
+// Host simulation core behind the Particle HAL shim:
+// a virtual clock with an event queue, GPIO levels and
+// interrupts, and the I2C and SPI buses the device
+// models attach to. Single threaded; time only moves
+// inside HAL calls.
+// =====================================================
+
+namespace sim {
+
+typedef uint16_t Pin;
+
+// Thrown by System.reset() and HIBERNATE sleep: the firmware run is over
+struct Reset : std::runtime_error {
+    explicit Reset(const char* why) : std::runtime_error(why) {}
+};
+
+// ---- Clock ----
+
+uint64_t nowNs();
+inline uint64_t nowUs() { return nowNs() / 1000; }
+inline uint64_t nowMs() { return nowNs() / 1000000; }
+
+// Move time forward, dispatching every event that falls due
+void advanceNs(uint64_t ns);
+void runUntilNs(uint64_t t);
+
+// Host CPU time spent in firmware code between HAL calls is charged to the
+// virtual clock times this factor (the target is slower); 0 makes runs
+// fully deterministic. Every HAL call also costs callNs.
+void setCpuScale(double scale);
+void setHalCallNs(uint32_t ns);
+
+// Entered by every HAL function: charges firmware CPU time and the call cost
+class HalCall {
+public:
+    HalCall();
+    ~HalCall();
+};
+
+// ---- Events ----
+
+typedef uint32_t EventId;
+
+// 'cpu' events (software timers) do not run while the MCU sleeps
+EventId schedule(uint64_t atNs, std::function<void()> fn, bool cpu = false);
+inline EventId scheduleIn(uint64_t delayNs, std::function<void()> fn, bool cpu = false) {
+    return schedule(nowNs() + delayNs, fn, cpu);
+}
+void cancel(EventId id);
+
+// ---- GPIO ----
+
+enum class Mode : int8_t { Unset = -1, Input, Output, InputPullup, InputPulldown, OutputOpenDrain };
+
+// Drive an input from outside (device model); -1 releases it to the pull
+void drive(Pin pin, int level);
+int level(Pin pin);
+Mode mode(Pin pin);
+
+// Times a push-pull output was driven against an external driver, a short
+// on the real board (open-drain lines must use OutputOpenDrain)
+uint32_t contentions();
+
+// Called on every level change of the pin (models watch RST, CS, SCL...)
+void watch(Pin pin, std::function<void(int level)> fn);
+
+// Firmware side, used by the wiring shim
+void setMode(Pin pin, Mode mode);
+void write(Pin pin, int level);
+void attachIsr(Pin pin, std::function<void()> isr, int edge);  // edge: 0 CHANGE, 1 RISING, 2 FALLING
+void detachIsr(Pin pin);
+void setInterrupts(bool enabled);
+
+// ---- Sleep ----
+
+struct WakePin {
+    Pin pin;
+    int edge;
+};
+
+struct SleepResult {
+    bool byPin;
+    Pin pin;
+};
+
+// Run until durationMs passes or a wake pin sees its edge; ISRs and cpu
+// events are held off meanwhile
+SleepResult sleep(const WakePin* pins, size_t count, uint32_t durationMs);
+bool isSleeping();
+uint64_t sleptNs();
+
+// ---- I2C ----
+
+class I2CDevice {
+public:
+    explicit I2CDevice(uint8_t address) : address(address) {}
+    virtual ~I2CDevice() {}
+    // Master write of len bytes (0 = address only); false NACKs
+    virtual bool write(const uint8_t* data, size_t len, bool stop) = 0;
+    // Master read, returns the bytes the device supplied
+    virtual size_t read(uint8_t* data, size_t len, bool stop) = 0;
+    const uint8_t address;
+};
+
+struct BusStats {
+    uint64_t busyNs;
+    uint32_t transfers;
+    uint32_t bytes;
+    uint32_t nacks;
+};
+
+void attachI2C(I2CDevice* device);
+void detachI2C(I2CDevice* device);
+void setI2CClock(uint32_t hz);
+
+// Wire.endTransmission()/requestFrom() results; 0 is success
+uint8_t i2cWrite(uint8_t address, const uint8_t* data, size_t len, bool stop, uint32_t timeoutMs);
+size_t i2cRead(uint8_t address, uint8_t* data, size_t len, bool stop, uint32_t timeoutMs);
+
+// A slave stuck mid-byte holds SDA low until SCL is clocked 'clocks' times
+void i2cHoldSda(Pin sda, Pin scl, uint8_t clocks);
+
+const std::map<uint8_t, BusStats>& i2cStats();
+void resetI2CStats();
+
+// ---- SPI ----
+
+class SPIDevice {
+public:
+    explicit SPIDevice(Pin cs) : cs(cs) {}
+    virtual ~SPIDevice() {}
+    virtual uint8_t transfer(uint8_t out, uint32_t clockHz) = 0;
+    const Pin cs;
+};
+
+void attachSPI(SPIDevice* device);
+void detachSPI(SPIDevice* device);
+void spiTransfer(const uint8_t* tx, uint8_t* rx, size_t len, uint32_t clockHz, bool dma);
+
+struct SpiStats {
+    uint64_t busyNs;
+    uint64_t bytes;
+};
+const SpiStats& spiStats();
+
+// ---- Device OS ----
+
+struct CloudConfig {
+    bool reachable = true;
+    uint32_t connectMs = 3000;    // Particle.connect() to connected
+    uint32_t publishMs = 250;     // Publish round trip
+    bool failPublishes = false;
+};
+
+struct Publish {
+    std::string name;
+    std::string data;
+    uint64_t atNs;
+    bool succeeded;
+};
+
+CloudConfig& cloud();
+const std::vector<Publish>& published();
+
+void setFreeMemory(uint32_t bytes);
+void setSerialEcho(bool echo);      // Firmware Serial/Log output to stdout
+
+} // namespace sim
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "Particle.h"
+
+// Transfer options, as Device OS 3.x
+class WireTransmission {
+public:
+    explicit WireTransmission(uint8_t address) : _address(address) {}
+    WireTransmission& quantity(size_t size) { _quantity = size; return *this; }
+    WireTransmission& timeout(system_tick_t ms) { _timeout = ms; return *this; }
+    WireTransmission& timeout(std::chrono::milliseconds ms) { return timeout((system_tick_t)ms.count()); }
+    WireTransmission& stop(bool stop) { _stop = stop; return *this; }
+
+    uint8_t getAddress() const { return _address; }
+    size_t getQuantity() const { return _quantity; }
+    system_tick_t getTimeout() const { return _timeout; }
+    bool getStop() const { return _stop; }
+
+private:
+    uint8_t _address;
+    size_t _quantity = 0;
+    system_tick_t _timeout = 100;
+    bool _stop = true;
+};
+
+class TwoWire : public Stream {
+public:
+    void setSpeed(uint32_t clockHz);
+    void begin();
+    void end();
+    bool isEnabled() const { return _enabled; }
+
+    void beginTransmission(uint8_t address) { beginTransmission(WireTransmission(address)); }
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+    void beginTransmission(const WireTransmission& transmission);
+    uint8_t endTransmission(uint8_t sendStop = true);
+
+    size_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = true) {
+        return requestFrom(WireTransmission(address).quantity(quantity).stop(sendStop));
+    }
+    size_t requestFrom(int address, int quantity, int sendStop = true) {
+        return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)sendStop);
+    }
+    size_t requestFrom(const WireTransmission& transmission);
+
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* data, size_t quantity) override;
+    using Print::write;
+    size_t write(int data) { return write((uint8_t)data); }
+    size_t write(unsigned int data) { return write((uint8_t)data); }
+    size_t write(long data) { return write((uint8_t)data); }
+    size_t write(unsigned long data) { return write((uint8_t)data); }
+    int available() override { return (int)(_rxLen - _rxPos); }
+    int read() override { return _rxPos < _rxLen ? _rx[_rxPos++] : -1; }
+    int peek() override { return _rxPos < _rxLen ? _rx[_rxPos] : -1; }
+    void flush() override {}
+
+    bool lock() { _locks++; return true; }
+    bool unlock() { if (_locks) _locks--; return true; }
+    void reset();
+
+private:
+    void acquireBuffers();
+
+    bool _enabled = false;
+    int _locks = 0;
+    uint32_t _clockHz = 100000;
+    std::unique_ptr<uint8_t[]> _rxOwned;
+    std::unique_ptr<uint8_t[]> _txOwned;
+    uint8_t* _rx = nullptr;
+    uint8_t* _tx = nullptr;
+    size_t _rxSize = 0;
+    size_t _txSize = 0;
+    size_t _rxLen = 0;
+    size_t _rxPos = 0;
+    size_t _txLen = 0;
+    bool _txOverflow = false;
+    WireTransmission _transmission{0};
+};
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,215 @@
+#include "Particle.h"
+#include "Sim.h"
+
+// Firmware hook for larger Wire buffers; the default is 32 bytes like Device OS
+hal_i2c_config_t __attribute__((weak)) acquireWireBuffer();
+
+#define WIRE_DEFAULT_BUFFER_SIZE  32
+
+TwoWire Wire;
+SPIClass SPI;
+
+// ---- GPIO ----
+
+void pinMode(pin_t pin, PinMode mode) {
+    sim::HalCall hal;
+    static const sim::Mode modes[] = {
+        sim::Mode::Input, sim::Mode::Output, sim::Mode::InputPullup, sim::Mode::InputPulldown,
+        sim::Mode::OutputOpenDrain
+    };
+    sim::setMode(pin, modes[mode]);
+}
+
+void digitalWrite(pin_t pin, uint8_t value) {
+    sim::HalCall hal;
+    sim::write(pin, value);
+}
+
+int32_t digitalRead(pin_t pin) {
+    sim::HalCall hal;
+    return sim::level(pin);
+}
+
+int32_t analogRead(pin_t pin) {
+    sim::HalCall hal;
+    return sim::level(pin) ? 4095 : 0;
+}
+
+void tone(pin_t pin, unsigned int frequency, unsigned long duration) {
+    sim::HalCall hal;
+    (void)pin;
+    (void)frequency;
+    (void)duration;
+}
+
+void noTone(pin_t pin) {
+    sim::HalCall hal;
+    (void)pin;
+}
+
+bool attachInterrupt(pin_t pin, std::function<void()> handler, InterruptMode mode,
+                     int8_t priority, uint8_t subpriority) {
+    sim::HalCall hal;
+    (void)priority;
+    (void)subpriority;
+    sim::attachIsr(pin, handler, mode == CHANGE ? 0 : mode == RISING ? 1 : 2);
+    return true;
+}
+
+bool detachInterrupt(pin_t pin) {
+    sim::HalCall hal;
+    sim::detachIsr(pin);
+    return true;
+}
+
+void interrupts() {
+    sim::setInterrupts(true);
+}
+
+void noInterrupts() {
+    sim::setInterrupts(false);
+}
+
+ParticleAtomicBlock::ParticleAtomicBlock() {
+    sim::setInterrupts(false);
+}
+
+ParticleAtomicBlock::~ParticleAtomicBlock() {
+    sim::setInterrupts(true);
+}
+
+// ---- Time ----
+
+system_tick_t millis() {
+    sim::HalCall hal;
+    return (system_tick_t)sim::nowMs();
+}
+
+unsigned long micros() {
+    sim::HalCall hal;
+    // 32-bit like the target, so wrap-around handling is exercised
+    return (uint32_t)sim::nowUs();
+}
+
+void delay(unsigned long ms) {
+    sim::HalCall hal;
+    sim::advanceNs((uint64_t)ms * 1000000ull);
+}
+
+void delayMicroseconds(unsigned int us) {
+    sim::HalCall hal;
+    sim::advanceNs((uint64_t)us * 1000ull);
+}
+
+void yield() {
+    sim::HalCall hal;
+}
+
+// ---- Wire ----
+
+void TwoWire::acquireBuffers() {
+    if (_rx) return;
+    if (acquireWireBuffer) {
+        hal_i2c_config_t config = acquireWireBuffer();
+        if (config.rx_buffer && config.tx_buffer) {
+            _rx = config.rx_buffer;
+            _rxSize = config.rx_buffer_size;
+            _tx = config.tx_buffer;
+            _txSize = config.tx_buffer_size;
+            return;
+        }
+    }
+    _rxOwned.reset(new uint8_t[WIRE_DEFAULT_BUFFER_SIZE]);
+    _txOwned.reset(new uint8_t[WIRE_DEFAULT_BUFFER_SIZE]);
+    _rx = _rxOwned.get();
+    _tx = _txOwned.get();
+    _rxSize = _txSize = WIRE_DEFAULT_BUFFER_SIZE;
+}
+
+void TwoWire::setSpeed(uint32_t clockHz) {
+    _clockHz = clockHz;
+}
+
+void TwoWire::begin() {
+    sim::HalCall hal;
+    acquireBuffers();
+    sim::setI2CClock(_clockHz);
+    _enabled = true;
+}
+
+void TwoWire::end() {
+    sim::HalCall hal;
+    _enabled = false;
+}
+
+void TwoWire::reset() {
+    end();
+    begin();
+}
+
+void TwoWire::beginTransmission(const WireTransmission& transmission) {
+    sim::HalCall hal;
+    _transmission = transmission;
+    _txLen = 0;
+    _txOverflow = false;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (!_tx || _txLen >= _txSize) {
+        _txOverflow = true;
+        return 0;
+    }
+    _tx[_txLen++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity) {
+    size_t n = 0;
+    while (n < quantity && write(data[n])) n++;
+    return n;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop) {
+    sim::HalCall hal;
+    if (!_enabled) return 1;
+    if (_txOverflow) return 4;
+    uint8_t err = sim::i2cWrite(_transmission.getAddress(), _tx, _txLen, sendStop,
+        _transmission.getTimeout());
+    _txLen = 0;
+    return err;
+}
+
+size_t TwoWire::requestFrom(const WireTransmission& transmission) {
+    sim::HalCall hal;
+    _rxLen = 0;
+    _rxPos = 0;
+    if (!_enabled) return 0;
+    size_t quantity = transmission.getQuantity();
+    if (quantity > _rxSize) quantity = _rxSize;
+    _rxLen = sim::i2cRead(transmission.getAddress(), _rx, quantity, transmission.getStop(),
+        transmission.getTimeout());
+    return _rxLen;
+}
+
+// ---- SPI ----
+
+int32_t SPIClass::beginTransaction(const SPISettings& settings) {
+    sim::HalCall hal;
+    _clock = settings.getClock();
+    return 0;
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    sim::HalCall hal;
+    uint8_t in = 0xFF;
+    sim::spiTransfer(&data, &in, 1, _clock, false);
+    return in;
+}
+
+void SPIClass::transfer(const void* tx, void* rx, size_t length, wiring_spi_dma_transfercomplete_callback_t callback) {
+    {
+        sim::HalCall hal;
+        sim::spiTransfer((const uint8_t*)tx, (uint8_t*)rx, length, _clock, true);
+    }
+    if (callback) callback();
+}
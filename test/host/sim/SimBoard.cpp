@@ -0,0 +1,34 @@
+#include "SimBoard.h"
+
+#include "Particle.h"
+#include "RFID.h"
+#include "Battery.h"
+#include "Charger.h"
+#include "Buttons.h"
+#include "EPD_Display.h"
+
+namespace sim {
+
+static const Pin RF_LINES[4] = {RF_V1, RF_V2, RF_V3, RF_V4};
+
+SimBoard::SimBoard()
+    : pn532(PN532_IRQ, PN532_RST, RF_LINES),
+      gauge(BATT_ALERT_PIN),
+      charger(CHARGER_ACOK_PIN),
+      epd(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY, EPD_SCK, EPD_SDA) {
+    // Buttons idle HIGH on their external pull-ups
+    for (uint8_t b = 1; b <= 4; b++) drive(buttonPin(b), 1);
+}
+
+Pin SimBoard::buttonPin(uint8_t button) {
+    static const Pin pins[4] = {BUTTON_1_PIN, BUTTON_2_PIN, BUTTON_3_PIN, BUTTON_4_PIN};
+    return pins[(button - 1) & 3];
+}
+
+void SimBoard::pressButton(uint8_t button, uint64_t atMs, uint32_t holdMs) {
+    Pin pin = buttonPin(button);
+    schedule(atMs * 1000000ull, [pin]() { drive(pin, 0); });
+    schedule((atMs + holdMs) * 1000000ull, [pin]() { drive(pin, 1); });
+}
+
+} // namespace sim
@@ -0,0 +1,33 @@
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+#include "SimPN532.h"
+#include "SimMAX17049.h"
+#include "SimMP2672A.h"
+#include "SimSSD1677.h"
+
+// =====================================================
+// The BA Reader board: every device model on the pins
+// and addresses the firmware headers define, plus the
+// four active-low buttons.
+// =====================================================
+
+namespace sim {
+
+class SimBoard {
+public:
+    SimBoard();
+
+    SimPN532 pn532;
+    SimMAX17049 gauge;
+    SimMP2672A charger;
+    SimSSD1677 epd;
+
+    // Press button 1-4 at atMs (virtual) for holdMs
+    void pressButton(uint8_t button, uint64_t atMs, uint32_t holdMs);
+    static Pin buttonPin(uint8_t button);
+};
+
+} // namespace sim
+
+#endif
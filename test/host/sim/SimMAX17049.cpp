@@ -0,0 +1,152 @@
+#include "SimMAX17049.h"
+
+namespace sim {
+
+#define MAX17049_ADDRESS    0x36
+
+#define REG_VCELL    0x02
+#define REG_SOC      0x04
+#define REG_MODE     0x06
+#define REG_VERSION  0x08
+#define REG_HIBRT    0x0A
+#define REG_CONFIG   0x0C
+#define REG_VALRT    0x14
+#define REG_CRATE    0x16
+#define REG_VRESET   0x18
+#define REG_STATUS   0x1A
+#define REG_CMD      0xFE
+
+#define CONFIG_ALSC  0x0040
+#define CONFIG_ALRT  0x0020
+#define STATUS_SC    0x2000
+#define STATUS_RI    0x0100
+
+// The IC updates VCELL/SOC once a second in active mode
+#define TICK_NS      1000000000ull
+
+// Two Li-ion cells: 6.4 V empty to 8.4 V full, linear enough here
+#define PACK_EMPTY_V 6.4
+#define PACK_FULL_V  8.4
+
+SimMAX17049::SimMAX17049(Pin alert) : I2CDevice(MAX17049_ADDRESS), _alert(alert) {
+    setReg(REG_MODE, 0x0000);
+    setReg(REG_VERSION, 0x0012);
+    setReg(REG_HIBRT, 0x8030);
+    setReg(REG_CONFIG, 0x971C);
+    setReg(REG_VALRT, 0x00FF);
+    setReg(REG_VRESET, 0x9600);
+    setReg(REG_STATUS, STATUS_RI);
+    _socAtNs = nowNs();
+    tick();
+    attachI2C(this);
+}
+
+SimMAX17049::~SimMAX17049() {
+    if (_tick) cancel(_tick);
+    detachI2C(this);
+}
+
+void SimMAX17049::setSoC(double percent) {
+    _soc = percent;
+    _socAtNs = nowNs();
+    _alertedSoc = -1;
+    tick();
+}
+
+void SimMAX17049::setRate(double percentPerHour) {
+    _soc = getSoC();
+    _socAtNs = nowNs();
+    _rate = percentPerHour;
+    tick();
+}
+
+double SimMAX17049::getSoC() const {
+    double soc = _soc + _rate * (double)(nowNs() - _socAtNs) / 3.6e12;
+    return soc < 0 ? 0 : soc > 100 ? 100 : soc;
+}
+
+double SimMAX17049::getVoltage() const {
+    if (_voltageOverride >= 0) return _voltageOverride;
+    return PACK_EMPTY_V + (PACK_FULL_V - PACK_EMPTY_V) * getSoC() / 100.0;
+}
+
+void SimMAX17049::setVoltageOverride(double volts) {
+    _voltageOverride = volts;
+    tick();
+}
+
+uint16_t SimMAX17049::reg(uint8_t address) const {
+    return _regs[(address >> 1) & 0x7F];
+}
+
+void SimMAX17049::setReg(uint8_t address, uint16_t value) {
+    _regs[(address >> 1) & 0x7F] = value;
+}
+
+void SimMAX17049::tick() {
+    if (_tick) cancel(_tick);
+    double soc = getSoC();
+    // VCELL: 10.24 V full scale over 16 bits; SOC: 1/256 % per LSB; CRATE: 0.208 %/h per LSB
+    setReg(REG_VCELL, (uint16_t)(getVoltage() / 10.24 * 65536.0));
+    setReg(REG_SOC, (uint16_t)(soc * 256.0));
+    setReg(REG_CRATE, (uint16_t)(int16_t)(_rate / 0.208));
+    updateAlert();
+    _tick = scheduleIn(TICK_NS, [this]() {
+        _tick = 0;
+        tick();
+    });
+}
+
+void SimMAX17049::updateAlert() {
+    int whole = (int)getSoC();
+    if (_alertedSoc < 0) _alertedSoc = whole;
+    if ((reg(REG_CONFIG) & CONFIG_ALSC) && whole != _alertedSoc) {
+        _alertedSoc = whole;
+        setReg(REG_STATUS, reg(REG_STATUS) | STATUS_SC);
+        if (!(reg(REG_CONFIG) & CONFIG_ALRT)) _alerts++;
+        setReg(REG_CONFIG, reg(REG_CONFIG) | CONFIG_ALRT);
+    }
+    // Open drain, asserted while CONFIG.ALRT is set
+    drive(_alert, (reg(REG_CONFIG) & CONFIG_ALRT) ? 0 : -1);
+}
+
+bool SimMAX17049::write(const uint8_t* data, size_t len, bool stop) {
+    (void)stop;
+    if (len == 0) return true;
+    _pointer = data[0];
+    for (size_t i = 1; i + 1 < len; i += 2) {
+        uint8_t address = _pointer;
+        uint16_t value = (data[i] << 8) | data[i + 1];
+        _pointer += 2;
+        switch (address) {
+            case REG_VCELL:
+            case REG_SOC:
+            case REG_VERSION:
+            case REG_CRATE:
+                break;                  // Read only
+            case REG_MODE:
+                if (value & 0x4000) _alertedSoc = -1;   // Quick-start
+                break;
+            case REG_CMD:
+                if (value == 0x5400) setReg(REG_STATUS, STATUS_RI);   // Power-on reset
+                break;
+            default:
+                setReg(address, value);
+                break;
+        }
+    }
+    updateAlert();
+    return true;
+}
+
+size_t SimMAX17049::read(uint8_t* data, size_t len, bool stop) {
+    (void)stop;
+    for (size_t i = 0; i < len; i++) {
+        uint16_t value = reg(_pointer);
+        data[i] = (i & 1) ? (value & 0xFF) : (value >> 8);
+        if (i & 1) _pointer += 2;
+    }
+    return len;
+}
+
+} // namespace sim
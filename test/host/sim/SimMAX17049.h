@@ -0,0 +1,52 @@
+#ifndef SIM_MAX17049_H
+#define SIM_MAX17049_H
+
+#include "Sim.h"
+
+// =====================================================
+// MAX17049 2-cell fuel gauge (0x36): 16-bit big-endian
+// registers with an auto-incrementing pointer, a pack
+// that charges or discharges at a set rate, and the
+// open-drain ALRT line for the 1% SOC-change alert.
+// =====================================================
+
+namespace sim {
+
+class SimMAX17049 : public I2CDevice {
+public:
+    explicit SimMAX17049(Pin alert);
+    ~SimMAX17049();
+
+    // Pack state: SOC in %, rate in %/h (negative discharges)
+    void setSoC(double percent);
+    void setRate(double percentPerHour);
+    double getSoC() const;
+    double getVoltage() const;           // Open-circuit voltage for the SOC
+    void setVoltageOverride(double volts);  // < 0 follows the SOC again
+
+    uint32_t alerts() const { return _alerts; }
+
+    bool write(const uint8_t* data, size_t len, bool stop) override;
+    size_t read(uint8_t* data, size_t len, bool stop) override;
+
+private:
+    uint16_t reg(uint8_t address) const;
+    void setReg(uint8_t address, uint16_t value);
+    void tick();
+    void updateAlert();
+
+    Pin _alert;
+    uint8_t _pointer = 0;
+    uint16_t _regs[128] = {};
+    double _soc = 80.0;
+    uint64_t _socAtNs = 0;
+    double _rate = 0;
+    double _voltageOverride = -1;
+    int _alertedSoc = -1;
+    uint32_t _alerts = 0;
+    EventId _tick = 0;
+};
+
+} // namespace sim
+
+#endif
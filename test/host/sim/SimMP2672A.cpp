@@ -0,0 +1,60 @@
+#include "SimMP2672A.h"
+
+namespace sim {
+
+#define MP2672A_ADDRESS  0x4B
+#define REG03_STATUS     0x03
+#define REG04_FAULT      0x04
+#define CHG_STAT_SHIFT   4
+#define VIN_STAT         0x04
+
+SimMP2672A::SimMP2672A(Pin acok) : I2CDevice(MP2672A_ADDRESS), _acok(acok) {
+    drive(_acok, 1);
+    attachI2C(this);
+}
+
+SimMP2672A::~SimMP2672A() {
+    detachI2C(this);
+}
+
+void SimMP2672A::setPower(bool present) {
+    _power = present;
+    uint8_t status = _regs[REG03_STATUS] & ~VIN_STAT;
+    if (present) {
+        status |= VIN_STAT;
+    } else {
+        status &= ~(3 << CHG_STAT_SHIFT);    // No charging without input
+    }
+    _regs[REG03_STATUS] = status;
+    drive(_acok, present ? 0 : 1);
+}
+
+void SimMP2672A::setPhase(Phase phase) {
+    _regs[REG03_STATUS] = (_regs[REG03_STATUS] & ~(3 << CHG_STAT_SHIFT)) |
+        ((uint8_t)phase << CHG_STAT_SHIFT);
+}
+
+void SimMP2672A::setFaults(uint8_t faults) {
+    _regs[REG04_FAULT] = faults & 0xF8;
+}
+
+bool SimMP2672A::write(const uint8_t* data, size_t len, bool stop) {
+    (void)stop;
+    if (len == 0) return true;
+    _pointer = data[0];
+    for (size_t i = 1; i < len; i++, _pointer++) {
+        // REG03 and REG04 are read only
+        if (_pointer < REG03_STATUS) _regs[_pointer] = data[i];
+    }
+    return true;
+}
+
+size_t SimMP2672A::read(uint8_t* data, size_t len, bool stop) {
+    (void)stop;
+    for (size_t i = 0; i < len; i++, _pointer++) {
+        data[i] = _pointer < sizeof(_regs) ? _regs[_pointer] : 0x00;
+    }
+    return len;
+}
+
+} // namespace sim
@@ -0,0 +1,38 @@
+#ifndef SIM_MP2672A_H
+#define SIM_MP2672A_H
+
+#include "Sim.h"
+
+// =====================================================
+// MP2672A 2-cell charger (0x4B): REG00-REG04 behind an
+// auto-incrementing pointer, and the ACOK line (LOW while
+// external power is present).
+// =====================================================
+
+namespace sim {
+
+class SimMP2672A : public I2CDevice {
+public:
+    enum class Phase : uint8_t { NotCharging = 0, PreCharge = 1, FastCharge = 2, Done = 3 };
+
+    explicit SimMP2672A(Pin acok);
+    ~SimMP2672A();
+
+    void setPower(bool present);       // Drives ACOK
+    bool hasPower() const { return _power; }
+    void setPhase(Phase phase);
+    void setFaults(uint8_t faults);    // REG04 bits 3-7
+
+    bool write(const uint8_t* data, size_t len, bool stop) override;
+    size_t read(uint8_t* data, size_t len, bool stop) override;
+
+private:
+    Pin _acok;
+    bool _power = false;
+    uint8_t _pointer = 0;
+    uint8_t _regs[5] = {0x4B, 0x08, 0x9C, 0x00, 0x00};
+};
+
+} // namespace sim
+
+#endif
@@ -0,0 +1,400 @@
+#include "SimPN532.h"
+
+#include <string.h>
+
+namespace sim {
+
+static const uint8_t ACK_FRAME[6] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+
+// PE42412A truth table: V1..V4 levels (bit0=V1) to the antenna switched in
+static const uint8_t LINES_TO_ANTENNA[16] = {
+    1, 9, 5, 0, 3, 11, 7, 0, 2, 10, 6, 0, 4, 12, 8, 0
+};
+
+#define PN532_ADDRESS       0x24
+#define AUTOPOLL_PERIOD_NS  150000000ull
+
+SimPN532::SimPN532(Pin irq, Pin rst, const Pin rfLines[4])
+    : I2CDevice(PN532_ADDRESS), _irq(irq), _rst(rst) {
+    memcpy(_rf, rfLines, sizeof(_rf));
+    _state = State::Idle;
+    setIrq(false);
+    watch(_rst, [this](int level) { onRst(level); });
+    attachI2C(this);
+}
+
+SimPN532::~SimPN532() {
+    cancelPending();
+    detachI2C(this);
+}
+
+int SimPN532::addCard(uint8_t antenna, const uint8_t* uid, uint8_t uidLength, uint64_t atNs,
+                      uint64_t removeNs, bool ntag) {
+    Card c = {};
+    c.uidLength = uidLength > sizeof(c.uid) ? sizeof(c.uid) : uidLength;
+    memcpy(c.uid, uid, c.uidLength);
+    // NTAG215: ATQA 00 44, SAK 00; otherwise MIFARE Classic 1K: ATQA 00 04, SAK 08
+    c.atqa[0] = 0x00;
+    c.atqa[1] = ntag ? 0x44 : 0x04;
+    c.sak = ntag ? 0x00 : 0x08;
+    c.ntag = ntag;
+    c.antenna = antenna;
+    c.placedNs = atNs;
+    c.removedNs = removeNs ? removeNs : UINT64_MAX;
+    for (size_t i = 0; i < sizeof(c.memory); i++) {
+        c.memory[i] = (uint8_t)(i ^ c.uid[0]);
+    }
+    _cards.push_back(c);
+    return (int)_cards.size() - 1;
+}
+
+void SimPN532::removeCard(int index, uint64_t atNs) {
+    if (index >= 0 && (size_t)index < _cards.size()) _cards[index].removedNs = atNs;
+}
+
+uint8_t SimPN532::selectedAntenna() const {
+    uint8_t lines = 0;
+    for (int i = 0; i < 4; i++) {
+        if (level(_rf[i])) lines |= 1 << i;
+    }
+    return LINES_TO_ANTENNA[lines];
+}
+
+void SimPN532::resetStats() {
+    for (CommandStats& st : _stats) st = CommandStats();
+    _framesIn = 0;
+    _aborts = 0;
+    _errors = 0;
+}
+
+bool SimPN532::present(const Card& c, uint64_t atNs) const {
+    return c.placedNs <= atNs && atNs < c.removedNs;
+}
+
+void SimPN532::setIrq(bool asserted) {
+    // Active low
+    drive(_irq, asserted ? 0 : 1);
+}
+
+void SimPN532::cancelPending() {
+    if (_pending) cancel(_pending);
+    _pending = 0;
+}
+
+void SimPN532::onRst(int level) {
+    cancelPending();
+    setIrq(false);
+    _state = State::Reset;
+    if (!level) return;
+    _pending = scheduleIn(_timing.bootNs, [this]() {
+        _pending = 0;
+        _state = State::Idle;
+        _retries = 0xFF;
+    });
+}
+
+bool SimPN532::write(const uint8_t* data, size_t len, bool stop) {
+    (void)stop;
+    if (_state == State::Reset) return false;
+
+    if (_state == State::PowerDown) {
+        // The address match wakes it; the frame itself is lost
+        if (!(_wakeSources & 0x80)) return false;
+        _state = State::Reset;
+        _pending = scheduleIn(_timing.wakeNs, [this]() {
+            _pending = 0;
+            _state = State::Idle;
+            if (_wakeIrq) setIrq(true);
+        });
+        return true;
+    }
+    if (len == 0) return true;
+
+    if (len >= 6 && memcmp(data, ACK_FRAME, 6) == 0) {
+        // ACK from the host aborts the command in progress
+        if (_state != State::Idle) {
+            cancelPending();
+            _state = State::Idle;
+            setIrq(false);
+            _aborts++;
+        }
+        return true;
+    }
+
+    // 00 00 FF LEN LCS D4 cmd... DCS 00
+    if (len < 8 || data[0] != 0x00 || data[1] != 0x00 || data[2] != 0xFF) {
+        _errors++;
+        return true;
+    }
+    uint8_t frameLen = data[3];
+    if ((uint8_t)(frameLen + data[4]) != 0 || frameLen < 2 || (size_t)frameLen + 7 > len ||
+        data[5] != 0xD4) {
+        _errors++;
+        return true;
+    }
+    uint8_t sum = 0;
+    for (uint8_t i = 0; i < frameLen; i++) sum += data[5 + i];
+    if ((uint8_t)(sum + data[5 + frameLen]) != 0) {
+        _errors++;
+        return true;
+    }
+    startCommand(data + 6, frameLen - 1);
+    return true;
+}
+
+size_t SimPN532::read(uint8_t* data, size_t len, bool stop) {
+    (void)stop;
+    if (_state == State::Reset || len == 0) return 0;
+    if (_state == State::PowerDown) {
+        write(nullptr, 0, true);
+        return 0;
+    }
+
+    memset(data, 0, len);
+    bool wakeIrq = _state == State::Idle && level(_irq) == 0;
+    if (_state == State::AckReady) {
+        data[0] = 0x01;
+        memcpy(data + 1, ACK_FRAME, len - 1 < 6 ? len - 1 : 6);
+        setIrq(false);
+        if (len < 7) return len;        // Status poll only
+        _state = State::Running;
+        execute();
+    } else if (_state == State::ResponseReady) {
+        data[0] = 0x01;
+        memcpy(data + 1, _out, len - 1 < _outLen ? len - 1 : _outLen);
+        if (len < 2) return len;
+        setIrq(false);
+        for (int i : _inFrame) {
+            if (_cards[i].detectedNs == 0) _cards[i].detectedNs = nowNs();
+        }
+        _inFrame.clear();
+        _state = _command == 0x16 ? State::PowerDown : State::Idle;
+    } else if (wakeIrq) {
+        // Status read releases the wake-up IRQ
+        setIrq(false);
+    }
+    return len;
+}
+
+void SimPN532::startCommand(const uint8_t* data, uint8_t len) {
+    if (_state != State::Idle) {
+        // The host must abort with an ACK first; the real part drops one or the other
+        cancelPending();
+        _errors++;
+    }
+    _framesIn++;
+    _command = data[0];
+    _argLen = len - 1 < (int)sizeof(_args) ? len - 1 : sizeof(_args);
+    memcpy(_args, data + 1, _argLen);
+    _commandNs = nowNs();
+    _inFrame.clear();
+    _state = State::Running;
+    setIrq(false);
+    _pending = scheduleIn(_timing.ackNs, [this]() {
+        _pending = 0;
+        _state = State::AckReady;
+        setIrq(true);
+    });
+}
+
+void SimPN532::execute() {
+    // The command has been running since the frame came in; the response is
+    // due once its RF time has passed, but not before the ACK was read
+    uint64_t readyAt = _commandNs;
+    uint8_t antenna = selectedAntenna();
+    uint8_t cards = 0;
+    for (const Card& c : _cards) {
+        if (c.antenna == antenna && present(c, nowNs())) cards++;
+    }
+
+    switch (_command) {
+        case 0x4A: {
+            uint8_t maxTg = _args[0] > 2 ? 2 : _args[0];
+            if (cards > maxTg) cards = maxTg;
+            if (cards > 0) {
+                readyAt += _timing.selectNs * cards;
+            } else if (_retries == 0xFF) {
+                return;                 // Retries forever, only an abort ends it
+            } else {
+                readyAt += _timing.activationNs * (_retries + 1);
+            }
+            break;
+        }
+        case 0x60:
+            _pollRoundsLeft = _args[0];
+            _pollPeriod = _args[1] ? _args[1] : 1;
+            readyAt += cards ? _timing.selectNs * cards : _timing.activationNs;
+            _pending = schedule(readyAt > nowNs() ? readyAt : nowNs(), [this]() {
+                _pending = 0;
+                autoPollRound();
+            });
+            return;
+        case 0x40:
+        case 0x42:
+            readyAt += _timing.exchangeNs;
+            break;
+        default:
+            readyAt += _timing.commandNs;
+            break;
+    }
+
+    _pending = schedule(readyAt > nowNs() ? readyAt : nowNs(), [this]() {
+        _pending = 0;
+        uint8_t out[140];
+        uint8_t n = 0;
+        out[n++] = _command + 1;
+        switch (_command) {
+            case 0x32:
+                // CfgItem 5: MxRtyATR, MxRtyPSL, MxRtyPassiveActivation
+                if (_args[0] == 0x05 && _argLen >= 4) _retries = _args[3];
+                break;
+            case 0x4A:
+                n += listTargets(out + n, _args[0] > 2 ? 2 : _args[0], false);
+                break;
+            case 0x16:
+                _wakeSources = _args[0];
+                _wakeIrq = _argLen > 1 && _args[1];
+                out[n++] = 0x00;
+                break;
+            case 0x40:
+                n += exchange(_args + 1, _argLen - 1, out + n);
+                break;
+            case 0x42:
+                n += exchange(_args, _argLen, out + n);
+                break;
+            default:
+                break;
+        }
+        respond(out, n);
+    });
+}
+
+void SimPN532::autoPollRound() {
+    uint8_t out[140];
+    uint8_t n = 0;
+    out[n++] = 0x61;
+    uint8_t found = listTargets(out + n, 2, true);
+    if (out[n] > 0 || _pollRoundsLeft <= 1) {
+        respond(out, n + found);
+        return;
+    }
+    if (_pollRoundsLeft != 0xFF) _pollRoundsLeft--;
+    _pending = scheduleIn(_pollPeriod * AUTOPOLL_PERIOD_NS + _timing.activationNs, [this]() {
+        _pending = 0;
+        autoPollRound();
+    });
+}
+
+uint8_t SimPN532::listTargets(uint8_t* out, uint8_t maxTargets, bool autoPoll) {
+    // NbTg, then per target (InAutoPoll: Type, Len first) Tg SENS_RES[2] SEL_RES len NFCID1
+    uint8_t antenna = selectedAntenna();
+    uint8_t n = 1;
+    uint8_t count = 0;
+    _inFrame.clear();
+    for (size_t i = 0; i < _cards.size() && count < maxTargets; i++) {
+        const Card& c = _cards[i];
+        if (antenna == 0 || c.antenna != antenna || !present(c, nowNs())) continue;
+        if (autoPoll) {
+            out[n++] = 0x10;
+            out[n++] = 5 + c.uidLength;
+        }
+        out[n++] = ++count;
+        out[n++] = c.atqa[0];
+        out[n++] = c.atqa[1];
+        out[n++] = c.sak;
+        out[n++] = c.uidLength;
+        memcpy(out + n, c.uid, c.uidLength);
+        n += c.uidLength;
+        _inFrame.push_back((int)i);
+        if (count == 1) _selected = (int)i;
+    }
+    if (count == 0) _selected = -1;
+    out[0] = count;
+    return n;
+}
+
+uint8_t SimPN532::exchange(const uint8_t* cmd, uint8_t len, uint8_t* out) {
+    // Status byte, then the card's answer
+    if (_selected < 0 || len == 0) {
+        out[0] = 0x01;                  // Timeout, no target
+        return 1;
+    }
+    Card& c = _cards[_selected];
+    if (c.antenna != selectedAntenna() || !present(c, nowNs())) {
+        out[0] = 0x01;
+        return 1;
+    }
+    uint8_t n = 1;
+    out[0] = 0x00;
+    bool thru = _command == 0x42;
+    switch (cmd[0]) {
+        case 0x30: {                    // READ: 16 bytes from the block (Classic) or page (NTAG)
+            size_t at = c.ntag ? cmd[1] * 4u : cmd[1] * 16u;
+            for (int i = 0; i < 16; i++) out[n++] = c.memory[(at + i) % sizeof(c.memory)];
+            break;
+        }
+        case 0x3A: {                    // FAST_READ start..end pages
+            if (!c.ntag || len < 3 || cmd[2] < cmd[1] || (cmd[2] - cmd[1] + 1) * 4 > 120) {
+                out[0] = 0x01;
+                return 1;
+            }
+            for (size_t at = cmd[1] * 4u; at < (cmd[2] + 1u) * 4u; at++) {
+                out[n++] = c.memory[at % sizeof(c.memory)];
+            }
+            break;
+        }
+        case 0x60:
+            if (thru) {                 // GET_VERSION
+                if (!c.ntag) {
+                    out[0] = 0x01;
+                    return 1;
+                }
+                static const uint8_t version[8] = {0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x11, 0x03};
+                memcpy(out + n, version, sizeof(version));
+                n += sizeof(version);
+            }
+            break;                      // MIFARE AUTH_A: default key accepted
+        case 0x61:                      // AUTH_B
+            break;
+        case 0xA0:                      // Classic WRITE 16 bytes
+            if (len >= 18) memcpy(c.memory + (cmd[1] * 16u) % sizeof(c.memory), cmd + 2, 16);
+            break;
+        case 0xA2:                      // Ultralight/NTAG WRITE 4 bytes
+            if (len >= 6) memcpy(c.memory + (cmd[1] * 4u) % sizeof(c.memory), cmd + 2, 4);
+            break;
+        default:
+            out[0] = 0x01;
+            return 1;
+    }
+    return n;
+}
+
+void SimPN532::respond(const uint8_t* data, uint8_t len) {
+    // 00 00 FF LEN LCS D5 data... DCS 00
+    uint8_t n = 0;
+    _out[n++] = 0x00;
+    _out[n++] = 0x00;
+    _out[n++] = 0xFF;
+    _out[n++] = len + 1;
+    _out[n++] = (uint8_t)(0x100 - (len + 1));
+    _out[n++] = 0xD5;
+    uint8_t sum = 0xD5;
+    for (uint8_t i = 0; i < len && n < sizeof(_out) - 2; i++) {
+        _out[n++] = data[i];
+        sum += data[i];
+    }
+    _out[n++] = (uint8_t)(0x100 - sum);
+    _out[n++] = 0x00;
+    _outLen = n;
+
+    CommandStats& st = _stats[_command];
+    uint64_t ns = nowNs() - _commandNs;
+    st.count++;
+    st.totalNs += ns;
+    if (ns > st.maxNs) st.maxNs = ns;
+
+    _state = State::ResponseReady;
+    setIrq(true);
+}
+
+} // namespace sim
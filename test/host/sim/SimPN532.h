@@ -0,0 +1,127 @@
+#ifndef SIM_PN532_H
+#define SIM_PN532_H
+
+#include "Sim.h"
+
+// =====================================================
+// PN532 on I2C (0x24) behind the PE42412A antenna switch:
+// host frames, ACK, IRQ handshake, InListPassiveTarget,
+// InAutoPoll, PowerDown and card data exchange. Cards sit
+// on antennas 1-12 and are seen only while their antenna
+// is switched in when the RF exchange ends.
+// =====================================================
+
+namespace sim {
+
+class SimPN532 : public I2CDevice {
+public:
+    struct Card {
+        uint8_t uid[10];
+        uint8_t uidLength;
+        uint8_t atqa[2];
+        uint8_t sak;
+        bool ntag;                // Answers GET_VERSION / FAST_READ (NTAG215)
+        uint8_t antenna;          // 1-12
+        uint64_t placedNs;
+        uint64_t removedNs;       // UINT64_MAX while present
+        uint64_t detectedNs;      // First response carrying it read by the host, 0 if never
+        uint8_t memory[1024];
+    };
+
+    // RF timing, ns
+    struct Timing {
+        uint64_t ackNs = 600000;               // Frame in to ACK ready
+        uint64_t commandNs = 1000000;          // Configuration commands
+        uint64_t activationNs = 4000000;       // One passive activation attempt without a card
+        uint64_t selectNs = 3000000;           // Anticollision and select per target
+        uint64_t exchangeNs = 2500000;         // One card command round trip
+        uint64_t wakeNs = 1000000;             // Power Down to ready
+        uint64_t bootNs = 10000000;            // Reset released to I2C ready
+    };
+
+    struct CommandStats {
+        uint32_t count = 0;
+        uint64_t totalNs = 0;                  // Command received to response ready
+        uint64_t maxNs = 0;
+    };
+
+    // Host side lines: IRQ (driven here), RSTPDN, and the switch V1-V4
+    SimPN532(Pin irq, Pin rst, const Pin rfLines[4]);
+    ~SimPN532();
+
+    Timing& timing() { return _timing; }
+
+    // Card 'uid' placed on 'antenna' at atNs, removed at removeNs (0 = never)
+    int addCard(uint8_t antenna, const uint8_t* uid, uint8_t uidLength, uint64_t atNs = 0,
+                uint64_t removeNs = 0, bool ntag = false);
+    void removeCard(int index, uint64_t atNs);
+    const Card& card(int index) const { return _cards[index]; }
+    size_t cardCount() const { return _cards.size(); }
+
+    uint8_t selectedAntenna() const;       // From the RF switch lines, 0 = all off
+    bool isPoweredDown() const { return _state == State::PowerDown; }
+    bool isAutoPolling() const { return _command == 0x60 && _state == State::Running; }
+    uint8_t passiveRetries() const { return _retries; }
+
+    const CommandStats& stats(uint8_t command) const { return _stats[command]; }
+    uint32_t framesIn() const { return _framesIn; }
+    uint32_t aborts() const { return _aborts; }
+    uint32_t protocolErrors() const { return _errors; }
+    void resetStats();
+
+    bool write(const uint8_t* data, size_t len, bool stop) override;
+    size_t read(uint8_t* data, size_t len, bool stop) override;
+
+private:
+    enum class State : uint8_t {
+        Reset,          // RSTPDN low or booting
+        Idle,
+        AckReady,       // ACK waiting to be read
+        Running,        // Command executing (RF)
+        ResponseReady,
+        PowerDown
+    };
+
+    bool present(const Card& c, uint64_t atNs) const;
+    void setIrq(bool asserted);
+    void onRst(int level);
+    void startCommand(const uint8_t* data, uint8_t len);
+    void execute();
+    void autoPollRound();
+    void respond(const uint8_t* data, uint8_t len);
+    uint8_t listTargets(uint8_t* out, uint8_t maxTargets, bool autoPoll);
+    uint8_t exchange(const uint8_t* cmd, uint8_t len, uint8_t* out);
+    void cancelPending();
+
+    Pin _irq;
+    Pin _rst;
+    Pin _rf[4];
+    Timing _timing;
+    State _state = State::Reset;
+    EventId _pending = 0;
+
+    uint8_t _command = 0;
+    uint8_t _args[64];
+    uint8_t _argLen = 0;
+    uint64_t _commandNs = 0;       // When the frame came in
+    uint8_t _pollRoundsLeft = 0;   // InAutoPoll, 0xFF endless
+    uint8_t _pollPeriod = 1;
+    uint8_t _retries = 0xFF;
+    uint8_t _wakeSources = 0;
+    bool _wakeIrq = false;
+    int _selected = -1;            // Card addressed by InDataExchange
+
+    uint8_t _out[160];             // Frame the host reads next (after the status byte)
+    uint8_t _outLen = 0;
+    std::vector<int> _inFrame;     // Cards in the response being read
+
+    std::vector<Card> _cards;
+    CommandStats _stats[256];
+    uint32_t _framesIn = 0;
+    uint32_t _aborts = 0;
+    uint32_t _errors = 0;
+};
+
+} // namespace sim
+
+#endif
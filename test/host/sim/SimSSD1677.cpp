@@ -0,0 +1,218 @@
+#include "SimSSD1677.h"
+
+#include <string.h>
+
+namespace sim {
+
+SimSSD1677::SimSSD1677(Pin cs, Pin dc, Pin rst, Pin busy, Pin sck, Pin sda)
+    : SPIDevice(cs), _dc(dc), _busy(busy), _sda(sda) {
+    memset(_bw, 0xFF, sizeof(_bw));
+    memset(_red, 0xFF, sizeof(_red));
+    drive(_busy, 0);
+    watch(rst, [this](int level) { onRst(level); });
+    watch(sck, [this](int level) { onSck(level); });
+    watch(cs, [this](int level) {
+        // Deselecting ends a read and releases SDA
+        if (level && _reading) {
+            _reading = false;
+            drive(_sda, -1);
+        }
+    });
+    attachSPI(this);
+}
+
+SimSSD1677::~SimSSD1677() {
+    if (_busyEvent) cancel(_busyEvent);
+    detachSPI(this);
+}
+
+int SimSSD1677::pixel(uint16_t x, uint16_t y) const {
+    if (x >= WIDTH || y >= HEIGHT) return -1;
+    return (_bw[(y * WIDTH + x) / 8] >> (7 - x % 8)) & 1;
+}
+
+void SimSSD1677::onRst(int level) {
+    // Hardware reset: registers to defaults, deep sleep left, RAM kept
+    if (level) return;
+    endUpload();
+    _deepSleep = false;
+    _command = 0;
+    _paramCount = 0;
+    _readOption = 0;
+    _xStart = _x = 0;
+    _xEnd = WIDTH - 1;
+    _yStart = _y = 0;
+    _yEnd = HEIGHT - 1;
+    _stats.resets++;
+}
+
+uint8_t SimSSD1677::transfer(uint8_t out, uint32_t clockHz) {
+    if (_deepSleep) return 0xFF;
+    if (clockHz > _maxClockHz) {
+        // Setup/hold violated: the controller samples the bits shifted by one
+        out = (uint8_t)((out >> 1) | (out << 7));
+        _stats.garbled++;
+    }
+    if (level(_dc) == 0) {
+        command(out);
+    } else {
+        data(out);
+    }
+    return 0xFF;                                // Reads are clocked by GPIO, see onSck()
+}
+
+void SimSSD1677::onSck(int level) {
+    // Only a rising edge with the MCU listening on SDA and DC at data clocks a bit out
+    if (!level || !_reading || sim::level(cs) || !sim::level(_dc) || mode(_sda) == Mode::Output) return;
+    if (_readBit == 8) {
+        _readByte = _readDummy ? 0x00 : readRam();
+        _readDummy = false;
+        _readBit = 0;
+    }
+    drive(_sda, (_readByte >> (7 - _readBit)) & 1);
+    _readBit++;
+}
+
+void SimSSD1677::setBusy(uint64_t ns) {
+    uint64_t until = nowNs() + ns;
+    if (until <= _busyUntil) return;
+    _stats.busyNs += until - (_busyUntil > nowNs() ? _busyUntil : nowNs());
+    _busyUntil = until;
+    drive(_busy, 1);
+    if (_busyEvent) cancel(_busyEvent);
+    _busyEvent = schedule(until, [this]() {
+        _busyEvent = 0;
+        drive(_busy, 0);
+    });
+}
+
+void SimSSD1677::endUpload() {
+    if (!_uploading) return;
+    _uploading = false;
+    uint64_t ns = nowNs() - _uploadStart;
+    _stats.uploadNs += ns;
+    if (ns > _stats.maxUploadNs) _stats.maxUploadNs = ns;
+}
+
+void SimSSD1677::command(uint8_t c) {
+    endUpload();
+    if (_reading) {
+        _reading = false;
+        drive(_sda, -1);
+    }
+    _stats.commands++;
+    _command = c;
+    _paramCount = 0;
+    switch (c) {
+        case 0x12:                              // SWRESET
+            _xStart = _x = 0;
+            _xEnd = WIDTH - 1;
+            _yStart = _y = 0;
+            _yEnd = HEIGHT - 1;
+            setBusy(_timing.resetNs);
+            break;
+        case 0x20: {                            // Master activation
+            uint8_t ctrl = _updateControl;
+            if (ctrl == 0xC0) {
+                setBusy(_timing.powerOnNs);
+            } else if (ctrl == 0x83) {
+                setBusy(_timing.powerOffNs);
+            } else if (ctrl == 0xF7) {
+                _stats.fullRefreshes++;
+                memcpy(_red, _bw, sizeof(_red));
+                setBusy(_timing.fullRefreshNs);
+            } else if (ctrl == 0xFC || ctrl == 0xF4 || ctrl == 0xFF) {
+                _stats.partialRefreshes++;
+                memcpy(_red, _bw, sizeof(_red));
+                setBusy(ctrl == 0xF4 ? _timing.fullRefreshNs : _timing.partialRefreshNs);
+            }
+            break;
+        }
+        case 0x27:                              // Read RAM, first byte dummy
+            _reading = true;
+            _readDummy = true;
+            _readBit = 8;
+            break;
+        case 0x24:
+        case 0x26:
+            _uploading = true;
+            _uploadStart = nowNs();
+            _stats.uploads++;
+            break;
+        default:
+            break;
+    }
+}
+
+void SimSSD1677::data(uint8_t d) {
+    if (_command == 0x24 || _command == 0x26) {
+        writeRam(d);
+        return;
+    }
+    if (_paramCount < sizeof(_params)) _params[_paramCount] = d;
+    _paramCount++;
+    const uint8_t* p = _params;
+    switch (_command) {
+        case 0x10:                              // Deep sleep
+            if (d & 0x03) _deepSleep = true;
+            break;
+        case 0x22:
+            _updateControl = d;
+            break;
+        case 0x41:
+            _readOption = d & 0x01;
+            break;
+        case 0x44:                              // X window, pixels
+            if (_paramCount == 4) {
+                _xStart = p[0] | (p[1] << 8);
+                _xEnd = p[2] | (p[3] << 8);
+            }
+            break;
+        case 0x45:                              // Y window
+            if (_paramCount == 4) {
+                _yStart = p[0] | (p[1] << 8);
+                _yEnd = p[2] | (p[3] << 8);
+            }
+            break;
+        case 0x4E:                              // X counter
+            if (_paramCount == 2) _x = p[0] | (p[1] << 8);
+            break;
+        case 0x4F:                              // Y counter
+            if (_paramCount == 2) _y = p[0] | (p[1] << 8);
+            break;
+        default:
+            break;
+    }
+}
+
+void SimSSD1677::writeRam(uint8_t d) {
+    // Entry mode 0x03 (X then Y increasing), 8 pixels per byte
+    if (_x < WIDTH && _y < HEIGHT) {
+        uint8_t* ram = _command == 0x24 ? _bw : _red;
+        ram[(_y * WIDTH + _x) / 8] = d;
+    }
+    _stats.ramBytes++;
+    _x += 8;
+    if (_x > _xEnd) {
+        _x = _xStart;
+        if (++_y > _yEnd) _y = _yStart;
+    }
+}
+
+uint8_t SimSSD1677::readRam() {
+    // Same counter walk as writeRam()
+    uint8_t d = 0xFF;
+    if (_x < WIDTH && _y < HEIGHT) {
+        const uint8_t* ram = _readOption ? _red : _bw;
+        d = ram[(_y * WIDTH + _x) / 8];
+    }
+    _stats.readBytes++;
+    _x += 8;
+    if (_x > _xEnd) {
+        _x = _xStart;
+        if (++_y > _yEnd) _y = _yStart;
+    }
+    return d;
+}
+
+} // namespace sim
@@ -0,0 +1,106 @@
+#ifndef SIM_SSD1677_H
+#define SIM_SSD1677_H
+
+#include "Sim.h"
+
+// =====================================================
+// SSD1677 panel controller (GDEM133T91, 960x680) on the
+// 4-wire SPI: command/data by DC, RAM window and address
+// counters, BUSY (active HIGH) for reset, power and
+// refresh phases. Bytes clocked faster than the
+// controller accepts are garbled. Read RAM (0x27) drives
+// SDA one bit per rising SCK edge once the MCU has
+// released it to an input.
+// =====================================================
+
+namespace sim {
+
+class SimSSD1677 : public SPIDevice {
+public:
+    static const uint16_t WIDTH = 960;
+    static const uint16_t HEIGHT = 680;
+
+    // BUSY durations, ns
+    struct Timing {
+        uint64_t resetNs = 2000000;            // SWRESET
+        uint64_t powerOnNs = 100000000;
+        uint64_t powerOffNs = 150000000;
+        uint64_t fullRefreshNs = 4500000000ull;
+        uint64_t partialRefreshNs = 600000000;
+    };
+
+    struct Stats {
+        uint32_t commands;
+        uint64_t ramBytes;                     // Written to either RAM
+        uint32_t uploads;                      // RAM write commands with data
+        uint64_t uploadNs;                     // From the RAM command to the next command
+        uint64_t maxUploadNs;
+        uint32_t fullRefreshes;
+        uint32_t partialRefreshes;
+        uint64_t busyNs;
+        uint32_t garbled;                      // Bytes sent above maxClockHz
+        uint32_t resets;
+        uint32_t readBytes;                    // Clocked out on SDA
+    };
+
+    SimSSD1677(Pin cs, Pin dc, Pin rst, Pin busy, Pin sck, Pin sda);
+    ~SimSSD1677();
+
+    Timing& timing() { return _timing; }
+    void setMaxClock(uint32_t hz) { _maxClockHz = hz; }
+    uint32_t maxClock() const { return _maxClockHz; }
+
+    bool isBusy() const { return _busyUntil > nowNs(); }
+    bool isSleeping() const { return _deepSleep; }
+    const uint8_t* ram(bool previous = false) const { return previous ? _red : _bw; }
+    int pixel(uint16_t x, uint16_t y) const;  // Current RAM, 1 = white
+
+    const Stats& stats() const { return _stats; }
+    void resetStats() { _stats = Stats(); }
+
+    uint8_t transfer(uint8_t out, uint32_t clockHz) override;
+
+private:
+    void onRst(int level);
+    void command(uint8_t c);
+    void data(uint8_t d);
+    void writeRam(uint8_t d);
+    uint8_t readRam();
+    void onSck(int level);
+    void setBusy(uint64_t ns);
+    void endUpload();
+
+    Pin _dc;
+    Pin _busy;
+    Pin _sda;
+    Timing _timing;
+    uint32_t _maxClockHz = 20000000;
+    Stats _stats = {};
+
+    uint8_t _bw[WIDTH / 8 * HEIGHT];
+    uint8_t _red[WIDTH / 8 * HEIGHT];
+
+    uint8_t _command = 0;
+    uint8_t _params[8] = {};
+    uint8_t _paramCount = 0;
+    uint8_t _updateControl = 0;
+    uint8_t _readOption = 0;                   // 0x41: 0 b/w RAM, 1 red RAM
+    bool _reading = false;
+    bool _readDummy = false;
+    uint8_t _readByte = 0;
+    uint8_t _readBit = 8;
+    bool _deepSleep = false;
+
+    uint16_t _xStart = 0, _xEnd = WIDTH - 1;   // Pixels
+    uint16_t _yStart = 0, _yEnd = HEIGHT - 1;
+    uint16_t _x = 0, _y = 0;
+
+    uint64_t _busyUntil = 0;
+    EventId _busyEvent = 0;
+    uint64_t _uploadStart = 0;
+    bool _uploading = false;
+};
+
+} // namespace sim
+
+#endif
@@ -0,0 +1,71 @@
+// I2CBus recovery: a slave holding SDA low fails the transfer at once (lost
+// arbitration, not a timeout) and must still trigger the bus recovery.
+// A plain NACK from an absent device must not. Recovery drives the lines
+// open-drain, so it never fights a slave that keeps holding SDA low.
+
+#include "Particle.h"
+#include "Sim.h"
+#include "SimMAX17049.h"
+#include "I2CBus.h"
+#include "Battery.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+} // namespace
+
+int main() {
+    sim::SimMAX17049 gauge(BATT_ALERT_PIN);
+    I2CBus& bus = I2CBus::instance();
+    bus.begin();
+    int dev = bus.addDevice(0x36, "MAX17049", I2CBus::Priority::Low);
+    int absent = bus.addDevice(0x50, "absent", I2CBus::Priority::Low);
+
+    uint8_t version[2];
+    CHECK(bus.readRegs(dev, 0x08, version, 2) == I2CBus::Result::OK);
+    CHECK(version[0] == 0x00 && version[1] == 0x12);
+    CHECK(!bus.isStuck());
+
+    // Absent device: NACK, lines idle, no recovery
+    uint8_t byte;
+    CHECK(bus.readRegs(absent, 0x00, &byte, 1) == I2CBus::Result::Nack);
+    CHECK(bus.getRecoveries() == 0);
+
+    // Slave stuck mid-byte: SDA low until SCL is clocked 5 times
+    sim::i2cHoldSda(I2C_SDA_PIN, I2C_SCL_PIN, 5);
+    CHECK(bus.isStuck());
+    uint64_t t0 = sim::nowNs();
+    CHECK(bus.readRegs(dev, 0x08, version, 2) != I2CBus::Result::OK);
+    CHECK(sim::nowNs() - t0 < (uint64_t)I2C_TIMEOUT_MS * 1000000ull);
+    CHECK(bus.getRecoveries() == 1);
+    CHECK(!bus.isStuck());
+    CHECK(bus.getStats(dev)->retries == 0);     // No retries into a stuck bus
+
+    version[0] = version[1] = 0xFF;
+    CHECK(bus.readRegs(dev, 0x08, version, 2) == I2CBus::Result::OK);
+    CHECK(version[0] == 0x00 && version[1] == 0x12);
+
+    // Slave that outlasts the 9 recovery clocks: recovery fails without
+    // driving SDA or SCL high against it
+    sim::i2cHoldSda(I2C_SDA_PIN, I2C_SCL_PIN, 12);
+    CHECK(!bus.recover());
+    CHECK(bus.isStuck());
+    CHECK(bus.recover());
+    CHECK(!bus.isStuck());
+    CHECK(sim::contentions() == 0);
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("i2cbus: ok\n");
+    return 0;
+}
@@ -0,0 +1,469 @@
+// PN532 transaction engine (DFRobot_PN532_IIC) and RFID::poll() against the
+// simulated PN532. Each case runs in its own process so the firmware
+// singletons and the virtual clock start fresh:
+//
+//   test_pn532 <case>
+//
+// Cases print per-transaction latency as LATENCY lines:
+//
+//   LATENCY <name> <mean us> <max us> <count>
+
+#include "Particle.h"
+#include "Sim.h"
+#include "SimPN532.h"
+#include "I2CBus.h"
+#include "RFID.h"
+
+#include <new>
+
+// Same enlarged Wire buffers as main.cpp: a two-target frame exceeds the default 32
+hal_i2c_config_t acquireWireBuffer() {
+    hal_i2c_config_t config = {
+        .size = sizeof(hal_i2c_config_t),
+        .version = HAL_I2C_CONFIG_VERSION_1,
+        .rx_buffer = new (std::nothrow) uint8_t[PN532_PACKBUFFSIZ],
+        .rx_buffer_size = PN532_PACKBUFFSIZ,
+        .tx_buffer = new (std::nothrow) uint8_t[PN532_PACKBUFFSIZ],
+        .tx_buffer_size = PN532_PACKBUFFSIZ
+    };
+    return config;
+}
+
+namespace {
+
+const sim::Pin RF_LINES[4] = {RF_V1, RF_V2, RF_V3, RF_V4};
+
+int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+void latency(const char* name, const sim::SimPN532::CommandStats& st) {
+    printf("LATENCY %-24s %10.1f %10.1f %6u\n", name,
+        st.count ? st.totalNs / 1e3 / st.count : 0.0, st.maxNs / 1e3, st.count);
+}
+
+// Hardware reset and SAMConfig, as RFID::begin() does, with the engine on the shared bus
+DFRobot_PN532_IIC* bootEngine() {
+    I2CBus::instance().begin();
+    pinMode(PN532_RST, OUTPUT);
+    digitalWrite(PN532_RST, LOW);
+    delay(10);
+    digitalWrite(PN532_RST, HIGH);
+    delay(50);
+    DFRobot_PN532_IIC* nfc = new DFRobot_PN532_IIC(PN532_IRQ, 1);
+    CHECK(nfc->begin());
+    return nfc;
+}
+
+void selectLines(uint8_t lines) {
+    for (int i = 0; i < 4; i++) {
+        pinMode(RF_LINES[i], OUTPUT);
+        digitalWrite(RF_LINES[i], (lines >> i) & 1);
+    }
+}
+
+// Poll the engine until it leaves the busy states, at most timeoutMs
+DFRobot_PN532::eTransaction_t complete(DFRobot_PN532_IIC* nfc, uint32_t timeoutMs = 2000) {
+    uint32_t start = millis();
+    while (millis() - start < timeoutMs) {
+        DFRobot_PN532::eTransaction_t state = nfc->poll();
+        if (state != DFRobot_PN532::eTransactionWaitAck &&
+            state != DFRobot_PN532::eTransactionWaitResponse) {
+            return state;
+        }
+        delayMicroseconds(100);
+    }
+    return DFRobot_PN532::eTransactionWaitResponse;
+}
+
+// ---- Engine ----
+
+// startScan() only writes the frame (about 1 ms at 100 kHz): no waiting on
+// the ACK or the RF cycle
+void engineSubmitReturnsAtOnce(sim::SimPN532& pn532) {
+    DFRobot_PN532_IIC* nfc = bootEngine();
+    CHECK(nfc->setPassiveActivationRetries(PASSIVE_ACTIVATION_RETRIES));
+    CHECK(pn532.passiveRetries() == PASSIVE_ACTIVATION_RETRIES);
+
+    uint64_t t0 = sim::nowNs();
+    CHECK(nfc->startScan());
+    uint64_t submitNs = sim::nowNs() - t0;
+    printf("LATENCY %-24s %10.1f\n", "submit", submitNs / 1e3);
+    CHECK(submitNs < 2000000);
+    CHECK(submitNs < pn532.timing().activationNs);
+    CHECK(nfc->isBusy());
+
+    // A second command is refused while one is in flight
+    CHECK(!nfc->startScan());
+
+    CHECK(complete(nfc) == DFRobot_PN532::eTransactionDone);
+    CHECK(!nfc->isBusy());
+    CHECK(!nfc->parseScan());
+}
+
+// Empty field: NbTg = 0 after the bounded activation retries
+void engineEmptyField(sim::SimPN532& pn532) {
+    DFRobot_PN532_IIC* nfc = bootEngine();
+    CHECK(nfc->setPassiveActivationRetries(PASSIVE_ACTIVATION_RETRIES));
+    selectLines(0x0);
+    for (int i = 0; i < 20; i++) {
+        CHECK(nfc->startScan());
+        CHECK(complete(nfc) == DFRobot_PN532::eTransactionDone);
+        CHECK(!nfc->parseScan());
+    }
+    const sim::SimPN532::CommandStats& st = pn532.stats(0x4A);
+    CHECK(st.count == 20);
+    latency("scan.empty", st);
+    printf("LATENCY %-24s %10lu\n", "scan.empty.engine", (unsigned long)nfc->getLastLatency());
+
+    // On top of the PN532's own time the engine only adds the frame transfers
+    // (command, ACK, response: a few ms at 100 kHz)
+    uint64_t overheadNs = nfc->getLastLatency() * 1000ull - st.maxNs;
+    printf("LATENCY %-24s %10.1f\n", "scan.empty.overhead", overheadNs / 1e3);
+    CHECK(nfc->getLastLatency() * 1000ull >= st.maxNs);
+    CHECK(overheadNs < 8000000);
+}
+
+// Two cards in one field: one InListPassiveTarget with MaxTg = 2 returns both,
+// with their own UID lengths
+void engineTwoTargets(sim::SimPN532& pn532) {
+    const uint8_t uid1[4] = {0x11, 0x22, 0x33, 0x44};
+    const uint8_t uid2[7] = {0x04, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA};
+    pn532.addCard(5, uid1, sizeof(uid1));
+    pn532.addCard(5, uid2, sizeof(uid2), 0, 0, true);
+
+    DFRobot_PN532_IIC* nfc = bootEngine();
+    CHECK(nfc->setPassiveActivationRetries(PASSIVE_ACTIVATION_RETRIES));
+    selectLines(0x2);                           // RF5
+    CHECK(pn532.selectedAntenna() == 5);
+
+    CHECK(nfc->startScan(2));
+    CHECK(complete(nfc) == DFRobot_PN532::eTransactionDone);
+    DFRobot_PN532::sTarget_t targets[PN532_MAX_TARGETS];
+    CHECK(nfc->parseTargets(targets, PN532_MAX_TARGETS) == 2);
+    CHECK(targets[0].uid.length == 4 && !memcmp(targets[0].uid.bytes, uid1, 4));
+    CHECK(targets[1].uid.length == 7 && !memcmp(targets[1].uid.bytes, uid2, 7));
+    latency("scan.two_targets", pn532.stats(0x4A));
+
+    // Another antenna does not see them
+    selectLines(0x0);                           // RF1
+    CHECK(nfc->startScan(2));
+    CHECK(complete(nfc) == DFRobot_PN532::eTransactionDone);
+    CHECK(nfc->parseTargets(targets, PN532_MAX_TARGETS) == 0);
+}
+
+// Without bounded retries an empty field never answers: the engine times out
+void engineTimeout(sim::SimPN532& pn532) {
+    DFRobot_PN532_IIC* nfc = bootEngine();
+    CHECK(pn532.passiveRetries() == 0xFF);
+    uint8_t cmd[3] = {0x4A, 0x01, 0x00};        // InListPassiveTarget, 1 target, 106 kbps A
+    uint64_t t0 = sim::nowNs();
+    CHECK(nfc->startCommand(cmd, sizeof(cmd), 25, 200));
+    CHECK(complete(nfc, 1000) == DFRobot_PN532::eTransactionTimeout);
+    uint64_t ms = (sim::nowNs() - t0) / 1000000;
+    CHECK(ms >= 200 && ms < 220);
+    CHECK(!nfc->isBusy());
+
+    // The engine aborted the timed out command with an ACK frame
+    CHECK(pn532.aborts() == 1);
+    CHECK(!pn532.isAutoPolling());
+    CHECK(nfc->setPassiveActivationRetries(PASSIVE_ACTIVATION_RETRIES));
+    CHECK(nfc->startScan());
+    CHECK(complete(nfc) == DFRobot_PN532::eTransactionDone);
+    CHECK(pn532.protocolErrors() == 0);
+}
+
+// An endless InAutoPoll only answers on a card; abortCommand() stops it
+void engineAutoPoll(sim::SimPN532& pn532) {
+    const uint8_t uid[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+    DFRobot_PN532_IIC* nfc = bootEngine();
+    selectLines(0x0);                           // RF1
+
+    CHECK(nfc->startAutoPoll(0xFF, 1));
+    CHECK(complete(nfc, 1000) == DFRobot_PN532::eTransactionWaitResponse);
+    CHECK(pn532.isAutoPolling());
+    nfc->abortCommand();
+    CHECK(!nfc->isBusy());
+    CHECK(!pn532.isAutoPolling());
+
+    pn532.addCard(1, uid, sizeof(uid), sim::nowNs() + 400000000ull);
+    CHECK(nfc->startAutoPoll(0xFF, 1));
+    CHECK(complete(nfc, 2000) == DFRobot_PN532::eTransactionDone);
+    DFRobot_PN532::sTarget_t targets[PN532_MAX_TARGETS];
+    CHECK(nfc->parseTargets(targets, PN532_MAX_TARGETS) == 1);
+    CHECK(!memcmp(targets[0].uid.bytes, uid, 4));
+    latency("autopoll", pn532.stats(0x60));
+}
+
+// Power Down, then the next command wakes the PN532 over I2C
+void enginePowerDown(sim::SimPN532& pn532) {
+    DFRobot_PN532_IIC* nfc = bootEngine();
+    CHECK(nfc->setPassiveActivationRetries(PASSIVE_ACTIVATION_RETRIES));
+    CHECK(nfc->powerDown(PN532_SLEEP_WAKEUP));
+    CHECK(nfc->isPoweredDown());
+    CHECK(pn532.isPoweredDown());
+
+    CHECK(nfc->startScan(1));
+    CHECK(complete(nfc) == DFRobot_PN532::eTransactionDone);
+    CHECK(!nfc->isPoweredDown());
+    CHECK(!pn532.isPoweredDown());
+    latency("power_down", pn532.stats(0x16));
+    latency("scan.after_wake", pn532.stats(0x4A));
+}
+
+// ---- RFID ----
+
+// Poll until a card is handed out or timeoutMs passes
+bool pollCard(Uid& uid, uint8_t& antenna, uint32_t timeoutMs) {
+    uint32_t start = millis();
+    while (millis() - start < timeoutMs) {
+        if (RFID::instance().poll(uid, &antenna)) return true;
+        delayMicroseconds(50);
+    }
+    return false;
+}
+
+// poll() finds a card and keeps the loop free: a call costs at most one
+// bulk frame read (PN532_PACKBUFFSIZ bytes, about 5.5 ms at 100 kHz), never the RF cycle
+void rfidPoll(sim::SimPN532& pn532) {
+    I2CBus::instance().begin();
+    RFID& rfid = RFID::instance();
+    CHECK(rfid.begin());
+
+    const uint8_t uid[4] = {0x04, 0x01, 0x10, 0x20};
+    uint64_t placed = sim::nowNs() + 50000000ull;
+    int index = pn532.addCard(1, uid, sizeof(uid), placed);
+
+    Uid got;
+    uint64_t worstPollNs = 0;
+    uint32_t start = millis();
+    bool found = false;
+    while (millis() - start < 2000 && !found) {
+        uint64_t t0 = sim::nowNs();
+        found = rfid.poll(got);
+        uint64_t ns = sim::nowNs() - t0;
+        if (ns > worstPollNs) worstPollNs = ns;
+        delayMicroseconds(50);
+    }
+    CHECK(found);
+    CHECK(got.length == 4 && !memcmp(got.bytes, uid, 4));
+    CHECK(worstPollNs < 7000000);
+    printf("LATENCY %-24s %10.1f\n", "rfid.detect", (pn532.card(index).detectedNs - placed) / 1e3);
+    printf("LATENCY %-24s %10.1f\n", "rfid.poll.max", worstPollNs / 1e3);
+    latency("scan", pn532.stats(0x4A));
+    CHECK(pn532.protocolErrors() == 0);
+}
+
+// The sweep finds a card on any antenna and reports that antenna
+void rfidSweep(sim::SimPN532& pn532) {
+    I2CBus::instance().begin();
+    RFID& rfid = RFID::instance();
+    CHECK(rfid.begin());
+
+    const uint8_t antennas[] = {7, 1, 12, 4};
+    for (uint8_t a : antennas) {
+        uint8_t uid[4] = {0x04, a, 0x10, 0x20};
+        uint64_t placed = sim::nowNs() + 50000000ull;
+        int index = pn532.addCard(a, uid, sizeof(uid), placed, placed + 2000000000ull);
+
+        Uid got;
+        uint8_t antenna = 0;
+        uint64_t worstPollNs = 0;
+        uint32_t start = millis();
+        bool found = false;
+        while (millis() - start < 2000 && !found) {
+            uint64_t t0 = sim::nowNs();
+            found = rfid.poll(got, &antenna);
+            uint64_t ns = sim::nowNs() - t0;
+            if (ns > worstPollNs) worstPollNs = ns;
+            delayMicroseconds(50);
+        }
+        CHECK(found);
+        CHECK(antenna == a);
+        CHECK(got.length == 4 && !memcmp(got.bytes, uid, 4));
+        CHECK(worstPollNs < 7000000);
+        printf("LATENCY rfid.detect.RF%-13u %10.1f\n", a,
+            (pn532.card(index).detectedNs - placed) / 1e3);
+        printf("LATENCY rfid.poll.max.RF%-11u %10.1f\n", a, worstPollNs / 1e3);
+
+        // Let the card leave before the next one
+        sim::runUntilNs(placed + 2000000000ull);
+    }
+    latency("scan.sweep", pn532.stats(0x4A));
+    CHECK(pn532.protocolErrors() == 0);
+}
+
+// selectAntenna() with ALL OFF or a disabled port: poll() scans only
+// enabled antennas, and every scan is counted on one of them
+void rfidSelectOff(sim::SimPN532& pn532) {
+    const uint8_t uid[4] = {0x04, 0x03, 0x10, 0x20};
+    I2CBus::instance().begin();
+    RFID& rfid = RFID::instance();
+    CHECK(rfid.begin());
+    rfid.setAntennaMask(1 << 2);                // RF3 only
+
+    for (uint8_t select : {0, 5}) {
+        rfid.selectAntenna(select);
+        uint64_t placed = sim::nowNs() + 50000000ull;
+        pn532.addCard(3, uid, sizeof(uid), placed, placed + 500000000ull);
+        Uid got;
+        uint8_t antenna = 0;
+        CHECK(pollCard(got, antenna, 1000));
+        CHECK(antenna == 3);
+        CHECK(rfid.getAntenna() == 3);
+        sim::runUntilNs(placed + 500000000ull);
+    }
+    CHECK(rfid.getAntennaScans(3) == pn532.stats(0x4A).count);
+}
+
+// Two cards in one RF cycle come out of consecutive poll() calls
+void rfidTwoTargets(sim::SimPN532& pn532) {
+    const uint8_t uid1[4] = {0x01, 0x02, 0x03, 0x04};
+    const uint8_t uid2[4] = {0x05, 0x06, 0x07, 0x08};
+    pn532.addCard(3, uid1, sizeof(uid1));
+    pn532.addCard(3, uid2, sizeof(uid2));
+
+    I2CBus::instance().begin();
+    RFID& rfid = RFID::instance();
+    CHECK(rfid.begin());
+    rfid.setAntennaMask(1 << 2);
+
+    Uid a, b;
+    uint8_t antA = 0, antB = 0;
+    CHECK(pollCard(a, antA, 1000));
+    CHECK(rfid.poll(b, &antB));                 // No RF cycle in between
+    CHECK(antA == 3 && antB == 3);
+    CHECK(!memcmp(a.bytes, uid1, 4));
+    CHECK(!memcmp(b.bytes, uid2, 4));
+}
+
+// sweepOnce() scans every enabled antenna even when the adaptive schedule
+// favours a hot one, then pauses and goes idle
+void rfidSweepOnce(sim::SimPN532& pn532) {
+    I2CBus::instance().begin();
+    RFID& rfid = RFID::instance();
+    CHECK(rfid.begin());
+
+    // Make RF3 hot, then take the card away
+    const uint8_t uid[4] = {0x04, 0x03, 0x03, 0x03};
+    uint64_t removed = sim::nowNs() + 3000000000ull;
+    pn532.addCard(3, uid, sizeof(uid), 0, removed);
+    Uid got;
+    uint8_t antenna;
+    while (sim::nowNs() < removed + 100000000ull) {
+        rfid.poll(got, &antenna);
+        delayMicroseconds(50);
+    }
+    CHECK(rfid.getAntennaWeight(3) == ANTENNA_MAX_WEIGHT);
+
+    rfid.pause();
+    uint32_t start = millis();
+    while (!rfid.isIdle() && millis() - start < 100) {
+        rfid.poll(got, &antenna);
+        delayMicroseconds(50);
+    }
+    CHECK(rfid.isIdle());
+
+    uint32_t before[ANTENNA_COUNT + 1];
+    for (uint8_t a = 1; a <= ANTENNA_COUNT; a++) before[a] = rfid.getAntennaScans(a);
+    rfid.sweepOnce();
+    CHECK(!rfid.isPaused());
+    start = millis();
+    while (!rfid.isIdle() && millis() - start < 1000) {
+        rfid.poll(got, &antenna);
+        delayMicroseconds(50);
+    }
+    CHECK(rfid.isIdle());
+    for (uint8_t a = 1; a <= ANTENNA_COUNT; a++) {
+        CHECK(rfid.getAntennaScans(a) - before[a] == 1);
+    }
+    printf("LATENCY %-24s %10.1f\n", "rfid.sweep_once", (millis() - start) * 1e3);
+}
+
+// pause() during an endless InAutoPoll (one antenna) aborts it so the
+// reader can go idle
+void rfidPauseAutoPoll(sim::SimPN532& pn532) {
+    I2CBus::instance().begin();
+    RFID& rfid = RFID::instance();
+    CHECK(rfid.begin());
+    rfid.setAntennaMask(1 << 5);
+    rfid.setScanMode(RFID::ScanMode::AutoPoll);
+
+    Uid got;
+    uint32_t start = millis();
+    while (!pn532.isAutoPolling() && millis() - start < 100) {
+        rfid.poll(got);
+        delayMicroseconds(50);
+    }
+    CHECK(pn532.isAutoPolling());
+
+    rfid.pause();
+    start = millis();
+    while (!rfid.isIdle() && millis() - start < 1000) {
+        rfid.poll(got);
+        delayMicroseconds(50);
+    }
+    CHECK(rfid.isIdle());
+    CHECK(!pn532.isAutoPolling());
+    CHECK(pn532.aborts() == 1);
+    CHECK(rfid.powerDown());
+    CHECK(pn532.isPoweredDown());
+
+    // A duty-cycled sweep of the single antenna polls a bounded number of rounds
+    rfid.sweepOnce();
+    start = millis();
+    while (!rfid.isIdle() && millis() - start < 1000) {
+        rfid.poll(got);
+        delayMicroseconds(50);
+    }
+    CHECK(rfid.isIdle());
+    CHECK(pn532.protocolErrors() == 0);
+}
+
+struct Case {
+    const char* name;
+    void (*fn)(sim::SimPN532&);
+};
+
+const Case CASES[] = {
+    {"engine_submit", engineSubmitReturnsAtOnce},
+    {"engine_empty_field", engineEmptyField},
+    {"engine_two_targets", engineTwoTargets},
+    {"engine_timeout", engineTimeout},
+    {"engine_autopoll", engineAutoPoll},
+    {"engine_power_down", enginePowerDown},
+    {"rfid_poll", rfidPoll},
+    {"rfid_sweep", rfidSweep},
+    {"rfid_select_off", rfidSelectOff},
+    {"rfid_two_targets", rfidTwoTargets},
+    {"rfid_sweep_once", rfidSweepOnce},
+    {"rfid_pause_autopoll", rfidPauseAutoPoll},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <case>\n", argv[0]);
+        for (const Case& c : CASES) fprintf(stderr, "  %s\n", c.name);
+        return 2;
+    }
+    for (const Case& c : CASES) {
+        if (strcmp(argv[1], c.name)) continue;
+        sim::SimPN532 pn532(PN532_IRQ, PN532_RST, RF_LINES);
+        c.fn(pn532);
+        if (failures) {
+            printf("%s: %d check(s) failed\n", c.name, failures);
+            return 1;
+        }
+        printf("%s: ok\n", c.name);
+        return 0;
+    }
+    fprintf(stderr, "unknown case: %s\n", argv[1]);
+    return 2;
+}
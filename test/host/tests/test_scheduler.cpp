@@ -0,0 +1,98 @@
+// Scheduler task slots: one-shots and cancelled tasks give their slot back,
+// a one-shot that retriggers itself keeps it.
+
+#include "Particle.h"
+#include "Scheduler.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+int runs = 0;
+int selfId = -1;
+int retriggersLeft = 0;
+
+void count() { runs++; }
+
+void retrigger() {
+    runs++;
+    if (retriggersLeft-- > 0) Scheduler::instance().trigger(selfId, 10);
+}
+
+void runFor(uint32_t ms) {
+    uint32_t start = millis();
+    while (millis() - start < ms) {
+        Scheduler::instance().run();
+        delay(1);
+    }
+}
+
+// Far more one-shots than slots over time: each run frees its slot
+void oneShotsReleaseSlots() {
+    Scheduler& s = Scheduler::instance();
+    runs = 0;
+    for (int i = 0; i < 5 * SCHEDULER_MAX_TASKS; i++) {
+        int id = s.addOneShot("once", count, 5);
+        CHECK(id >= 0);
+        CHECK(s.isPending(id));
+        runFor(10);
+        CHECK(!s.isPending(id));
+        CHECK(s.getStats(id) == nullptr);
+    }
+    CHECK(runs == 5 * SCHEDULER_MAX_TASKS);
+}
+
+// Cancelled tasks free their slot and never run
+void cancelReleasesSlot() {
+    Scheduler& s = Scheduler::instance();
+    runs = 0;
+    int ids[SCHEDULER_MAX_TASKS];
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        ids[i] = s.addPeriodic("periodic", count, 5, 1000);
+        CHECK(ids[i] >= 0);
+    }
+    CHECK(s.addPeriodic("full", count, 5) == -1);
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) s.cancel(ids[i]);
+    runFor(1100);
+    CHECK(runs == 0);
+
+    int id = s.addOneShot("after", count, 0);
+    CHECK(id >= 0);
+    s.cancel(id);
+    runFor(5);
+    CHECK(runs == 0);
+}
+
+// A one-shot that retriggers itself stays armed until it stops
+void retriggerKeepsSlot() {
+    Scheduler& s = Scheduler::instance();
+    runs = 0;
+    retriggersLeft = 3;
+    selfId = s.addOneShot("again", retrigger, 0);
+    CHECK(selfId >= 0);
+    runFor(100);
+    CHECK(runs == 4);
+    CHECK(!s.isPending(selfId));
+    CHECK(s.getStats(selfId) == nullptr);
+}
+
+} // namespace
+
+int main() {
+    oneShotsReleaseSlots();
+    cancelReleasesSlot();
+    retriggerKeepsSlot();
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("scheduler: ok\n");
+    return 0;
+}
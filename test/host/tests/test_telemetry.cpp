@@ -0,0 +1,124 @@
+// Telemetry uploads against the simulated cloud: publishing does not wait
+// for the acknowledgement, samples recorded meanwhile survive, failed
+// uploads keep the log, and an unsynced log from an earlier boot waits for
+// the first connection as its own event.
+//
+// Retained RAM lives on across begin() calls here, as it does across a reset.
+
+#include "Particle.h"
+#include "Sim.h"
+#include "Telemetry.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+uint16_t soc = 0x5000;
+
+void recordSample() {
+    Battery::Snapshot snap = {};
+    snap.timestamp = millis() | 1;
+    snap.soc = soc--;                           // Every sample differs
+    snap.vcell = 0xC000;
+    snap.crate = 0xFFF0;
+    Telemetry::instance().record(snap, Telemetry::StateOnBattery);
+}
+
+uint8_t firstByte(const std::string& base64) {
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t a = strchr(alphabet, base64[0]) - alphabet;
+    uint32_t b = strchr(alphabet, base64[1]) - alphabet;
+    return (uint8_t)(a << 2 | b >> 4);
+}
+
+void connect() {
+    Particle.connect();
+    uint32_t start = millis();
+    while (!Particle.connected() && millis() - start < 10000) delay(10);
+    CHECK(Particle.connected());
+}
+
+void settle(Telemetry& t) {
+    uint32_t start = millis();
+    while (t.isPublishing() && millis() - start < 10000) {
+        delay(10);
+        t.process();
+    }
+    CHECK(!t.isPublishing());
+}
+
+} // namespace
+
+int main() {
+    Telemetry& t = Telemetry::instance();
+    sim::cloud().publishMs = 2000;
+
+    // ---- Earlier boot: offline, clock never synced ----
+    t.begin();
+    for (int i = 0; i < 5; i++) {
+        recordSample();
+        delay(60000);
+    }
+    CHECK(t.getSampleCount() == 5);
+    CHECK(!t.flushIfDue());                     // Offline: nothing to do
+
+    // ---- Reset: the unsynced log is set aside, recording goes on ----
+    t.begin();
+    CHECK(t.getSampleCount() == 0);
+    for (int i = 0; i < 3; i++) {
+        recordSample();
+        delay(60000);
+    }
+    CHECK(t.getSampleCount() == 3);
+    CHECK(t.getDropped() == 0);
+
+    // ---- First connection: the earlier boot's log goes out on its own ----
+    connect();
+    uint64_t t0 = sim::nowNs();
+    CHECK(t.flushIfDue());
+    CHECK((sim::nowNs() - t0) < 5000000ull);    // Did not wait for the round trip
+    CHECK(t.isPublishing());
+    CHECK(!t.flush());                          // One upload at a time
+    settle(t);
+    CHECK(sim::published().size() == 1);
+    CHECK(firstByte(sim::published()[0].data) == (TELEMETRY_FORMAT | TELEMETRY_UNSYNCED));
+    CHECK(t.getSampleCount() == 3);             // This boot's samples untouched
+
+    // ---- Samples recorded while an upload is in flight are kept ----
+    recordSample();                             // Rebases this boot's log on the synced clock
+    CHECK(t.getSampleCount() == 4);
+    CHECK(t.flush());
+    recordSample();
+    recordSample();
+    settle(t);
+    CHECK(sim::published().size() == 2);
+    CHECK(firstByte(sim::published()[1].data) == TELEMETRY_FORMAT);
+    CHECK(t.getSampleCount() == 2);
+
+    // ---- A failed upload keeps every sample ----
+    sim::cloud().failPublishes = true;
+    CHECK(t.flush());
+    recordSample();
+    settle(t);
+    CHECK(t.getSampleCount() == 3);
+    sim::cloud().failPublishes = false;
+    CHECK(t.flush());
+    settle(t);
+    CHECK(t.getSampleCount() == 0);
+    CHECK(t.getDropped() == 0);
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("telemetry: ok\n");
+    return 0;
+}